@@ -0,0 +1,97 @@
+#include "rvcc.h"
+
+// 编译器数据结构的内存分配
+// 终结符、AST节点、类型等对象都通过allocMem分配，按照对象的种类和
+// 当前的编译阶段统计分配的字节数和对象数，用于-fmem-report。
+//
+// 这些对象在分配后一直使用到编译结束，因此从按种类划分的区域（arena）中
+// 顺序分配：每个区域从块的当前位置向后移动指针，块用完后再分配新的块，
+// 避免了大量小块malloc的开销和分配器的元数据。
+// 编译器不释放这些对象，cc1退出时由操作系统回收。
+
+// 区域中每块的大小
+#define ARENA_CHUNK_SIZE (1 << 20)
+// 对象的对齐，满足long double等所有类型的对齐要求
+#define ARENA_ALIGN 16
+
+// 区域
+typedef struct {
+  char *Cur; // 当前块中下一个可分配的位置
+  char *End; // 当前块的结尾
+} Arena;
+
+static Arena Arenas[ARENA_NUM];
+
+// 按对象种类统计的内存
+MemCount MemKinds[MEM_KIND_NUM];
+// 按编译阶段统计的内存
+MemCount MemPhases[PHASE_NUM];
+// 各区域分配的块数和字节数
+MemCount ArenaChunks[ARENA_NUM];
+
+// 对象种类所在的区域
+static MemArena KindArenas[] = {
+    [MEM_TOKEN] = ARENA_TOKEN,   [MEM_HIDESET] = ARENA_TOKEN,
+    [MEM_NODE] = ARENA_AST,      [MEM_SCOPE] = ARENA_AST,
+    [MEM_OBJ] = ARENA_AST,       [MEM_TYPE] = ARENA_TYPE,
+    [MEM_STRING] = ARENA_STRING, [MEM_FILE] = ARENA_OTHER,
+    [MEM_OTHER] = ARENA_OTHER,
+};
+
+// 清除内存统计，cc1开始时清除从驱动程序继承的统计
+void resetMemCounts(void) {
+  memset(MemKinds, 0, sizeof(MemKinds));
+  memset(MemPhases, 0, sizeof(MemPhases));
+  memset(ArenaChunks, 0, sizeof(ArenaChunks));
+}
+
+// 计入内存统计，用于不经过allocMem分配的内存
+void countMem(MemKind Kind, size_t Size) {
+  MemKinds[Kind].Count++;
+  MemKinds[Kind].Bytes += Size;
+  MemCount *P = &MemPhases[currentPhase()];
+  P->Count++;
+  P->Bytes += Size;
+}
+
+// 为区域分配Size个字节的块，calloc返回的内存已清零
+static char *newChunk(MemArena Id, size_t Size) {
+  char *Chunk = calloc(1, Size);
+  if (!Chunk)
+    error("out of memory");
+  ArenaChunks[Id].Count++;
+  ArenaChunks[Id].Bytes += Size;
+  return Chunk;
+}
+
+// 从区域中分配Size个字节，按Align对齐
+// 块中的内存只分配一次，因此分配出的内存都是清零的
+static void *arenaAlloc(MemArena Id, size_t Size, size_t Align) {
+  Arena *A = &Arenas[Id];
+  char *P = (char *)(((uintptr_t)A->Cur + Align - 1) & ~(Align - 1));
+  if (A->Cur && P + Size <= A->End) {
+    A->Cur = P + Size;
+    return P;
+  }
+
+  // 较大的对象单独分配一块，保留当前块中剩余的空间
+  if (Size > ARENA_CHUNK_SIZE / 4)
+    return newChunk(Id, Size);
+
+  P = newChunk(Id, ARENA_CHUNK_SIZE);
+  A->Cur = P + Size;
+  A->End = P + ARENA_CHUNK_SIZE;
+  return P;
+}
+
+// 分配Size个字节的清零的内存，并计入内存统计
+void *allocMem(MemKind Kind, size_t Size) {
+  countMem(Kind, Size);
+  return arenaAlloc(KindArenas[Kind], Size, ARENA_ALIGN);
+}
+
+// 在字符串区域中分配Size个字节，不需要对齐
+char *allocString(size_t Size) {
+  countMem(MEM_STRING, Size);
+  return arenaAlloc(ARENA_STRING, Size, 1);
+}
@@ -0,0 +1,3185 @@
+#include "rvcc.h"
+#include <elf.h>
+#include <setjmp.h>
+
+// 集成汇编器，将codegen生成的汇编代码直接汇编为RISC-V的ELF可重定位文件，
+// 不再需要临时的汇编文件，也不再需要运行外部的as
+//
+// 支持codegen使用到的RV64GC指令、伪指令和汇编指示，没有重定位的指令被压缩为
+// RVC指令（可以用.option norvc关闭），条件跳转和jal不进行压缩。
+// 段的内容由片段组成，同一段内局部标签的跳转在布局时直接解析，
+// 超出范围的条件跳转被扩展为反转的条件跳转加上jal，
+// 其余的符号引用都生成重定位，.loc生成.debug_line调试信息
+//
+// codegen通过asmEmit直接传入printLn的格式字符串和参数，不再输出文本：
+// 每个格式字符串在首次使用时编译为模板，之后只需格式化其中的参数，
+// 助记符和不含参数的操作数不再重复解析。-S和外部的as仍然使用同一组格式字符串，
+// 因此结果总是一致。含有内联汇编的文件仍然输出汇编代码，再由assembleObj解析，
+// 遇到不支持的指令或汇编指示时，assembleObj返回false，由cc1改用外部的as
+
+typedef struct AsmSec AsmSec;
+typedef struct AsmSym AsmSym;
+typedef struct Frag Frag;
+typedef struct Fixup Fixup;
+typedef struct Loc Loc;
+
+// 重定位
+struct Fixup {
+  Fixup *Next;    // 下一个重定位
+  uint64_t Off;   // 在片段（生成文件时为段）内的偏移量
+  int Type;       // 重定位的类型，R_RISCV_*
+  AsmSym *Sym;    // 引用的符号
+  int64_t Addend; // 加数
+};
+
+// 片段的种类
+typedef enum {
+  FRAG_DATA,   // 数据和大小确定的指令
+  FRAG_ALIGN,  // 对齐的填充
+  FRAG_BRANCH, // 条件跳转，目标超出范围时扩展为两条指令
+  FRAG_JUMP,   // jal跳转
+} FragKind;
+
+// 片段，只有对齐和跳转片段的大小需要在布局时确定
+struct Frag {
+  Frag *Next;    // 下一个片段
+  FragKind Kind; // 种类
+  uint64_t Addr; // 在段内的偏移量，布局时计算
+
+  // 数据片段
+  char *Data;        // 内容，NOBITS段内为NULL
+  uint64_t Len;      // 长度
+  uint64_t Cap;      // 容量
+  Fixup *Fixups;     // 重定位
+  Fixup *LastFixup;  // 最后一个重定位
+
+  // 对齐片段
+  uint64_t Align; // 对齐的字节数
+  uint64_t Pad;   // 填充的字节数，布局时计算
+
+  // 跳转片段
+  uint32_t Insn;  // 不含偏移量的指令
+  AsmSym *Target; // 跳转的目标
+  int64_t Addend; // 目标的偏移量
+  bool IsLong;    // 条件跳转是否被扩展
+};
+
+// .loc记录的行号信息
+struct Loc {
+  Loc *Next;    // 下一个行号信息
+  Frag *Frag;   // 所在的片段
+  uint64_t Off; // 在片段内的偏移量
+  int File;     // 文件编号
+  int Line;     // 行号
+};
+
+// 段
+struct AsmSec {
+  AsmSec *Next;     // 下一个段
+  char *Name;       // 名称
+  uint32_t Type;    // 类型，SHT_*
+  uint64_t Flags;   // 标志，SHF_*
+  uint64_t Align;   // 对齐
+  uint64_t EntSize; // 元素大小
+  Frag *Frags;      // 片段
+  Frag *Cur;        // 最后一个片段
+  uint64_t Size;    // 大小，布局时计算
+  Loc *Locs;        // 行号信息
+  Loc *LastLoc;     // 最后一个行号信息
+  AsmSym *Sym;      // 段符号
+
+  // 生成目标文件时使用
+  char *Data;     // 内容
+  Fixup *Relocs;  // 重定位
+  int Index;      // 段的索引
+  int RelaIndex;  // 重定位段的索引
+  uint64_t FileOff;     // 内容在文件中的偏移量
+  uint64_t RelaFileOff; // 重定位段在文件中的偏移量
+  int NumRelocs;        // 重定位的数量
+};
+
+// 符号
+struct AsmSym {
+  AsmSym *Next;     // 下一个符号
+  char *Name;       // 名称
+  AsmSec *Sec;      // 定义所在的段，未定义时为NULL
+  Frag *Frag;       // 定义所在的片段
+  uint64_t Off;     // 在片段内的偏移量
+  uint64_t Size;    // 大小
+  Frag *EndFrag;    // 大小为.-Sym时，结束位置所在的片段
+  uint64_t EndOff;  // 结束位置在片段内的偏移量
+  int Type;         // 类型，STT_*
+  int Visibility;   // 可见性，STV_*
+  bool IsGlobal;    // .globl
+  bool IsWeak;      // .weak
+  bool IsLocal;     // .local
+  bool IsCommon;    // 未用.local声明的.comm
+  bool IsTLS;       // 被TLS重定位引用
+  bool IsUsed;      // 被重定位引用
+  bool IsSection;   // 段符号
+  uint64_t Common;  // 公共符号的对齐
+  int Index;        // 在符号表中的索引
+};
+
+// 所有的段
+static AsmSec *Sections;
+static AsmSec *LastSec;
+// 当前的段
+static AsmSec *CurSec;
+// 所有的符号，按照出现顺序
+static AsmSym *Syms;
+static AsmSym *LastSym;
+// 名称到符号的映射
+static HashMap SymMap;
+// 数字标签的定义次数
+static HashMap NumLabels;
+// la和lla使用的局部标签的数量
+static int NumPcrelLabels;
+// .file N "name"指定的文件
+static StringArray DwarfFiles;
+// .file "name"指定的源文件
+static char *SourceFile;
+// 当前的行号
+static int LineNo;
+// 是否使用了压缩指令
+static bool UsesRVC;
+// 是否压缩指令，.option rvc和.option norvc切换，默认与RV64GC相同
+static bool OptionRVC = true;
+// .option push保存的OptionRVC
+static bool RVCStack[16];
+static int RVCDepth;
+// 遇到不支持的指令或汇编指示时，返回到assembleObj
+static jmp_buf Unsupported;
+// 是否可以改用外部的as
+static bool CanFallback;
+
+//
+// 错误信息与辅助函数
+//
+
+// 汇编出错，输出出错的行号
+static noreturn void asmError(char *Fmt, ...) {
+  va_list VA;
+  va_start(VA, Fmt);
+  fprintf(stderr, "<integrated-as>:%d: error: ", LineNo);
+  vfprintf(stderr, Fmt, VA);
+  fprintf(stderr, "\n");
+  va_end(VA);
+  exit(1);
+}
+
+// 遇到不支持的指令或汇编指示，可以改用外部的as时返回到assembleObj
+static noreturn void unsupported(char *Name) {
+  if (CanFallback)
+    longjmp(Unsupported, 1);
+  asmError("unsupported instruction or directive: %s", Name);
+}
+
+// 语句的临时缓冲区，格式化的操作数等在下一条语句开始时失效
+static char Scratch[4096];
+static int ScratchLen;
+
+// 在临时缓冲区中复制S的前Len个字符，缓冲区不足时另行分配
+static char *scratchDup(char *S, int Len) {
+  char *P;
+  if (ScratchLen + Len + 1 <= sizeof(Scratch)) {
+    P = Scratch + ScratchLen;
+    ScratchLen += Len + 1;
+  } else {
+    P = malloc(Len + 1);
+  }
+  memcpy(P, S, Len);
+  P[Len] = '\0';
+  return P;
+}
+
+// 跳过空白字符
+static char *skipSpace(char *P) {
+  while (*P == ' ' || *P == '\t')
+    P++;
+  return P;
+}
+
+// 删除字符串结尾的空白字符
+static char *trim(char *P) {
+  P = skipSpace(P);
+  char *End = P + strlen(P);
+  while (End > P && (End[-1] == ' ' || End[-1] == '\t'))
+    *--End = '\0';
+  return P;
+}
+
+// 是否为符号名称中的字符，包括UTF-8编码的字符
+static bool isSymChar(char C) {
+  return isalnum(C) || C == '_' || C == '.' || C == '$' ||
+         (unsigned char)C >= 0x80;
+}
+
+// 按照顶层的逗号分割操作数，括号和字符串内的逗号不分割
+static int splitArgs(char *P, char **Args, int Max) {
+  P = trim(P);
+  if (!*P)
+    return 0;
+
+  int Argc = 0;
+  int Depth = 0;
+  bool InStr = false;
+  Args[Argc++] = P;
+  for (; *P; P++) {
+    if (InStr) {
+      if (*P == '\\' && P[1])
+        P++;
+      else if (*P == '"')
+        InStr = false;
+      continue;
+    }
+    if (*P == '"')
+      InStr = true;
+    else if (*P == '(')
+      Depth++;
+    else if (*P == ')')
+      Depth--;
+    else if (*P == ',' && Depth == 0) {
+      if (Argc == Max)
+        asmError("too many operands");
+      *P = '\0';
+      Args[Argc++] = P + 1;
+    }
+  }
+
+  for (int I = 0; I < Argc; I++)
+    Args[I] = trim(Args[I]);
+  return Argc;
+}
+
+//
+// 段与片段
+//
+
+// 以小端序写入整数
+static void writeInt(char *Buf, uint64_t Val, int Size) {
+  for (int I = 0; I < Size; I++)
+    Buf[I] = Val >> (I * 8);
+}
+
+// 在片段中添加重定位
+static void addFixup(Frag *F, uint64_t Off, int Type, AsmSym *Sym,
+                     int64_t Addend) {
+  Fixup *Fx = calloc(1, sizeof(Fixup));
+  Fx->Off = Off;
+  Fx->Type = Type;
+  Fx->Sym = Sym;
+  Fx->Addend = Addend;
+  if (F->LastFixup)
+    F->LastFixup->Next = Fx;
+  else
+    F->Fixups = Fx;
+  F->LastFixup = Fx;
+
+  // 被重定位引用的符号需要写入符号表
+  Sym->IsUsed = true;
+  switch (Type) {
+  case R_RISCV_TPREL_HI20:
+  case R_RISCV_TPREL_LO12_I:
+  case R_RISCV_TPREL_LO12_S:
+  case R_RISCV_TPREL_ADD:
+  case R_RISCV_TLS_GOT_HI20:
+  case R_RISCV_TLS_GD_HI20:
+    Sym->IsTLS = true;
+    break;
+  }
+}
+
+// 在当前段的最后添加片段
+static Frag *newFrag(FragKind Kind) {
+  Frag *F = calloc(1, sizeof(Frag));
+  F->Kind = Kind;
+  if (CurSec->Cur)
+    CurSec->Cur->Next = F;
+  else
+    CurSec->Frags = F;
+  CurSec->Cur = F;
+  return F;
+}
+
+// 返回当前段最后的数据片段，不是数据片段时新建一个
+static Frag *dataFrag(void) {
+  if (CurSec->Cur && CurSec->Cur->Kind == FRAG_DATA)
+    return CurSec->Cur;
+  return newFrag(FRAG_DATA);
+}
+
+// 向当前段写入数据
+static void emitBytes(char *Buf, uint64_t Len) {
+  Frag *F = dataFrag();
+
+  // NOBITS段内只能写入0，不保存内容
+  if (CurSec->Type == SHT_NOBITS) {
+    for (uint64_t I = 0; I < Len; I++)
+      if (Buf[I])
+        asmError("non-zero data in nobits section %s", CurSec->Name);
+    F->Len += Len;
+    return;
+  }
+
+  if (F->Len + Len > F->Cap) {
+    F->Cap = MAX(F->Cap * 2, F->Len + Len + 256);
+    F->Data = realloc(F->Data, F->Cap);
+  }
+  memcpy(F->Data + F->Len, Buf, Len);
+  F->Len += Len;
+}
+
+// 向当前段写入整数
+static void emitInt(uint64_t Val, int Size) {
+  char Buf[8];
+  writeInt(Buf, Val, Size);
+  emitBytes(Buf, Size);
+}
+
+// 向当前段写入Len个0
+static void emitZero(uint64_t Len) {
+  char Buf[256] = {0};
+  for (; Len > sizeof(Buf); Len -= sizeof(Buf))
+    emitBytes(Buf, sizeof(Buf));
+  emitBytes(Buf, Len);
+}
+
+// 向当前段写入整数，Sym不为空时生成重定位
+static void emitData(uint64_t Val, int Size, int Type, AsmSym *Sym) {
+  Frag *F = dataFrag();
+  if (Sym) {
+    if (CurSec->Type == SHT_NOBITS)
+      asmError("relocation in nobits section %s", CurSec->Name);
+    addFixup(F, F->Len, Type, Sym, Val);
+    Val = 0;
+  }
+  emitInt(Val, Size);
+}
+
+// 根据段的名称，推断段的类型和标志
+static void defaultSecAttr(char *Name, uint32_t *Type, uint64_t *Flags) {
+  // 名称等于Prefix，或者以Prefix.开头
+  #define IS(Prefix)                                                          \
+    (!strncmp(Name, Prefix, strlen(Prefix)) &&                                \
+     (Name[strlen(Prefix)] == '\0' || Name[strlen(Prefix)] == '.'))
+
+  *Type = SHT_PROGBITS;
+  *Flags = 0;
+  if (IS(".text"))
+    *Flags = SHF_ALLOC | SHF_EXECINSTR;
+  else if (IS(".data") || IS(".sdata") || IS(".data.rel.ro"))
+    *Flags = SHF_ALLOC | SHF_WRITE;
+  else if (IS(".rodata") || IS(".srodata"))
+    *Flags = SHF_ALLOC;
+  else if (IS(".bss") || IS(".sbss")) {
+    *Type = SHT_NOBITS;
+    *Flags = SHF_ALLOC | SHF_WRITE;
+  } else if (IS(".tdata"))
+    *Flags = SHF_ALLOC | SHF_WRITE | SHF_TLS;
+  else if (IS(".tbss")) {
+    *Type = SHT_NOBITS;
+    *Flags = SHF_ALLOC | SHF_WRITE | SHF_TLS;
+  } else if (IS(".init_array")) {
+    *Type = SHT_INIT_ARRAY;
+    *Flags = SHF_ALLOC | SHF_WRITE;
+  } else if (IS(".fini_array")) {
+    *Type = SHT_FINI_ARRAY;
+    *Flags = SHF_ALLOC | SHF_WRITE;
+  } else if (IS(".preinit_array")) {
+    *Type = SHT_PREINIT_ARRAY;
+    *Flags = SHF_ALLOC | SHF_WRITE;
+  } else if (IS(".note"))
+    *Type = SHT_NOTE;
+
+  #undef IS
+}
+
+// 查找段，不存在时新建
+// FlagStr和TypeStr为.section指定的标志和类型，为NULL时根据名称推断
+static AsmSec *getSection(char *Name, char *FlagStr, char *TypeStr,
+                          uint64_t EntSize) {
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next)
+    if (!strcmp(Sec->Name, Name))
+      return Sec;
+
+  AsmSec *Sec = calloc(1, sizeof(AsmSec));
+  Sec->Name = strdup(Name);
+  Sec->Align = 1;
+  Sec->EntSize = EntSize;
+  defaultSecAttr(Name, &Sec->Type, &Sec->Flags);
+
+  // 解析标志
+  if (FlagStr) {
+    Sec->Flags = 0;
+    for (char *P = FlagStr; *P; P++) {
+      switch (*P) {
+      case 'a':
+        Sec->Flags |= SHF_ALLOC;
+        break;
+      case 'w':
+        Sec->Flags |= SHF_WRITE;
+        break;
+      case 'x':
+        Sec->Flags |= SHF_EXECINSTR;
+        break;
+      case 'M':
+        Sec->Flags |= SHF_MERGE;
+        break;
+      case 'S':
+        Sec->Flags |= SHF_STRINGS;
+        break;
+      case 'T':
+        Sec->Flags |= SHF_TLS;
+        break;
+      default:
+        asmError("unsupported section flag '%c'", *P);
+      }
+    }
+  }
+
+  // 解析类型
+  if (TypeStr) {
+    if (!strcmp(TypeStr, "@progbits"))
+      Sec->Type = SHT_PROGBITS;
+    else if (!strcmp(TypeStr, "@nobits"))
+      Sec->Type = SHT_NOBITS;
+    else if (!strcmp(TypeStr, "@note"))
+      Sec->Type = SHT_NOTE;
+    else if (!strcmp(TypeStr, "@init_array"))
+      Sec->Type = SHT_INIT_ARRAY;
+    else if (!strcmp(TypeStr, "@fini_array"))
+      Sec->Type = SHT_FINI_ARRAY;
+    else if (!strcmp(TypeStr, "@preinit_array"))
+      Sec->Type = SHT_PREINIT_ARRAY;
+    else
+      asmError("unsupported section type %s", TypeStr);
+  }
+
+  // 段符号，用于调试信息的重定位
+  Sec->Sym = calloc(1, sizeof(AsmSym));
+  Sec->Sym->Name = "";
+  Sec->Sym->Sec = Sec;
+  Sec->Sym->Type = STT_SECTION;
+  Sec->Sym->IsSection = true;
+
+  if (LastSec)
+    LastSec->Next = Sec;
+  else
+    Sections = Sec;
+  LastSec = Sec;
+  return Sec;
+}
+
+//
+// 符号
+//
+
+// 查找符号，不存在时新建
+static AsmSym *getSym(char *Name) {
+  AsmSym *S = hashmapGet(&SymMap, Name);
+  if (S)
+    return S;
+
+  // 名称可能位于临时缓冲区中，因此复制
+  S = calloc(1, sizeof(AsmSym));
+  S->Name = strdup(Name);
+  hashmapPut(&SymMap, S->Name, S);
+  if (LastSym)
+    LastSym->Next = S;
+  else
+    Syms = S;
+  LastSym = S;
+  return S;
+}
+
+// 在当前位置定义符号
+static void defineSym(AsmSym *S) {
+  if (S->Sec || S->IsCommon)
+    asmError("symbol '%s' is already defined", S->Name);
+  Frag *F = dataFrag();
+  S->Sec = CurSec;
+  S->Frag = F;
+  S->Off = F->Len;
+  // TLS段内的符号
+  if (CurSec->Flags & SHF_TLS)
+    S->IsTLS = true;
+}
+
+// 数字标签N的第Idx次定义，使用汇编代码中不能出现的名称
+static AsmSym *numLabel(char *Num, int Idx) {
+  return getSym(format(".L%s\002%d", Num, Idx));
+}
+
+// 数字标签的定义次数
+static int numLabelCount(char *Num) {
+  return (intptr_t)hashmapGet(&NumLabels, Num);
+}
+
+// 定义标签
+static void defineLabel(char *Name) {
+  // 数字标签，可以被多次定义，通过Nb和Nf引用前一个和后一个定义
+  if (isdigit(*Name)) {
+    for (char *P = Name; *P; P++)
+      if (!isdigit(*P))
+        asmError("invalid label name: %s", Name);
+    int Idx = numLabelCount(Name) + 1;
+    hashmapPut(&NumLabels, Idx == 1 ? strdup(Name) : Name,
+               (void *)(intptr_t)Idx);
+    defineSym(numLabel(Name, Idx));
+    return;
+  }
+  defineSym(getSym(Name));
+}
+
+// 符号的值，布局后才能确定
+static uint64_t symValue(AsmSym *S) {
+  if (S->IsSection)
+    return 0;
+  return S->Frag->Addr + S->Off;
+}
+
+//
+// 表达式
+//
+
+// 解析表达式的项，返回常量部分，符号写入Sym
+static int64_t term(char **Rest, char *P, AsmSym **Sym) {
+  P = skipSpace(P);
+
+  // 负数
+  if (*P == '-') {
+    AsmSym *S = NULL;
+    int64_t Val = term(Rest, P + 1, &S);
+    if (S)
+      asmError("unsupported expression: cannot negate symbol %s", S->Name);
+    return -Val;
+  }
+
+  // 带括号的表达式
+  if (*P == '(') {
+    int64_t Val = term(&P, P + 1, Sym);
+    P = skipSpace(P);
+    while (*P == '+' || *P == '-') {
+      char Op = *P;
+      AsmSym *S = NULL;
+      int64_t V = term(&P, P + 1, &S);
+      if (S)
+        asmError("unsupported expression");
+      Val = Op == '+' ? Val + V : Val - V;
+      P = skipSpace(P);
+    }
+    if (*P != ')')
+      asmError("expected ')'");
+    *Rest = P + 1;
+    return Val;
+  }
+
+  if (isdigit(*P)) {
+    // 数字标签的引用，如1b和1f
+    char *Q = P;
+    while (isdigit(*Q))
+      Q++;
+    if ((*Q == 'b' || *Q == 'f') && !isSymChar(Q[1])) {
+      char *Num = strndup(P, Q - P);
+      int Idx = numLabelCount(Num);
+      if (*Q == 'f')
+        Idx++;
+      else if (Idx == 0)
+        asmError("no previous definition of label %sb", Num);
+      if (*Sym)
+        asmError("unsupported expression");
+      *Sym = numLabel(Num, Idx);
+      *Rest = Q + 1;
+      return 0;
+    }
+
+    // 数字
+    uint64_t Val = strtoull(P, &Q, 0);
+    if (isSymChar(*Q))
+      asmError("invalid number: %s", P);
+    *Rest = Q;
+    return Val;
+  }
+
+  // 字符常量
+  if (*P == '\'' && P[1] && P[2] == '\'') {
+    *Rest = P + 3;
+    return P[1];
+  }
+
+  // 符号
+  if (isSymChar(*P)) {
+    char *Q = P;
+    while (isSymChar(*Q))
+      Q++;
+    if (*Sym)
+      asmError("unsupported expression");
+    *Sym = getSym(strndup(P, Q - P));
+    // 忽略@plt
+    if (!strncmp(Q, "@plt", 4))
+      Q += 4;
+    *Rest = Q;
+    return 0;
+  }
+
+  asmError("invalid expression: %s", P);
+}
+
+// 解析表达式，结果为 符号+常量 的形式，Sym为NULL时为常量
+static int64_t expr(char *P, AsmSym **Sym) {
+  *Sym = NULL;
+  int64_t Val = term(&P, P, Sym);
+  P = skipSpace(P);
+  while (*P == '+' || *P == '-') {
+    char Op = *P;
+    AsmSym *S = NULL;
+    int64_t V = term(&P, P + 1, &S);
+    if (S) {
+      if (Op == '-' || *Sym)
+        asmError("unsupported expression");
+      *Sym = S;
+    }
+    Val = Op == '+' ? Val + V : Val - V;
+    P = skipSpace(P);
+  }
+  if (*P)
+    asmError("invalid expression: %s", P);
+  return Val;
+}
+
+// 解析常量表达式，不能含有符号
+static int64_t absExpr(char *P) {
+  AsmSym *Sym;
+  int64_t Val = expr(P, &Sym);
+  if (Sym)
+    asmError("expected a constant: %s", P);
+  return Val;
+}
+
+// 重定位修饰符
+typedef struct {
+  char *Name; // 名称
+  int U;      // 用于U型立即数的重定位
+  int I;      // 用于I型立即数的重定位
+  int S;      // 用于S型立即数的重定位
+} RelocModifier;
+
+static RelocModifier RelocModifiers[] = {
+    {"hi", R_RISCV_HI20, 0, 0},
+    {"lo", 0, R_RISCV_LO12_I, R_RISCV_LO12_S},
+    {"pcrel_hi", R_RISCV_PCREL_HI20, 0, 0},
+    {"pcrel_lo", 0, R_RISCV_PCREL_LO12_I, R_RISCV_PCREL_LO12_S},
+    {"got_pcrel_hi", R_RISCV_GOT_HI20, 0, 0},
+    {"tprel_hi", R_RISCV_TPREL_HI20, 0, 0},
+    {"tprel_lo", 0, R_RISCV_TPREL_LO12_I, R_RISCV_TPREL_LO12_S},
+    {"tls_ie_pcrel_hi", R_RISCV_TLS_GOT_HI20, 0, 0},
+    {"tls_gd_pcrel_hi", R_RISCV_TLS_GD_HI20, 0, 0},
+};
+
+// 解析形如%pcrel_hi(sym)的重定位修饰符，Kind为立即数的种类（U、I或S）
+// 返回重定位的类型，剩余部分写入Rest
+static int relocOperand(char **Rest, char *P, char Kind, AsmSym **Sym,
+                        int64_t *Addend) {
+  char *Start = strchr(P, '(');
+  if (*P != '%' || !Start)
+    asmError("invalid operand: %s", P);
+  char *Name = strndup(P + 1, Start - P - 1);
+
+  // 找到匹配的右括号
+  int Depth = 0;
+  char *End = Start;
+  for (;; End++) {
+    if (!*End)
+      asmError("expected ')': %s", P);
+    if (*End == '(')
+      Depth++;
+    else if (*End == ')' && --Depth == 0)
+      break;
+  }
+
+  for (int I = 0; I < sizeof(RelocModifiers) / sizeof(*RelocModifiers); I++) {
+    RelocModifier *M = &RelocModifiers[I];
+    if (strcmp(M->Name, Name))
+      continue;
+    int Type = Kind == 'U' ? M->U : Kind == 'I' ? M->I : M->S;
+    if (!Type)
+      asmError("%%%s cannot be used here", Name);
+    *Addend = expr(strndup(Start + 1, End - Start - 1), Sym);
+    if (!*Sym)
+      asmError("%%%s requires a symbol", Name);
+    *Rest = End + 1;
+    return Type;
+  }
+  asmError("unknown relocation modifier %%%s", Name);
+}
+
+//
+// 指令编码
+//
+
+static char *XRegNames[] = {
+    "zero", "ra", "sp", "gp", "tp",  "t0",  "t1", "t2", "s0", "s1", "a0",
+    "a1",   "a2", "a3", "a4", "a5",  "a6",  "a7", "s2", "s3", "s4", "s5",
+    "s6",   "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+};
+
+static char *FRegNames[] = {
+    "ft0", "ft1", "ft2",  "ft3",  "ft4", "ft5", "ft6",  "ft7",
+    "fs0", "fs1", "fa0",  "fa1",  "fa2", "fa3", "fa4",  "fa5",
+    "fa6", "fa7", "fs2",  "fs3",  "fs4", "fs5", "fs6",  "fs7",
+    "fs8", "fs9", "fs10", "fs11", "ft8", "ft9", "ft10", "ft11",
+};
+
+// 解析xN形式的寄存器编号
+static int regNum(char *S, char Prefix) {
+  if (*S != Prefix || !isdigit(S[1]))
+    return -1;
+  char *End;
+  long N = strtol(S + 1, &End, 10);
+  return (*End || N > 31) ? -1 : N;
+}
+
+// 寄存器名称到编号的映射，值为编号加1，浮点寄存器的编号再加32
+static HashMap RegMap;
+
+// 寄存器的编号，Float为真时为浮点寄存器，不是时返回-1
+static int regByName(char *S, bool Float) {
+  int N = (intptr_t)hashmapGet(&RegMap, S) - 1;
+  if (N >= 0)
+    return (N >= 32) == Float ? N % 32 : -1;
+  return regNum(S, Float ? 'f' : 'x');
+}
+
+// 整数寄存器的编号，不是时返回-1
+static int xReg(char *S) { return regByName(S, false); }
+
+// I型立即数
+static uint32_t encI(int64_t Imm) { return (Imm & 0xfff) << 20; }
+
+// S型立即数
+static uint32_t encS(int64_t Imm) {
+  return ((Imm >> 5 & 0x7f) << 25) | ((Imm & 0x1f) << 7);
+}
+
+// B型立即数
+static uint32_t encB(int64_t Off) {
+  return ((Off >> 12 & 1) << 31) | ((Off >> 5 & 0x3f) << 25) |
+         ((Off >> 1 & 0xf) << 8) | ((Off >> 11 & 1) << 7);
+}
+
+// J型立即数
+static uint32_t encJ(int64_t Off) {
+  return ((Off >> 20 & 1) << 31) | ((Off >> 1 & 0x3ff) << 21) |
+         ((Off >> 11 & 1) << 20) | ((Off >> 12 & 0xff) << 12);
+}
+
+// 检查立即数是否能用Bits位有符号数表示
+static int64_t checkSImm(int64_t Imm, int Bits) {
+  if (Imm < -(1LL << (Bits - 1)) || Imm >= (1LL << (Bits - 1)))
+    asmError("immediate %ld out of range [%lld, %lld]", Imm,
+             -(1LL << (Bits - 1)), (1LL << (Bits - 1)) - 1);
+  return Imm;
+}
+
+// 检查立即数是否能用Bits位无符号数表示
+static int64_t checkUImm(int64_t Imm, int Bits) {
+  if (Imm < 0 || Imm >= (1LL << Bits))
+    asmError("immediate %ld out of range [0, %lld]", Imm, (1LL << Bits) - 1);
+  return Imm;
+}
+
+// 指令的编码表
+// Args描述了操作数，每个字符为一个操作数：
+//   d/D 整数/浮点目的寄存器    s/S 整数/浮点源寄存器1
+//   t/T 整数/浮点源寄存器2     R 浮点源寄存器3
+//   m 可以省略的舍入模式，默认为dyn
+//   j I型立即数   u U型立即数   o 读取的地址imm(rs1)   q 写入的地址imm(rs1)
+//   A 原子操作的地址(rs1)   > 6位移位量   < 5位移位量
+//   p 条件跳转的目标   a jal的目标   P/Q fence的前序/后序集合
+//   c CSR   Z 5位无符号立即数   E %tprel_add
+typedef struct {
+  char *Name;     // 名称
+  char *Args;     // 操作数
+  uint32_t Match; // 除去操作数的编码
+} InsnDesc;
+
+#define OP(F7, F3, Opc) (((uint32_t)(F7) << 25) | ((F3) << 12) | (Opc))
+#define RS2(N) ((N) << 20)
+#define AMO(F5, F3) (((uint32_t)(F5) << 27) | ((F3) << 12) | 0x2f)
+#define RA (1 << 7)
+
+static InsnDesc Insns[] = {
+    // RV64I
+    {"lui", "d,u", 0x37},
+    {"auipc", "d,u", 0x17},
+    {"jal", "d,a", 0x6f},
+    {"jal", "a", 0x6f | RA},
+    {"jalr", "d,o", OP(0, 0, 0x67)},
+    {"jalr", "d,s,j", OP(0, 0, 0x67)},
+    {"jalr", "s", OP(0, 0, 0x67) | RA},
+    {"beq", "s,t,p", OP(0, 0, 0x63)},
+    {"bne", "s,t,p", OP(0, 1, 0x63)},
+    {"blt", "s,t,p", OP(0, 4, 0x63)},
+    {"bge", "s,t,p", OP(0, 5, 0x63)},
+    {"bltu", "s,t,p", OP(0, 6, 0x63)},
+    {"bgeu", "s,t,p", OP(0, 7, 0x63)},
+    {"lb", "d,o", OP(0, 0, 0x03)},
+    {"lh", "d,o", OP(0, 1, 0x03)},
+    {"lw", "d,o", OP(0, 2, 0x03)},
+    {"ld", "d,o", OP(0, 3, 0x03)},
+    {"lbu", "d,o", OP(0, 4, 0x03)},
+    {"lhu", "d,o", OP(0, 5, 0x03)},
+    {"lwu", "d,o", OP(0, 6, 0x03)},
+    {"sb", "t,q", OP(0, 0, 0x23)},
+    {"sh", "t,q", OP(0, 1, 0x23)},
+    {"sw", "t,q", OP(0, 2, 0x23)},
+    {"sd", "t,q", OP(0, 3, 0x23)},
+    {"addi", "d,s,j", OP(0, 0, 0x13)},
+    {"slti", "d,s,j", OP(0, 2, 0x13)},
+    {"sltiu", "d,s,j", OP(0, 3, 0x13)},
+    {"xori", "d,s,j", OP(0, 4, 0x13)},
+    {"ori", "d,s,j", OP(0, 6, 0x13)},
+    {"andi", "d,s,j", OP(0, 7, 0x13)},
+    {"slli", "d,s,>", OP(0, 1, 0x13)},
+    {"srli", "d,s,>", OP(0, 5, 0x13)},
+    {"srai", "d,s,>", OP(0x20, 5, 0x13)},
+    {"addiw", "d,s,j", OP(0, 0, 0x1b)},
+    {"slliw", "d,s,<", OP(0, 1, 0x1b)},
+    {"srliw", "d,s,<", OP(0, 5, 0x1b)},
+    {"sraiw", "d,s,<", OP(0x20, 5, 0x1b)},
+    {"add", "d,s,t", OP(0, 0, 0x33)},
+    {"add", "d,s,t,E", OP(0, 0, 0x33)},
+    {"sub", "d,s,t", OP(0x20, 0, 0x33)},
+    {"sll", "d,s,t", OP(0, 1, 0x33)},
+    {"slt", "d,s,t", OP(0, 2, 0x33)},
+    {"sltu", "d,s,t", OP(0, 3, 0x33)},
+    {"xor", "d,s,t", OP(0, 4, 0x33)},
+    {"srl", "d,s,t", OP(0, 5, 0x33)},
+    {"sra", "d,s,t", OP(0x20, 5, 0x33)},
+    {"or", "d,s,t", OP(0, 6, 0x33)},
+    {"and", "d,s,t", OP(0, 7, 0x33)},
+    {"addw", "d,s,t", OP(0, 0, 0x3b)},
+    {"subw", "d,s,t", OP(0x20, 0, 0x3b)},
+    {"sllw", "d,s,t", OP(0, 1, 0x3b)},
+    {"srlw", "d,s,t", OP(0, 5, 0x3b)},
+    {"sraw", "d,s,t", OP(0x20, 5, 0x3b)},
+    {"fence", "P,Q", 0x0f},
+    {"fence", "", 0x0ff0000f},
+    {"fence.tso", "", 0x8330000f},
+    {"fence.i", "", 0x100f},
+    {"ecall", "", 0x73},
+    {"ebreak", "", 0x00100073},
+    {"wfi", "", 0x10500073},
+
+    // Zicsr
+    {"csrrw", "d,c,s", OP(0, 1, 0x73)},
+    {"csrrs", "d,c,s", OP(0, 2, 0x73)},
+    {"csrrc", "d,c,s", OP(0, 3, 0x73)},
+    {"csrrwi", "d,c,Z", OP(0, 5, 0x73)},
+    {"csrrsi", "d,c,Z", OP(0, 6, 0x73)},
+    {"csrrci", "d,c,Z", OP(0, 7, 0x73)},
+
+    // M扩展
+    {"mul", "d,s,t", OP(1, 0, 0x33)},
+    {"mulh", "d,s,t", OP(1, 1, 0x33)},
+    {"mulhsu", "d,s,t", OP(1, 2, 0x33)},
+    {"mulhu", "d,s,t", OP(1, 3, 0x33)},
+    {"div", "d,s,t", OP(1, 4, 0x33)},
+    {"divu", "d,s,t", OP(1, 5, 0x33)},
+    {"rem", "d,s,t", OP(1, 6, 0x33)},
+    {"remu", "d,s,t", OP(1, 7, 0x33)},
+    {"mulw", "d,s,t", OP(1, 0, 0x3b)},
+    {"divw", "d,s,t", OP(1, 4, 0x3b)},
+    {"divuw", "d,s,t", OP(1, 5, 0x3b)},
+    {"remw", "d,s,t", OP(1, 6, 0x3b)},
+    {"remuw", "d,s,t", OP(1, 7, 0x3b)},
+
+    // A扩展，.aq、.rl和.aqrl后缀在查表前去除
+    {"lr.w", "d,A", AMO(0x02, 2)},
+    {"lr.d", "d,A", AMO(0x02, 3)},
+    {"sc.w", "d,t,A", AMO(0x03, 2)},
+    {"sc.d", "d,t,A", AMO(0x03, 3)},
+    {"amoswap.w", "d,t,A", AMO(0x01, 2)},
+    {"amoswap.d", "d,t,A", AMO(0x01, 3)},
+    {"amoadd.w", "d,t,A", AMO(0x00, 2)},
+    {"amoadd.d", "d,t,A", AMO(0x00, 3)},
+    {"amoxor.w", "d,t,A", AMO(0x04, 2)},
+    {"amoxor.d", "d,t,A", AMO(0x04, 3)},
+    {"amoand.w", "d,t,A", AMO(0x0c, 2)},
+    {"amoand.d", "d,t,A", AMO(0x0c, 3)},
+    {"amoor.w", "d,t,A", AMO(0x08, 2)},
+    {"amoor.d", "d,t,A", AMO(0x08, 3)},
+    {"amomin.w", "d,t,A", AMO(0x10, 2)},
+    {"amomin.d", "d,t,A", AMO(0x10, 3)},
+    {"amomax.w", "d,t,A", AMO(0x14, 2)},
+    {"amomax.d", "d,t,A", AMO(0x14, 3)},
+    {"amominu.w", "d,t,A", AMO(0x18, 2)},
+    {"amominu.d", "d,t,A", AMO(0x18, 3)},
+    {"amomaxu.w", "d,t,A", AMO(0x1c, 2)},
+    {"amomaxu.d", "d,t,A", AMO(0x1c, 3)},
+
+    // F和D扩展
+    {"flw", "D,o", OP(0, 2, 0x07)},
+    {"fld", "D,o", OP(0, 3, 0x07)},
+    {"fsw", "T,q", OP(0, 2, 0x27)},
+    {"fsd", "T,q", OP(0, 3, 0x27)},
+    {"fmadd.s", "D,S,T,R,m", OP(0, 0, 0x43)},
+    {"fmadd.d", "D,S,T,R,m", OP(1, 0, 0x43)},
+    {"fmsub.s", "D,S,T,R,m", OP(0, 0, 0x47)},
+    {"fmsub.d", "D,S,T,R,m", OP(1, 0, 0x47)},
+    {"fnmsub.s", "D,S,T,R,m", OP(0, 0, 0x4b)},
+    {"fnmsub.d", "D,S,T,R,m", OP(1, 0, 0x4b)},
+    {"fnmadd.s", "D,S,T,R,m", OP(0, 0, 0x4f)},
+    {"fnmadd.d", "D,S,T,R,m", OP(1, 0, 0x4f)},
+    {"fadd.s", "D,S,T,m", OP(0x00, 0, 0x53)},
+    {"fadd.d", "D,S,T,m", OP(0x01, 0, 0x53)},
+    {"fsub.s", "D,S,T,m", OP(0x04, 0, 0x53)},
+    {"fsub.d", "D,S,T,m", OP(0x05, 0, 0x53)},
+    {"fmul.s", "D,S,T,m", OP(0x08, 0, 0x53)},
+    {"fmul.d", "D,S,T,m", OP(0x09, 0, 0x53)},
+    {"fdiv.s", "D,S,T,m", OP(0x0c, 0, 0x53)},
+    {"fdiv.d", "D,S,T,m", OP(0x0d, 0, 0x53)},
+    {"fsqrt.s", "D,S,m", OP(0x2c, 0, 0x53)},
+    {"fsqrt.d", "D,S,m", OP(0x2d, 0, 0x53)},
+    {"fsgnj.s", "D,S,T", OP(0x10, 0, 0x53)},
+    {"fsgnj.d", "D,S,T", OP(0x11, 0, 0x53)},
+    {"fsgnjn.s", "D,S,T", OP(0x10, 1, 0x53)},
+    {"fsgnjn.d", "D,S,T", OP(0x11, 1, 0x53)},
+    {"fsgnjx.s", "D,S,T", OP(0x10, 2, 0x53)},
+    {"fsgnjx.d", "D,S,T", OP(0x11, 2, 0x53)},
+    {"fmin.s", "D,S,T", OP(0x14, 0, 0x53)},
+    {"fmin.d", "D,S,T", OP(0x15, 0, 0x53)},
+    {"fmax.s", "D,S,T", OP(0x14, 1, 0x53)},
+    {"fmax.d", "D,S,T", OP(0x15, 1, 0x53)},
+    {"fcvt.s.d", "D,S,m", OP(0x20, 0, 0x53) | RS2(1)},
+    {"fcvt.d.s", "D,S", OP(0x21, 0, 0x53)},
+    {"feq.s", "d,S,T", OP(0x50, 2, 0x53)},
+    {"feq.d", "d,S,T", OP(0x51, 2, 0x53)},
+    {"flt.s", "d,S,T", OP(0x50, 1, 0x53)},
+    {"flt.d", "d,S,T", OP(0x51, 1, 0x53)},
+    {"fle.s", "d,S,T", OP(0x50, 0, 0x53)},
+    {"fle.d", "d,S,T", OP(0x51, 0, 0x53)},
+    {"fclass.s", "d,S", OP(0x70, 1, 0x53)},
+    {"fclass.d", "d,S", OP(0x71, 1, 0x53)},
+    {"fmv.x.w", "d,S", OP(0x70, 0, 0x53)},
+    {"fmv.x.s", "d,S", OP(0x70, 0, 0x53)},
+    {"fmv.x.d", "d,S", OP(0x71, 0, 0x53)},
+    {"fmv.w.x", "D,s", OP(0x78, 0, 0x53)},
+    {"fmv.s.x", "D,s", OP(0x78, 0, 0x53)},
+    {"fmv.d.x", "D,s", OP(0x79, 0, 0x53)},
+    {"fcvt.w.s", "d,S,m", OP(0x60, 0, 0x53) | RS2(0)},
+    {"fcvt.wu.s", "d,S,m", OP(0x60, 0, 0x53) | RS2(1)},
+    {"fcvt.l.s", "d,S,m", OP(0x60, 0, 0x53) | RS2(2)},
+    {"fcvt.lu.s", "d,S,m", OP(0x60, 0, 0x53) | RS2(3)},
+    {"fcvt.w.d", "d,S,m", OP(0x61, 0, 0x53) | RS2(0)},
+    {"fcvt.wu.d", "d,S,m", OP(0x61, 0, 0x53) | RS2(1)},
+    {"fcvt.l.d", "d,S,m", OP(0x61, 0, 0x53) | RS2(2)},
+    {"fcvt.lu.d", "d,S,m", OP(0x61, 0, 0x53) | RS2(3)},
+    {"fcvt.s.w", "D,s,m", OP(0x68, 0, 0x53) | RS2(0)},
+    {"fcvt.s.wu", "D,s,m", OP(0x68, 0, 0x53) | RS2(1)},
+    {"fcvt.s.l", "D,s,m", OP(0x68, 0, 0x53) | RS2(2)},
+    {"fcvt.s.lu", "D,s,m", OP(0x68, 0, 0x53) | RS2(3)},
+    {"fcvt.d.w", "D,s", OP(0x69, 0, 0x53) | RS2(0)},
+    {"fcvt.d.wu", "D,s", OP(0x69, 0, 0x53) | RS2(1)},
+    {"fcvt.d.l", "D,s,m", OP(0x69, 0, 0x53) | RS2(2)},
+    {"fcvt.d.lu", "D,s,m", OP(0x69, 0, 0x53) | RS2(3)},
+};
+
+// 伪指令，展开为基础指令，%N为第N个操作数
+typedef struct {
+  char *Name;      // 名称
+  int Argc;        // 操作数的数量
+  char *Expansion; // 展开后的指令
+} Pseudo;
+
+static Pseudo Pseudos[] = {
+    {"nop", 0, "addi zero, zero, 0"},
+    {"mv", 2, "addi %0, %1, 0"},
+    {"not", 2, "xori %0, %1, -1"},
+    {"neg", 2, "sub %0, zero, %1"},
+    {"negw", 2, "subw %0, zero, %1"},
+    {"sext.w", 2, "addiw %0, %1, 0"},
+    {"seqz", 2, "sltiu %0, %1, 1"},
+    {"snez", 2, "sltu %0, zero, %1"},
+    {"sltz", 2, "slt %0, %1, zero"},
+    {"sgtz", 2, "slt %0, zero, %1"},
+    {"beqz", 2, "beq %0, zero, %1"},
+    {"bnez", 2, "bne %0, zero, %1"},
+    {"blez", 2, "bge zero, %0, %1"},
+    {"bgez", 2, "bge %0, zero, %1"},
+    {"bltz", 2, "blt %0, zero, %1"},
+    {"bgtz", 2, "blt zero, %0, %1"},
+    {"bgt", 3, "blt %1, %0, %2"},
+    {"ble", 3, "bge %1, %0, %2"},
+    {"bgtu", 3, "bltu %1, %0, %2"},
+    {"bleu", 3, "bgeu %1, %0, %2"},
+    {"j", 1, "jal zero, %0"},
+    {"jr", 1, "jalr zero, %0, 0"},
+    {"ret", 0, "jalr zero, 0(ra)"},
+    {"fmv.s", 2, "fsgnj.s %0, %1, %1"},
+    {"fmv.d", 2, "fsgnj.d %0, %1, %1"},
+    {"fneg.s", 2, "fsgnjn.s %0, %1, %1"},
+    {"fneg.d", 2, "fsgnjn.d %0, %1, %1"},
+    {"fabs.s", 2, "fsgnjx.s %0, %1, %1"},
+    {"fabs.d", 2, "fsgnjx.d %0, %1, %1"},
+    {"csrr", 2, "csrrs %0, %1, zero"},
+    {"csrw", 2, "csrrw zero, %0, %1"},
+    {"frflags", 1, "csrrs %0, fflags, zero"},
+    {"fsflags", 1, "csrrw zero, fflags, %0"},
+    {"frrm", 1, "csrrs %0, frm, zero"},
+    {"fsrm", 1, "csrrw zero, frm, %0"},
+    {"frcsr", 1, "csrrs %0, fcsr, zero"},
+    {"fscsr", 1, "csrrw zero, fcsr, %0"},
+    {"rdcycle", 1, "csrrs %0, cycle, zero"},
+    {"rdtime", 1, "csrrs %0, time, zero"},
+    {"rdinstret", 1, "csrrs %0, instret, zero"},
+};
+
+// 指令名称到编码表中第一个同名指令的映射
+static HashMap InsnMap;
+// 伪指令名称到伪指令表中第一个同名伪指令的映射
+static HashMap PseudoMap;
+
+// 初始化寄存器、指令和伪指令的查找表
+static void initTables(void) {
+  if (RegMap.Capacity)
+    return;
+  for (int I = 0; I < 32; I++) {
+    hashmapPut(&RegMap, XRegNames[I], (void *)(intptr_t)(I + 1));
+    hashmapPut(&RegMap, FRegNames[I], (void *)(intptr_t)(I + 33));
+  }
+  hashmapPut(&RegMap, "fp", (void *)(intptr_t)(8 + 1));
+
+  int Num = sizeof(Insns) / sizeof(*Insns);
+  for (int I = Num - 1; I >= 0; I--)
+    hashmapPut(&InsnMap, Insns[I].Name, &Insns[I]);
+  Num = sizeof(Pseudos) / sizeof(*Pseudos);
+  for (int I = Num - 1; I >= 0; I--)
+    hashmapPut(&PseudoMap, Pseudos[I].Name, &Pseudos[I]);
+}
+
+// 指令的操作数，寄存器和数字在解析时识别，编码时不再重复解析
+typedef struct {
+  char *Text;     // 文本
+  int XReg;       // 整数寄存器的编号，不是时为-1
+  int FReg;       // 浮点寄存器的编号，不是时为-1
+  bool IsNum;     // 是否为数字
+  int64_t Num;    // 数字的值
+  int MemReg;     // 内存操作数imm(rs1)中rs1的编号，不是内存操作数时为-1
+  char *MemImm;   // 内存操作数中的imm，可以为空
+  bool MemIsNum;  // imm是否为数字，为空时视为0
+  int64_t MemNum; // imm的值
+} Operand;
+
+// 解析数字，规则与term相同，不是单独的数字时返回false
+static bool parseNum(char *S, int64_t *Val) {
+  bool Neg = *S == '-';
+  if (Neg)
+    S++;
+  if (!isdigit(*S))
+    return false;
+  char *End;
+  uint64_t V = strtoull(S, &End, 0);
+  if (*End)
+    return false;
+  *Val = Neg ? -V : V;
+  return true;
+}
+
+// 解析操作数，识别寄存器、数字和内存操作数
+static void initOperand(Operand *Op, char *Text) {
+  Op->Text = Text;
+  int N = (intptr_t)hashmapGet(&RegMap, Text) - 1;
+  if (N >= 0) {
+    Op->XReg = N < 32 ? N : -1;
+    Op->FReg = N >= 32 ? N - 32 : -1;
+  } else {
+    Op->XReg = regNum(Text, 'x');
+    Op->FReg = regNum(Text, 'f');
+  }
+  Op->IsNum = parseNum(Text, &Op->Num);
+
+  // 内存操作数imm(rs1)
+  Op->MemReg = -1;
+  int Len = strlen(Text);
+  char *Open = strrchr(Text, '(');
+  if (!Open || Text[Len - 1] != ')')
+    return;
+  char Reg[8];
+  int RegLen = Text + Len - 1 - (Open + 1);
+  if (RegLen >= sizeof(Reg))
+    return;
+  memcpy(Reg, Open + 1, RegLen);
+  Reg[RegLen] = '\0';
+  if ((Op->MemReg = xReg(Reg)) < 0)
+    return;
+  Op->MemImm = trim(scratchDup(Text, Open - Text));
+  Op->MemNum = 0;
+  Op->MemIsNum = !*Op->MemImm || parseNum(Op->MemImm, &Op->MemNum);
+}
+
+// 操作数需要在语句之外使用时，复制临时缓冲区中的内容
+static void persistOperand(Operand *Op) {
+  if (Op->MemReg >= 0)
+    Op->MemImm = strdup(Op->MemImm);
+}
+
+// 操作数的常量值
+static int64_t numOperand(Operand *Op) {
+  return Op->IsNum ? Op->Num : absExpr(Op->Text);
+}
+
+// fence的前序或后序集合
+static int fenceSet(char *A) {
+  int Set = 0;
+  for (char *P = A; *P; P++) {
+    char *Q = strchr("wroi", *P);
+    if (!Q)
+      return -1;
+    Set |= 1 << (Q - "wroi");
+  }
+  return Set;
+}
+
+// CSR的编号
+static int csrNum(char *A) {
+  static struct {
+    char *Name;
+    int Num;
+  } CSRs[] = {
+      {"fflags", 0x001}, {"frm", 0x002},   {"fcsr", 0x003},
+      {"cycle", 0xc00},  {"time", 0xc01},  {"instret", 0xc02},
+  };
+  for (int I = 0; I < sizeof(CSRs) / sizeof(*CSRs); I++)
+    if (!strcmp(A, CSRs[I].Name))
+      return CSRs[I].Num;
+  if (isdigit(*A))
+    return checkUImm(absExpr(A), 12);
+  return -1;
+}
+
+// 舍入模式
+static int roundingMode(char *A) {
+  static char *Modes[] = {"rne", "rtz", "rdn", "rup", "rmm", "", "", "dyn"};
+  for (int I = 0; I < 8; I++)
+    if (*Modes[I] && !strcmp(A, Modes[I]))
+      return I;
+  return -1;
+}
+
+// 写入一条指令，Type不为0时生成重定位
+static void emitInsn(uint32_t Insn, int Type, AsmSym *Sym, int64_t Addend) {
+  Frag *F = dataFrag();
+  if (Type)
+    addFixup(F, F->Len, Type, Sym, Addend);
+  emitInt(Insn, 4);
+}
+
+// 是否为压缩指令可以使用的x8～x15
+static bool isCReg(int R) { return R >= 8 && R < 16; }
+
+// Val是否为Bits位有符号数
+static bool fitsS(int64_t Val, int Bits) {
+  return Val >= -(1LL << (Bits - 1)) && Val < (1LL << (Bits - 1));
+}
+
+// Val是否为Scale的倍数，并且小于Limit
+static bool fitsU(int64_t Val, int Scale, int Limit) {
+  return Val >= 0 && Val < Limit && Val % Scale == 0;
+}
+
+// 压缩指令中6位立即数的编码，imm[5]位于第12位，imm[4:0]位于第6～2位
+static uint32_t encCI(int64_t Imm) {
+  return ((Imm >> 5 & 1) << 12) | ((Imm & 0x1f) << 2);
+}
+
+// 将没有重定位的指令压缩为16位，不能压缩时返回0
+// 条件跳转和jal的偏移量在布局时才能确定，不进行压缩
+static uint32_t compress(uint32_t Insn) {
+  int Opc = Insn & 0x7f, Rd = Insn >> 7 & 31, F3 = Insn >> 12 & 7;
+  int Rs1 = Insn >> 15 & 31, Rs2 = Insn >> 20 & 31, F7 = Insn >> 25;
+  int64_t ImmI = (int32_t)Insn >> 20;
+  int64_t ImmS = ((int32_t)Insn >> 25 << 5) | Rd;
+  // 压缩指令中x8～x15的编号
+  int Rd3 = (Rd - 8) & 7, Rs13 = (Rs1 - 8) & 7, Rs23 = (Rs2 - 8) & 7;
+
+  switch (Opc) {
+  // addi、slli、srli、srai和andi
+  case 0x13:
+    if (F3 == 0) {
+      if (Rd == 0 && Rs1 == 0 && ImmI == 0)
+        return 0x0001; // c.nop
+      if (Rd == 0)
+        break;
+      if (Rs1 == 0 && fitsS(ImmI, 6))
+        return 0x4001 | Rd << 7 | encCI(ImmI); // c.li
+      if (Rd == Rs1 && ImmI != 0 && fitsS(ImmI, 6))
+        return 0x0001 | Rd << 7 | encCI(ImmI); // c.addi
+      if (Rd == 2 && Rs1 == 2 && ImmI != 0 && ImmI % 16 == 0 &&
+          fitsS(ImmI, 10))
+        // c.addi16sp
+        return 0x6101 | (ImmI >> 9 & 1) << 12 | (ImmI >> 4 & 1) << 6 |
+               (ImmI >> 6 & 1) << 5 | (ImmI >> 7 & 3) << 3 |
+               (ImmI >> 5 & 1) << 2;
+      if (Rs1 == 2 && isCReg(Rd) && ImmI != 0 && fitsU(ImmI, 4, 1024))
+        // c.addi4spn
+        return 0x0000 | (ImmI >> 4 & 3) << 11 | (ImmI >> 6 & 0xf) << 7 |
+               (ImmI >> 2 & 1) << 6 | (ImmI >> 3 & 1) << 5 | Rd3 << 2;
+      if (ImmI == 0 && Rs1 != 0)
+        return 0x8002 | Rd << 7 | Rs1 << 2; // c.mv
+      break;
+    }
+    if (Rd != Rs1 || Rd == 0)
+      break;
+    int Shamt = ImmI & 0x3f;
+    if (F3 == 1 && Shamt)
+      return 0x0002 | Rd << 7 | encCI(Shamt); // c.slli
+    if (!isCReg(Rd))
+      break;
+    if (F3 == 5 && Shamt && (F7 >> 1) == 0)
+      return 0x8001 | Rd3 << 7 | encCI(Shamt); // c.srli
+    if (F3 == 5 && Shamt && (F7 >> 1) == 0x10)
+      return 0x8401 | Rd3 << 7 | encCI(Shamt); // c.srai
+    if (F3 == 7 && fitsS(ImmI, 6))
+      return 0x8801 | Rd3 << 7 | encCI(ImmI); // c.andi
+    break;
+  // addiw
+  case 0x1b:
+    if (F3 == 0 && Rd != 0 && Rd == Rs1 && fitsS(ImmI, 6))
+      return 0x2001 | Rd << 7 | encCI(ImmI); // c.addiw
+    break;
+  // add、sub、xor、or和and
+  case 0x33:
+    if (Rd == 0)
+      break;
+    if (F7 == 0 && F3 == 0) {
+      if (Rs1 == 0 && Rs2 != 0)
+        return 0x8002 | Rd << 7 | Rs2 << 2; // c.mv
+      if (Rd == Rs1 && Rs2 != 0)
+        return 0x9002 | Rd << 7 | Rs2 << 2; // c.add
+      if (Rd == Rs2 && Rs1 != 0)
+        return 0x9002 | Rd << 7 | Rs1 << 2; // c.add
+      break;
+    }
+    if (!isCReg(Rd) || !isCReg(Rs1) || !isCReg(Rs2))
+      break;
+    // 除sub外满足交换律
+    int Other = Rd == Rs1 ? Rs23 : Rs13;
+    if (Rd != Rs1 && (Rd != Rs2 || (F7 == 0x20 && F3 == 0)))
+      break;
+    if (F7 == 0x20 && F3 == 0)
+      return 0x8c01 | Rd3 << 7 | Other << 2; // c.sub
+    if (F7 == 0 && F3 == 4)
+      return 0x8c21 | Rd3 << 7 | Other << 2; // c.xor
+    if (F7 == 0 && F3 == 6)
+      return 0x8c41 | Rd3 << 7 | Other << 2; // c.or
+    if (F7 == 0 && F3 == 7)
+      return 0x8c61 | Rd3 << 7 | Other << 2; // c.and
+    break;
+  // addw和subw
+  case 0x3b: {
+    if (F3 != 0 || !isCReg(Rd) || !isCReg(Rs1) || !isCReg(Rs2))
+      break;
+    int Other = Rd == Rs1 ? Rs23 : Rs13;
+    if (Rd != Rs1 && (Rd != Rs2 || F7 == 0x20))
+      break;
+    if (F7 == 0x20)
+      return 0x9c01 | Rd3 << 7 | Other << 2; // c.subw
+    if (F7 == 0)
+      return 0x9c21 | Rd3 << 7 | Other << 2; // c.addw
+    break;
+  }
+  // lui
+  case 0x37: {
+    int64_t Imm = (int32_t)Insn >> 12;
+    if (Rd != 0 && Rd != 2 && Imm != 0 && fitsS(Imm, 6))
+      return 0x6001 | Rd << 7 | encCI(Imm); // c.lui
+    break;
+  }
+  // lw、ld和fld
+  case 0x03:
+  case 0x07: {
+    bool IsFloat = Opc == 0x07;
+    if (!(F3 == 3 || (F3 == 2 && !IsFloat)))
+      break;
+    int Scale = F3 == 2 ? 4 : 8;
+    if (Rs1 == 2 && (IsFloat || Rd != 0) && fitsU(ImmI, Scale, Scale * 64)) {
+      // c.lwsp、c.ldsp和c.fldsp
+      uint32_t Base = F3 == 2 ? 0x4002 : IsFloat ? 0x2002 : 0x6002;
+      uint32_t Lo = F3 == 2 ? (ImmI >> 2 & 7) << 4 | (ImmI >> 6 & 3) << 2
+                            : (ImmI >> 3 & 3) << 5 | (ImmI >> 6 & 7) << 2;
+      return Base | (ImmI >> 5 & 1) << 12 | Rd << 7 | Lo;
+    }
+    if (isCReg(Rd) && isCReg(Rs1) && fitsU(ImmI, Scale, Scale * 32)) {
+      // c.lw、c.ld和c.fld
+      uint32_t Base = F3 == 2 ? 0x4000 : IsFloat ? 0x2000 : 0x6000;
+      uint32_t Lo = F3 == 2 ? (ImmI >> 2 & 1) << 6 | (ImmI >> 6 & 1) << 5
+                            : (ImmI >> 6 & 3) << 5;
+      return Base | (ImmI >> 3 & 7) << 10 | Rs13 << 7 | Lo | Rd3 << 2;
+    }
+    break;
+  }
+  // sw、sd和fsd
+  case 0x23:
+  case 0x27: {
+    bool IsFloat = Opc == 0x27;
+    if (!(F3 == 3 || (F3 == 2 && !IsFloat)))
+      break;
+    int Scale = F3 == 2 ? 4 : 8;
+    if (Rs1 == 2 && fitsU(ImmS, Scale, Scale * 64)) {
+      // c.swsp、c.sdsp和c.fsdsp
+      uint32_t Base = F3 == 2 ? 0xc002 : IsFloat ? 0xa002 : 0xe002;
+      uint32_t Hi = F3 == 2 ? (ImmS >> 2 & 0xf) << 9 | (ImmS >> 6 & 3) << 7
+                            : (ImmS >> 3 & 7) << 10 | (ImmS >> 6 & 7) << 7;
+      return Base | Hi | Rs2 << 2;
+    }
+    if (isCReg(Rs2) && isCReg(Rs1) && fitsU(ImmS, Scale, Scale * 32)) {
+      // c.sw、c.sd和c.fsd
+      uint32_t Base = F3 == 2 ? 0xc000 : IsFloat ? 0xa000 : 0xe000;
+      uint32_t Lo = F3 == 2 ? (ImmS >> 2 & 1) << 6 | (ImmS >> 6 & 1) << 5
+                            : (ImmS >> 6 & 3) << 5;
+      return Base | (ImmS >> 3 & 7) << 10 | Rs13 << 7 | Lo | Rs23 << 2;
+    }
+    break;
+  }
+  // jalr
+  case 0x67:
+    if (F3 != 0 || ImmI != 0 || Rs1 == 0)
+      break;
+    if (Rd == 0)
+      return 0x8002 | Rs1 << 7; // c.jr
+    if (Rd == 1)
+      return 0x9002 | Rs1 << 7; // c.jalr
+    break;
+  // ebreak
+  case 0x73:
+    if (Insn == 0x00100073)
+      return 0x9002; // c.ebreak
+    break;
+  }
+  return 0;
+}
+
+// 写入一条没有重定位的指令，可以压缩时写入压缩指令
+static void emitInsnC(uint32_t Insn) {
+  uint32_t C = OptionRVC ? compress(Insn) : 0;
+  if (!C) {
+    emitInt(Insn, 4);
+    return;
+  }
+  emitInt(C, 2);
+  UsesRVC = true;
+}
+
+// 按照Desc编码指令，操作数不匹配时返回false
+static bool encodeInsn(InsnDesc *Desc, int Argc, Operand *Ops,
+                       uint32_t Extra) {
+  uint32_t Insn = Desc->Match | Extra;
+  // 重定位
+  int Type = 0;
+  AsmSym *Sym = NULL;
+  int64_t Addend = 0;
+  // 跳转的种类
+  FragKind Kind = FRAG_DATA;
+
+  int N = 0;
+  for (char *P = Desc->Args; *P; P++) {
+    if (*P == ',')
+      continue;
+    Operand *A = N < Argc ? &Ops[N] : NULL;
+    N++;
+    if (!A) {
+      // 省略舍入模式时为dyn
+      if (*P == 'm') {
+        Insn |= 7 << 12;
+        continue;
+      }
+      return false;
+    }
+
+    int R;
+    switch (*P) {
+    case 'd':
+    case 's':
+    case 't':
+      if ((R = A->XReg) < 0)
+        return false;
+      Insn |= R << (*P == 'd' ? 7 : *P == 's' ? 15 : 20);
+      break;
+    case 'D':
+    case 'S':
+    case 'T':
+    case 'R':
+      if ((R = A->FReg) < 0)
+        return false;
+      Insn |= (uint32_t)R
+              << (*P == 'D' ? 7 : *P == 'S' ? 15 : *P == 'T' ? 20 : 27);
+      break;
+    case 'm':
+      if ((R = roundingMode(A->Text)) < 0)
+        return false;
+      Insn |= R << 12;
+      break;
+    case 'j':
+      if (*A->Text == '%') {
+        char *Rest;
+        Type = relocOperand(&Rest, A->Text, 'I', &Sym, &Addend);
+      } else {
+        Insn |= encI(checkSImm(numOperand(A), 12));
+      }
+      break;
+    case 'u':
+      if (*A->Text == '%') {
+        char *Rest;
+        Type = relocOperand(&Rest, A->Text, 'U', &Sym, &Addend);
+      } else {
+        Insn |= checkUImm(numOperand(A), 20) << 12;
+      }
+      break;
+    case 'o':
+    case 'q':
+      if ((R = A->MemReg) < 0)
+        return false;
+      Insn |= R << 15;
+      if (*A->MemImm == '%') {
+        char *Rest;
+        Type = relocOperand(&Rest, A->MemImm, *P == 'o' ? 'I' : 'S', &Sym,
+                            &Addend);
+        if (*skipSpace(Rest))
+          asmError("invalid operand: %s", A->Text);
+      } else {
+        int64_t Val =
+            checkSImm(A->MemIsNum ? A->MemNum : absExpr(A->MemImm), 12);
+        Insn |= *P == 'o' ? encI(Val) : encS(Val);
+      }
+      break;
+    case 'A':
+      if ((R = A->MemReg) < 0)
+        return false;
+      if ((A->MemIsNum ? A->MemNum : absExpr(A->MemImm)) != 0)
+        asmError("atomic memory operand must have zero offset: %s", A->Text);
+      Insn |= R << 15;
+      break;
+    case '>':
+      Insn |= checkUImm(numOperand(A), 6) << 20;
+      break;
+    case '<':
+      Insn |= checkUImm(numOperand(A), 5) << 20;
+      break;
+    case 'p':
+    case 'a':
+      Addend = expr(A->Text, &Sym);
+      if (!Sym)
+        asmError("branch target must be a symbol: %s", A->Text);
+      Kind = *P == 'p' ? FRAG_BRANCH : FRAG_JUMP;
+      break;
+    case 'P':
+    case 'Q':
+      if ((R = fenceSet(A->Text)) < 0)
+        return false;
+      Insn |= R << (*P == 'P' ? 24 : 20);
+      break;
+    case 'c':
+      if ((R = csrNum(A->Text)) < 0)
+        return false;
+      Insn |= (uint32_t)R << 20;
+      break;
+    case 'Z':
+      Insn |= checkUImm(numOperand(A), 5) << 15;
+      break;
+    case 'E': {
+      char *T = A->Text;
+      if (strncmp(T, "%tprel_add(", 11) || T[strlen(T) - 1] != ')')
+        return false;
+      Addend = expr(strndup(T + 11, strlen(T) - 12), &Sym);
+      if (!Sym)
+        asmError("%%tprel_add requires a symbol");
+      Type = R_RISCV_TPREL_ADD;
+      break;
+    }
+    default:
+      unreachable();
+    }
+  }
+  if (Argc > N)
+    return false;
+
+  // 跳转的偏移量在布局时确定
+  if (Kind != FRAG_DATA) {
+    Frag *F = newFrag(Kind);
+    F->Insn = Insn;
+    F->Target = Sym;
+    F->Addend = Addend;
+    return true;
+  }
+  if (Type)
+    emitInsn(Insn, Type, Sym, Addend);
+  else
+    emitInsnC(Insn);
+  return true;
+}
+
+// 将立即数加载到寄存器，与LLVM的li展开方式相同
+static void emitLi(int Rd, int64_t Val) {
+  // 12位有符号立即数：addi
+  if (Val >= -2048 && Val < 2048) {
+    emitInsnC(OP(0, 0, 0x13) | Rd << 7 | encI(Val));
+    return;
+  }
+
+  // 低12位，符号扩展
+  int64_t Lo = (int64_t)((uint64_t)Val << 52) >> 52;
+
+  // 32位有符号立即数：lui + addiw
+  if (Val >= INT32_MIN && Val <= INT32_MAX) {
+    int64_t Hi = ((uint64_t)Val - Lo) >> 12 & 0xfffff;
+    emitInsnC(0x37 | Rd << 7 | Hi << 12);
+    if (Lo)
+      emitInsnC(OP(0, 0, 0x1b) | Rd << 7 | Rd << 15 | encI(Lo));
+    return;
+  }
+
+  // 其他情况：先构造高位部分，然后左移并加上低12位
+  int64_t Hi = (int64_t)((uint64_t)Val - Lo) >> 12;
+  int Shift = 12;
+  while (!(Hi & 1)) {
+    Hi >>= 1;
+    Shift++;
+  }
+  emitLi(Rd, Hi);
+  emitInsnC(OP(0, 1, 0x13) | Rd << 7 | Rd << 15 | Shift << 20);
+  if (Lo)
+    emitInsnC(OP(0, 0, 0x13) | Rd << 7 | Rd << 15 | encI(Lo));
+}
+
+// 不在编码表中、需要单独处理的指令
+typedef enum {
+  SPECIAL_NONE,
+  SPECIAL_CNOP, // c.nop，唯一支持的压缩指令
+  SPECIAL_LI,   // li rd, imm
+  SPECIAL_CALL, // call sym
+  SPECIAL_TAIL, // tail sym
+  SPECIAL_LA,   // la和lla
+} SpecialKind;
+
+// 助记符的解析结果
+typedef struct {
+  char *Name;          // 名称
+  Pseudo *Ps;          // 伪指令表中第一个同名的伪指令
+  SpecialKind Special; // 需要单独处理的指令
+  InsnDesc *Desc;      // 编码表中第一个同名的指令
+  uint32_t Extra;      // 原子指令的.aq和.rl位
+} Mnemonic;
+
+// 解析助记符，不支持时返回false
+static bool resolveMnemonic(char *Name, Mnemonic *M) {
+  *M = (Mnemonic){0};
+  M->Name = Name;
+  M->Ps = hashmapGet(&PseudoMap, Name);
+
+  if (!strcmp(Name, "c.nop"))
+    M->Special = SPECIAL_CNOP;
+  else if (!strcmp(Name, "li"))
+    M->Special = SPECIAL_LI;
+  else if (!strcmp(Name, "call"))
+    M->Special = SPECIAL_CALL;
+  else if (!strcmp(Name, "tail"))
+    M->Special = SPECIAL_TAIL;
+  else if (!strcmp(Name, "la") || !strcmp(Name, "lla"))
+    M->Special = SPECIAL_LA;
+
+  // 原子指令的.aq、.rl和.aqrl后缀
+  int Len = strlen(Name);
+  if (!strncmp(Name, "amo", 3) || !strncmp(Name, "lr.", 3) ||
+      !strncmp(Name, "sc.", 3)) {
+    char *Dot = strrchr(Name, '.');
+    if (!strcmp(Dot, ".aq") || !strcmp(Dot, ".rl") || !strcmp(Dot, ".aqrl")) {
+      if (strstr(Dot, "aq"))
+        M->Extra |= 1 << 26;
+      if (strstr(Dot, "rl"))
+        M->Extra |= 1 << 25;
+      Len = Dot - Name;
+    }
+  }
+  M->Desc = hashmapGet2(&InsnMap, Name, Len);
+  return M->Ps || M->Special || M->Desc;
+}
+
+// 伪指令展开后的指令
+typedef struct {
+  Mnemonic M;     // 展开后的助记符
+  int Argc;       // 操作数的数量
+  int Ref[4];     // 操作数为%N时为N，否则为-1
+  Operand Ops[4]; // 不引用伪指令操作数的操作数
+} Expansion;
+
+// 伪指令的展开方式，首次使用时解析
+static Expansion *Expansions[sizeof(Pseudos) / sizeof(*Pseudos)];
+
+// 解析伪指令的展开方式
+static Expansion *expansion(Pseudo *Ps) {
+  Expansion **EP = &Expansions[Ps - Pseudos];
+  if (*EP)
+    return *EP;
+
+  Expansion *E = calloc(1, sizeof(Expansion));
+  char *Name = strdup(Ps->Expansion);
+  char *P = Name + strcspn(Name, " ");
+  if (*P)
+    *P++ = '\0';
+  resolveMnemonic(Name, &E->M);
+
+  char *Args[4];
+  E->Argc = splitArgs(P, Args, 4);
+  for (int I = 0; I < E->Argc; I++) {
+    E->Ref[I] = -1;
+    if (*Args[I] == '%') {
+      E->Ref[I] = Args[I][1] - '0';
+      continue;
+    }
+    initOperand(&E->Ops[I], Args[I]);
+    persistOperand(&E->Ops[I]);
+  }
+  *EP = E;
+  return E;
+}
+
+// 汇编一条指令
+static void emitInstruction(Mnemonic *M, int Argc, Operand *Ops) {
+  // 伪指令，将%N替换为操作数后展开
+  Pseudo *PsEnd = Pseudos + sizeof(Pseudos) / sizeof(*Pseudos);
+  for (Pseudo *Ps = M->Ps; Ps && Ps < PsEnd && !strcmp(Ps->Name, M->Ps->Name);
+       Ps++) {
+    if (Argc != Ps->Argc)
+      continue;
+    Expansion *E = expansion(Ps);
+    Operand Args[4];
+    for (int I = 0; I < E->Argc; I++)
+      Args[I] = E->Ref[I] >= 0 ? Ops[E->Ref[I]] : E->Ops[I];
+    emitInstruction(&E->M, E->Argc, Args);
+    return;
+  }
+
+  switch (M->Special) {
+  case SPECIAL_CNOP:
+    if (Argc != 0)
+      break;
+    emitInt(0x0001, 2);
+    UsesRVC = true;
+    return;
+  case SPECIAL_LI:
+    if (Argc != 2 || Ops[0].XReg < 0)
+      asmError("invalid operands for li");
+    emitLi(Ops[0].XReg, numOperand(&Ops[1]));
+    return;
+  // call和tail：auipc + jalr，使用R_RISCV_CALL_PLT重定位
+  case SPECIAL_CALL:
+  case SPECIAL_TAIL: {
+    AsmSym *Sym = NULL;
+    int64_t Addend = Argc == 1 ? expr(Ops[0].Text, &Sym) : 0;
+    if (!Sym)
+      asmError("invalid operands for %s", M->Name);
+    // call使用ra，tail使用t1保存地址
+    int Reg = M->Special == SPECIAL_CALL ? 1 : 6;
+    int Rd = M->Special == SPECIAL_CALL ? 1 : 0;
+    // R_RISCV_CALL_PLT同时修改两条指令，因此jalr不能压缩
+    emitInsn(0x17 | Reg << 7, R_RISCV_CALL_PLT, Sym, Addend);
+    emitInsn(OP(0, 0, 0x67) | Rd << 7 | Reg << 15, 0, NULL, 0);
+    return;
+  }
+  // la和lla：auipc + addi，不使用GOT
+  case SPECIAL_LA: {
+    int Rd;
+    AsmSym *Sym;
+    if (Argc != 2 || (Rd = Ops[0].XReg) < 0)
+      asmError("invalid operands for %s", M->Name);
+    int64_t Addend = expr(Ops[1].Text, &Sym);
+    if (!Sym)
+      asmError("invalid operands for %s", M->Name);
+    // %pcrel_lo引用auipc所在位置的标签
+    AsmSym *Label = getSym(format(".Lpcrel_la%d", NumPcrelLabels++));
+    defineSym(Label);
+    emitInsn(0x17 | Rd << 7, R_RISCV_PCREL_HI20, Sym, Addend);
+    emitInsn(OP(0, 0, 0x13) | Rd << 7 | Rd << 15, R_RISCV_PCREL_LO12_I, Label,
+             0);
+    return;
+  }
+  default:
+    break;
+  }
+
+  // 依次尝试同名的指令，直到操作数匹配
+  if (!M->Desc)
+    unsupported(M->Name);
+  InsnDesc *End = Insns + sizeof(Insns) / sizeof(*Insns);
+  for (InsnDesc *D = M->Desc; D < End && !strcmp(D->Name, M->Desc->Name); D++)
+    if (encodeInsn(D, Argc, Ops, M->Extra))
+      return;
+  asmError("invalid operands for %s", M->Name);
+}
+
+//
+// 汇编指示
+//
+
+// 解析字符串字面量，写入当前段
+static char *stringLiteral(char *P, bool AddNul) {
+  P = skipSpace(P);
+  if (*P != '"')
+    asmError("expected string: %s", P);
+
+  for (P++; *P != '"'; P++) {
+    if (!*P)
+      asmError("unterminated string");
+    char C = *P;
+    if (C == '\\') {
+      P++;
+      switch (*P) {
+      case 'n':
+        C = '\n';
+        break;
+      case 't':
+        C = '\t';
+        break;
+      case 'r':
+        C = '\r';
+        break;
+      case 'b':
+        C = '\b';
+        break;
+      case 'f':
+        C = '\f';
+        break;
+      case 'v':
+        C = '\v';
+        break;
+      case 'a':
+        C = '\a';
+        break;
+      case 'x': {
+        int Val = 0;
+        while (isxdigit(P[1])) {
+          P++;
+          Val = Val * 16 + (isdigit(*P) ? *P - '0' : tolower(*P) - 'a' + 10);
+        }
+        C = Val;
+        break;
+      }
+      default:
+        if ('0' <= *P && *P <= '7') {
+          int Val = *P - '0';
+          for (int I = 0; I < 2 && '0' <= P[1] && P[1] <= '7'; I++)
+            Val = Val * 8 + (*++P - '0');
+          C = Val;
+        } else {
+          C = *P;
+        }
+      }
+    }
+    emitBytes(&C, 1);
+  }
+  if (AddNul)
+    emitInt(0, 1);
+  return P + 1;
+}
+
+// 对齐当前段
+static void alignSection(uint64_t Align) {
+  if (Align == 0 || (Align & (Align - 1)))
+    asmError("alignment must be a power of 2: %lu", Align);
+  CurSec->Align = MAX(CurSec->Align, Align);
+  Frag *F = newFrag(FRAG_ALIGN);
+  F->Align = Align;
+}
+
+// 解析符号名称，可能带引号
+static char *symName(char *A) {
+  A = trim(A);
+  int Len = strlen(A);
+  if (Len >= 2 && A[0] == '"' && A[Len - 1] == '"')
+    return strndup(A + 1, Len - 2);
+  for (char *P = A; *P; P++)
+    if (!isSymChar(*P))
+      asmError("invalid symbol name: %s", A);
+  if (!*A)
+    asmError("expected symbol name");
+  return A;
+}
+
+// .comm和.lcomm，IsLocal为真时在.bss中分配
+static void commSym(char *Name, int Argc, char **Args, bool IsLocal) {
+  if (Argc < 2)
+    asmError("expected symbol, size[, align]");
+  AsmSym *S = getSym(symName(Args[0]));
+  uint64_t Size = absExpr(Args[1]);
+  uint64_t Align = Argc > 2 ? absExpr(Args[2]) : 1;
+  S->Size = Size;
+  if (!S->Type)
+    S->Type = STT_OBJECT;
+
+  if (!IsLocal && !S->IsLocal) {
+    if (S->Sec)
+      asmError("symbol '%s' is already defined", S->Name);
+    S->IsCommon = true;
+    S->Common = MAX(S->Common, Align);
+    return;
+  }
+
+  // 局部的公共符号，在.bss中分配
+  AsmSec *Prev = CurSec;
+  CurSec = getSection(".bss", NULL, NULL, 0);
+  alignSection(Align);
+  defineSym(S);
+  emitZero(Size);
+  CurSec = Prev;
+}
+
+// 记录.loc的行号信息
+static void loc(char *Operands) {
+  char *End;
+  int File = strtol(Operands, &End, 10);
+  int Line = strtol(End, &End, 10);
+  if (File < 1 || File > DwarfFiles.Len || !DwarfFiles.Data[File - 1])
+    asmError("unassigned file number in .loc: %d", File);
+
+  // 同一位置的多个.loc只保留最后一个
+  Frag *F = dataFrag();
+  Loc *L = CurSec->LastLoc;
+  if (!L || L->Frag != F || L->Off != F->Len) {
+    L = calloc(1, sizeof(Loc));
+    L->Frag = F;
+    L->Off = F->Len;
+    if (CurSec->LastLoc)
+      CurSec->LastLoc->Next = L;
+    else
+      CurSec->Locs = L;
+    CurSec->LastLoc = L;
+  }
+  L->File = File;
+  L->Line = Line;
+}
+
+// .option，只处理是否压缩指令，其他选项被忽略
+static void option(char *Opt) {
+  if (!strcmp(Opt, "rvc")) {
+    OptionRVC = true;
+  } else if (!strcmp(Opt, "norvc")) {
+    OptionRVC = false;
+  } else if (!strcmp(Opt, "push")) {
+    if (RVCDepth == sizeof(RVCStack) / sizeof(*RVCStack))
+      asmError(".option push nested too deeply");
+    RVCStack[RVCDepth++] = OptionRVC;
+  } else if (!strcmp(Opt, "pop")) {
+    if (RVCDepth == 0)
+      asmError(".option pop with no .option push");
+    OptionRVC = RVCStack[--RVCDepth];
+  }
+}
+
+// 处理汇编指示
+static void directive(char *Name, char *Operands) {
+  // .loc最为常见，首先处理
+  if (!strcmp(Name, ".loc")) {
+    loc(Operands);
+    return;
+  }
+
+  if (!strcmp(Name, ".option")) {
+    option(trim(Operands));
+    return;
+  }
+
+  // 无需处理的指示
+  static char *Ignored[] = {
+      ".attribute", ".ident", ".addrsig", ".addrsig_sym",
+  };
+  for (int I = 0; I < sizeof(Ignored) / sizeof(*Ignored); I++)
+    if (!strcmp(Name, Ignored[I]))
+      return;
+  if (!strncmp(Name, ".cfi_", 5))
+    return;
+
+  // 字符串指示中可能含有逗号，单独处理
+  bool IsAscii = !strcmp(Name, ".ascii");
+  if (IsAscii || !strcmp(Name, ".string") || !strcmp(Name, ".asciz")) {
+    for (char *P = Operands;;) {
+      P = skipSpace(stringLiteral(P, !IsAscii));
+      if (!*P)
+        return;
+      if (*P != ',')
+        asmError("expected ','");
+      P++;
+    }
+  }
+
+  char *Args[8];
+  int Argc = splitArgs(Operands, Args, 8);
+
+  // 切换段
+  if (!strcmp(Name, ".text") || !strcmp(Name, ".data") ||
+      !strcmp(Name, ".bss")) {
+    CurSec = getSection(Name, NULL, NULL, 0);
+    return;
+  }
+
+  if (!strcmp(Name, ".section")) {
+    if (Argc < 1)
+      asmError("expected section name");
+    char *SecName = symName(Args[0]);
+    char *Flags = NULL;
+    if (Argc > 1) {
+      int Len = strlen(Args[1]);
+      if (Len < 2 || Args[1][0] != '"' || Args[1][Len - 1] != '"')
+        asmError("expected section flags: %s", Args[1]);
+      Flags = strndup(Args[1] + 1, Len - 2);
+    }
+    char *Type = Argc > 2 ? Args[2] : NULL;
+    uint64_t EntSize = Argc > 3 ? absExpr(Args[3]) : 0;
+    CurSec = getSection(SecName, Flags, Type, EntSize);
+    return;
+  }
+
+  // 符号的属性
+  if (!strcmp(Name, ".globl") || !strcmp(Name, ".global") ||
+      !strcmp(Name, ".local") || !strcmp(Name, ".weak") ||
+      !strcmp(Name, ".hidden") || !strcmp(Name, ".protected") ||
+      !strcmp(Name, ".internal")) {
+    for (int I = 0; I < Argc; I++) {
+      AsmSym *S = getSym(symName(Args[I]));
+      if (Name[1] == 'g')
+        S->IsGlobal = true;
+      else if (Name[1] == 'l')
+        S->IsLocal = true;
+      else if (Name[1] == 'w')
+        S->IsWeak = true;
+      else if (Name[1] == 'h')
+        S->Visibility = STV_HIDDEN;
+      else if (Name[1] == 'p')
+        S->Visibility = STV_PROTECTED;
+      else
+        S->Visibility = STV_INTERNAL;
+    }
+    return;
+  }
+
+  if (!strcmp(Name, ".type")) {
+    if (Argc != 2)
+      asmError("expected symbol, type");
+    AsmSym *S = getSym(symName(Args[0]));
+    char *Ty = Args[1];
+    if (*Ty == '@' || *Ty == '%')
+      Ty++;
+    if (!strcmp(Ty, "function"))
+      S->Type = STT_FUNC;
+    else if (!strcmp(Ty, "object"))
+      S->Type = STT_OBJECT;
+    else if (!strcmp(Ty, "tls_object"))
+      S->Type = STT_TLS;
+    else if (!strcmp(Ty, "notype"))
+      S->Type = STT_NOTYPE;
+    else
+      asmError("unsupported symbol type: %s", Args[1]);
+    return;
+  }
+
+  if (!strcmp(Name, ".size")) {
+    if (Argc != 2)
+      asmError("expected symbol, size");
+    AsmSym *S = getSym(symName(Args[0]));
+    // .-Sym，布局后计算
+    char *P = skipSpace(Args[1]);
+    if (*P == '.' && *skipSpace(P + 1) == '-') {
+      if (getSym(symName(skipSpace(P + 1) + 1)) != S)
+        asmError("unsupported expression: %s", Args[1]);
+      Frag *F = dataFrag();
+      S->EndFrag = F;
+      S->EndOff = F->Len;
+      return;
+    }
+    S->Size = absExpr(Args[1]);
+    return;
+  }
+
+  // 对齐，RISC-V上.align的参数为2的幂次
+  if (!strcmp(Name, ".align") || !strcmp(Name, ".p2align")) {
+    if (Argc < 1)
+      asmError("expected alignment");
+    alignSection(1ULL << checkUImm(absExpr(Args[0]), 6));
+    return;
+  }
+  if (!strcmp(Name, ".balign")) {
+    if (Argc < 1)
+      asmError("expected alignment");
+    alignSection(absExpr(Args[0]));
+    return;
+  }
+
+  // 数据
+  if (!strcmp(Name, ".zero") || !strcmp(Name, ".space") ||
+      !strcmp(Name, ".skip")) {
+    if (Argc < 1)
+      asmError("expected size");
+    int64_t Size = absExpr(Args[0]);
+    if (Size < 0)
+      asmError("negative size");
+    int Fill = Argc > 1 ? absExpr(Args[1]) : 0;
+    if (Fill == 0) {
+      emitZero(Size);
+      return;
+    }
+    for (int64_t I = 0; I < Size; I++)
+      emitInt(Fill, 1);
+    return;
+  }
+
+  static struct {
+    char *Name;
+    int Size;
+    int Reloc;
+  } DataDirs[] = {
+      {".byte", 1, 0},         {".half", 2, 0},          {".short", 2, 0},
+      {".2byte", 2, 0},        {".word", 4, R_RISCV_32}, {".long", 4, R_RISCV_32},
+      {".4byte", 4, R_RISCV_32}, {".dword", 8, R_RISCV_64},
+      {".quad", 8, R_RISCV_64},  {".8byte", 8, R_RISCV_64},
+  };
+  for (int I = 0; I < sizeof(DataDirs) / sizeof(*DataDirs); I++) {
+    if (strcmp(Name, DataDirs[I].Name))
+      continue;
+    for (int J = 0; J < Argc; J++) {
+      AsmSym *Sym;
+      int64_t Val = expr(Args[J], &Sym);
+      if (Sym && !DataDirs[I].Reloc)
+        asmError("cannot use symbol in %s", Name);
+      emitData(Val, DataDirs[I].Size, DataDirs[I].Reloc, Sym);
+    }
+    return;
+  }
+
+  if (!strcmp(Name, ".comm") || !strcmp(Name, ".lcomm")) {
+    commSym(Name, Argc, Args, Name[1] == 'l');
+    return;
+  }
+
+  // 调试信息
+  if (!strcmp(Name, ".file")) {
+    if (Argc != 1)
+      asmError("invalid .file directive");
+
+    // .file "name"，源文件的名称
+    if (*Args[0] == '"') {
+      SourceFile = strdup(symName(Args[0]));
+      return;
+    }
+
+    // .file N "name"，行号信息所使用的文件
+    char *P = Args[0];
+    char *End;
+    long N = strtol(P, &End, 10);
+    End = skipSpace(End);
+    if (End == P || N < 1 || *End != '"' || End[strlen(End) - 1] != '"')
+      asmError("invalid .file directive");
+    while (DwarfFiles.Len < N)
+      strArrayPush(&DwarfFiles, NULL);
+    DwarfFiles.Data[N - 1] = strndup(End + 1, strlen(End) - 2);
+    return;
+  }
+
+  unsupported(Name);
+}
+
+//
+// 模板
+//
+// codegen的每个格式字符串在首次使用时被编译为模板：按行和;切分语句，
+// 去除注释，解析不含转换说明的助记符和操作数；之后每次输出时，
+// 只需格式化含有转换说明的部分。汇编代码（冷代码块、内联汇编等）
+// 被编译为不含转换说明的模板，与格式字符串使用同一个解析器
+//
+
+// 参数的类型
+typedef enum {
+  ARG_INT,     // int
+  ARG_LONG,    // long
+  ARG_DOUBLE,  // double
+  ARG_LDOUBLE, // long double
+  ARG_STR,     // char *
+} ArgType;
+
+// 参数的值
+typedef union {
+  long L;
+  double D;
+  long double LD;
+  char *S;
+} ArgVal;
+
+// 可能含有转换说明的文本
+typedef struct {
+  char *Text; // 文本，不含转换说明时%%已还原为%
+  bool IsDyn; // 是否含有转换说明
+  int Arg;    // 第一个转换说明对应的参数
+} Pat;
+
+// 模板中指令的操作数
+typedef struct {
+  Pat Pat;    // 操作数的文本
+  Operand Op; // 不含转换说明时预先解析的操作数
+} TmplOp;
+
+// 语句的种类
+typedef enum {
+  STMT_LABEL,     // 标签
+  STMT_INSN,      // 指令
+  STMT_DIRECTIVE, // 汇编指示
+  STMT_DYN,       // 名称含有转换说明，格式化后才能确定种类
+  STMT_TEXT,      // 整条语句为参数给出的汇编代码，例如"%s"
+} StmtKind;
+
+// 模板中的语句
+typedef struct TmplStmt TmplStmt;
+struct TmplStmt {
+  TmplStmt *Next; // 下一条语句
+  StmtKind Kind;  // 种类
+  int Lines;      // 与上一条语句之间的行数，用于报错时的行号
+  Pat Name;       // 标签、助记符或者汇编指示的名称
+  Mnemonic M;     // 不含转换说明的助记符的解析结果
+  Pat Operands;   // 汇编指示的操作数
+  int Argc;       // 指令的操作数的数量
+  TmplOp *Ops;    // 指令的操作数
+};
+
+// 模板
+typedef struct {
+  char *Fmt;       // 格式字符串，其地址作为模板的键
+  TmplStmt *Stmts; // 语句
+  int TailLines;   // 最后一条语句之后的行数
+  int NumArgs;     // 需要读取的参数的数量，注释之后的参数不需要读取
+  ArgType *Types;  // 参数的类型
+} Tmpl;
+
+// 编译模板时的状态
+typedef struct {
+  Tmpl *T;        // 模板
+  char *Src;      // 原文
+  char *Copy;     // 在原处切分的副本
+  bool IsFmt;     // 是否为格式字符串
+  TmplStmt *Last; // 最后一条语句
+  int Line;       // 当前的行
+  int PrevLine;   // 上一条语句所在的行
+} TmplCompiler;
+
+// 格式字符串到模板的映射，以格式字符串的地址为键
+static HashMap Tmpls;
+// 汇编代码到模板的映射，以汇编代码的内容为键
+static HashMap TextTmpls;
+// 格式字符串的地址到模板的直接映射的缓存
+#define TMPL_CACHE_SIZE 1024
+static Tmpl *TmplCache[TMPL_CACHE_SIZE];
+
+// 解析P处的转换说明，返回其后的位置，参数的类型写入Ty
+static char *convSpec(char *P, ArgType *Ty) {
+  P++;
+  while (*P && strchr("-+ #0", *P))
+    P++;
+  while (isdigit(*P) || *P == '.')
+    P++;
+  bool IsLong = false, IsLDouble = false;
+  for (; *P && strchr("hlLjzt", *P); P++) {
+    if (*P == 'L')
+      IsLDouble = true;
+    else if (*P != 'h')
+      IsLong = true;
+  }
+
+  switch (*P) {
+  case 's':
+    *Ty = ARG_STR;
+    break;
+  case 'f':
+  case 'g':
+  case 'e':
+    *Ty = IsLDouble ? ARG_LDOUBLE : ARG_DOUBLE;
+    break;
+  case 'd':
+  case 'i':
+  case 'u':
+  case 'x':
+  case 'X':
+  case 'o':
+  case 'c':
+    *Ty = IsLong ? ARG_LONG : ARG_INT;
+    break;
+  default:
+    asmError("unsupported conversion in format string");
+  }
+  return P + 1;
+}
+
+// 原文中Off之前的转换说明的数量
+static int argIndex(char *Src, int Off) {
+  int N = 0;
+  for (char *P = Src; P < Src + Off; P++) {
+    if (*P != '%')
+      continue;
+    if (P[1] == '%') {
+      P++;
+      continue;
+    }
+    ArgType Ty;
+    P = convSpec(P, &Ty) - 1;
+    N++;
+  }
+  return N;
+}
+
+// 副本中的文本Piece，格式字符串中不含转换说明时还原%%
+static Pat makePat(TmplCompiler *C, char *Piece) {
+  Pat P = {Piece, false, 0};
+  if (!C->IsFmt)
+    return P;
+
+  bool HasPct = false;
+  for (char *Q = Piece; *Q; Q++) {
+    if (*Q != '%')
+      continue;
+    if (Q[1] != '%') {
+      P.IsDyn = true;
+      P.Arg = argIndex(C->Src, Piece - C->Copy);
+      return P;
+    }
+    HasPct = true;
+    Q++;
+  }
+
+  if (HasPct) {
+    char *Buf = calloc(1, strlen(Piece) + 1);
+    char *D = Buf;
+    for (char *Q = Piece; *Q; Q++) {
+      *D++ = *Q;
+      if (*Q == '%')
+        Q++;
+    }
+    P.Text = Buf;
+  }
+  return P;
+}
+
+// 在模板的最后添加语句
+static TmplStmt *addStmt(TmplCompiler *C, StmtKind Kind) {
+  TmplStmt *S = calloc(1, sizeof(TmplStmt));
+  S->Kind = Kind;
+  S->Lines = C->Line - C->PrevLine;
+  C->PrevLine = C->Line;
+  if (C->Last)
+    C->Last->Next = S;
+  else
+    C->T->Stmts = S;
+  C->Last = S;
+  return S;
+}
+
+// 跳过符号名称，名称中可以含有转换说明
+static char *skipName(TmplCompiler *C, char *P) {
+  for (;;) {
+    if (isSymChar(*P)) {
+      P++;
+      continue;
+    }
+    if (C->IsFmt && *P == '%' && P[1] != '%') {
+      ArgType Ty;
+      P = convSpec(P, &Ty);
+      continue;
+    }
+    return P;
+  }
+}
+
+// 编译一条语句，可能以标签开头，P为在副本中切分出的语句
+static void compileStmt(TmplCompiler *C, char *P) {
+  P = trim(P);
+
+  // 标签
+  for (;;) {
+    char *Q = skipName(C, P);
+    if (Q == P || *Q != ':')
+      break;
+    *Q = '\0';
+    addStmt(C, STMT_LABEL)->Name = makePat(C, P);
+    P = skipSpace(Q + 1);
+  }
+  if (!*P)
+    return;
+
+  // 整条语句为一个%s
+  if (C->IsFmt && *P == '%' && P[1] != '%') {
+    ArgType Ty;
+    if (!*convSpec(P, &Ty) && Ty == ARG_STR) {
+      addStmt(C, STMT_TEXT)->Name = makePat(C, P);
+      return;
+    }
+  }
+
+  // 助记符或者汇编指示的名称
+  char *Name = P;
+  while (*P && *P != ' ' && *P != '\t')
+    P++;
+  if (*P)
+    *P++ = '\0';
+
+  TmplStmt *S = addStmt(C, STMT_INSN);
+  S->Name = makePat(C, Name);
+  if (!S->Name.IsDyn && *S->Name.Text == '.') {
+    S->Kind = STMT_DIRECTIVE;
+    S->Operands = makePat(C, P);
+    return;
+  }
+
+  if (S->Name.IsDyn) {
+    // 格式化后可能为汇编指示，保留操作数的原文
+    S->Kind = STMT_DYN;
+    S->Operands = makePat(C, P);
+    S->Operands.Text = strdup(S->Operands.Text);
+  } else if (!resolveMnemonic(S->Name.Text, &S->M)) {
+    unsupported(S->Name.Text);
+  }
+
+  char *Args[8];
+  S->Argc = splitArgs(P, Args, 8);
+  S->Ops = calloc(S->Argc, sizeof(TmplOp));
+  for (int I = 0; I < S->Argc; I++) {
+    TmplOp *Op = &S->Ops[I];
+    Op->Pat = makePat(C, Args[I]);
+    if (!Op->Pat.IsDyn) {
+      initOperand(&Op->Op, Op->Pat.Text);
+      persistOperand(&Op->Op);
+    }
+  }
+}
+
+// 编译模板，IsFmt为真时Src为格式字符串，否则为汇编代码
+static Tmpl *compileTmpl(char *Src, bool IsFmt) {
+  Tmpl *T = calloc(1, sizeof(Tmpl));
+  T->Fmt = Src;
+  TmplCompiler C = {T, Src, strdup(Src), IsFmt, NULL, 0, -1};
+
+  // 编译时出错，报告所在的行
+  int SavedLineNo = LineNo;
+
+  // 逐行编译，#之后为注释，;分隔同一行内的多条语句
+  // 用strcspn跳过普通字符，注释直接跳到行尾
+  char *Stop = IsFmt ? "\n\";#%" : "\n\";#";
+  for (char *P = C.Copy;;) {
+    LineNo = SavedLineNo + C.Line + 1;
+    char *Start = P;
+    for (;;) {
+      P += strcspn(P, Stop);
+      // 字符串内的;和#不是分隔符和注释
+      if (*P == '"') {
+        for (P++; *P && *P != '"' && *P != '\n'; P++)
+          if (*P == '\\' && P[1] && P[1] != '\n')
+            P++;
+        if (*P == '"')
+          P++;
+        continue;
+      }
+      // 转换说明，其中可能含有#
+      if (*P == '%') {
+        ArgType Ty;
+        P = P[1] == '%' ? P + 2 : convSpec(P, &Ty);
+        continue;
+      }
+      break;
+    }
+
+    char Sep = *P;
+    *P = '\0';
+    compileStmt(&C, Start);
+    if (Sep == '#') {
+      P++;
+      P += strcspn(P, "\n");
+      Sep = *P;
+    }
+    if (!Sep)
+      break;
+    if (Sep == '\n')
+      C.Line++;
+    P++;
+  }
+  T->TailLines = C.Line - C.PrevLine;
+  LineNo = SavedLineNo;
+
+  // 需要读取的参数：最后一个用到的转换说明及其之前的参数
+  for (TmplStmt *S = T->Stmts; S; S = S->Next) {
+    Pat *Pats[] = {&S->Name, &S->Operands};
+    for (int I = 0; I < 2 + S->Argc; I++) {
+      Pat *P = I < 2 ? Pats[I] : &S->Ops[I - 2].Pat;
+      if (P->IsDyn)
+        T->NumArgs =
+            MAX(T->NumArgs, P->Arg + argIndex(P->Text, strlen(P->Text)));
+    }
+  }
+  if (T->NumArgs) {
+    T->Types = calloc(T->NumArgs, sizeof(ArgType));
+    int N = 0;
+    for (char *P = Src; *P && N < T->NumArgs; P++) {
+      if (*P != '%')
+        continue;
+      if (P[1] == '%') {
+        P++;
+        continue;
+      }
+      P = convSpec(P, &T->Types[N++]) - 1;
+    }
+  }
+  return T;
+}
+
+// 格式化的结果
+static char *RenderBuf;
+static int RenderCap;
+
+// 向RenderBuf的Len处写入S
+static void renderPut(int *Len, char *S, int N) {
+  if (*Len + N + 1 > RenderCap) {
+    RenderCap = MAX(RenderCap * 2, *Len + N + 256);
+    RenderBuf = realloc(RenderBuf, RenderCap);
+  }
+  memcpy(RenderBuf + *Len, S, N);
+  *Len += N;
+}
+
+// 按照参数格式化文本，结果位于临时缓冲区中
+static char *render(Pat *P, ArgVal *Vals) {
+  if (!P->IsDyn)
+    return P->Text;
+
+  int Len = 0;
+  int Arg = P->Arg;
+  for (char *S = P->Text; *S;) {
+    char *Q = S + strcspn(S, "%");
+    renderPut(&Len, S, Q - S);
+    if (!*Q)
+      break;
+    if (Q[1] == '%') {
+      renderPut(&Len, "%", 1);
+      S = Q + 2;
+      continue;
+    }
+
+    ArgType Ty;
+    S = convSpec(Q, &Ty);
+    ArgVal V = Vals[Arg++];
+    // 最常见的%s和%d
+    if (S - Q == 2 && Ty == ARG_STR) {
+      renderPut(&Len, V.S, strlen(V.S));
+      continue;
+    }
+    char Buf[64];
+    if (S - Q == 2 && Q[1] == 'd') {
+      renderPut(&Len, Buf, snprintf(Buf, sizeof(Buf), "%d", (int)V.L));
+      continue;
+    }
+
+    // 其他转换说明
+    char Spec[16];
+    int SpecLen = MIN(S - Q, sizeof(Spec) - 1);
+    memcpy(Spec, Q, SpecLen);
+    Spec[SpecLen] = '\0';
+    int N;
+    switch (Ty) {
+    case ARG_INT:
+      N = snprintf(Buf, sizeof(Buf), Spec, (int)V.L);
+      break;
+    case ARG_LONG:
+      N = snprintf(Buf, sizeof(Buf), Spec, V.L);
+      break;
+    case ARG_DOUBLE:
+      N = snprintf(Buf, sizeof(Buf), Spec, V.D);
+      break;
+    case ARG_LDOUBLE:
+      N = snprintf(Buf, sizeof(Buf), Spec, V.LD);
+      break;
+    case ARG_STR:
+      N = snprintf(Buf, sizeof(Buf), Spec, V.S);
+      break;
+    }
+    renderPut(&Len, Buf, MIN(N, sizeof(Buf) - 1));
+  }
+  return scratchDup(RenderBuf, Len);
+}
+
+static int runTmpl(Tmpl *T, ArgVal *Vals);
+
+// 执行模板中的指令
+static void tmplInsn(TmplStmt *S, Mnemonic *M, ArgVal *Vals) {
+  Operand Ops[8];
+  for (int I = 0; I < S->Argc; I++) {
+    if (S->Ops[I].Pat.IsDyn)
+      initOperand(&Ops[I], render(&S->Ops[I].Pat, Vals));
+    else
+      Ops[I] = S->Ops[I].Op;
+  }
+  emitInstruction(M, S->Argc, Ops);
+}
+
+// 执行汇编指示，汇编指示在原处切分操作数，因此使用副本
+static void tmplDirective(char *Name, Pat *Operands, ArgVal *Vals) {
+  char *Ops = render(Operands, Vals);
+  directive(Name, Operands->IsDyn ? Ops : scratchDup(Ops, strlen(Ops)));
+}
+
+// 汇编代码Text对应的模板
+static Tmpl *textTmpl(char *Text) {
+  Tmpl *T = hashmapGet(&TextTmpls, Text);
+  if (!T) {
+    T = compileTmpl(Text, false);
+    hashmapPut(&TextTmpls, T->Fmt, T);
+  }
+  return T;
+}
+
+// 按照参数执行模板，返回汇编的指令数
+static int runTmpl(Tmpl *T, ArgVal *Vals) {
+  int N = 0;
+  for (TmplStmt *S = T->Stmts; S; S = S->Next) {
+    LineNo += S->Lines;
+    ScratchLen = 0;
+
+    switch (S->Kind) {
+    case STMT_LABEL:
+      defineLabel(render(&S->Name, Vals));
+      break;
+    case STMT_INSN:
+      tmplInsn(S, &S->M, Vals);
+      N++;
+      break;
+    case STMT_DIRECTIVE:
+      tmplDirective(S->Name.Text, &S->Operands, Vals);
+      break;
+    case STMT_DYN: {
+      char *Name = render(&S->Name, Vals);
+      if (*Name == '.') {
+        tmplDirective(Name, &S->Operands, Vals);
+        break;
+      }
+      Mnemonic M;
+      if (!resolveMnemonic(Name, &M))
+        unsupported(Name);
+      tmplInsn(S, &M, Vals);
+      N++;
+      break;
+    }
+    case STMT_TEXT:
+      // 汇编代码的第一行与当前语句位于同一行
+      LineNo--;
+      N += runTmpl(textTmpl(Vals[S->Name.Arg].S), NULL);
+      break;
+    }
+  }
+  LineNo += T->TailLines;
+  return N;
+}
+
+//
+// 布局
+//
+
+// 跳转的目标是否在汇编时解析：同一段内的非全局符号
+static bool isResolved(AsmSec *Sec, Frag *F) {
+  AsmSym *T = F->Target;
+  return T->Sec == Sec && !T->IsGlobal && !T->IsWeak;
+}
+
+// 计算片段的地址，超出范围的条件跳转会被扩展，重复直到不再变化
+static void layoutSection(AsmSec *Sec) {
+  for (;;) {
+    uint64_t Addr = 0;
+    for (Frag *F = Sec->Frags; F; F = F->Next) {
+      F->Addr = Addr;
+      switch (F->Kind) {
+      case FRAG_DATA:
+        Addr += F->Len;
+        break;
+      case FRAG_ALIGN:
+        F->Pad = ((Addr + F->Align - 1) & ~(F->Align - 1)) - Addr;
+        Addr += F->Pad;
+        break;
+      case FRAG_BRANCH:
+        Addr += F->IsLong ? 8 : 4;
+        break;
+      case FRAG_JUMP:
+        Addr += 4;
+        break;
+      }
+    }
+    Sec->Size = Addr;
+
+    // 条件跳转的范围为±4KiB
+    bool Changed = false;
+    for (Frag *F = Sec->Frags; F; F = F->Next) {
+      if (F->Kind != FRAG_BRANCH || F->IsLong || !isResolved(Sec, F))
+        continue;
+      int64_t Off = symValue(F->Target) + F->Addend - F->Addr;
+      if (Off < -4096 || Off > 4094) {
+        F->IsLong = true;
+        Changed = true;
+      }
+    }
+    if (!Changed)
+      return;
+  }
+}
+
+// 生成段的内容和重定位
+static void encodeSection(AsmSec *Sec) {
+  if (Sec->Type != SHT_NOBITS)
+    Sec->Data = calloc(1, Sec->Size);
+  Fixup Head = {0};
+  Fixup *Cur = &Head;
+
+  for (Frag *F = Sec->Frags; F; F = F->Next) {
+    char *Buf = Sec->Data + F->Addr;
+    switch (F->Kind) {
+    case FRAG_DATA:
+      if (Sec->Data)
+        memcpy(Buf, F->Data, F->Len);
+      for (Fixup *Fx = F->Fixups; Fx; Fx = Fx->Next) {
+        Cur = Cur->Next = calloc(1, sizeof(Fixup));
+        *Cur = *Fx;
+        Cur->Next = NULL;
+        Cur->Off += F->Addr;
+      }
+      break;
+    case FRAG_ALIGN:
+      // 代码段使用nop填充，压缩指令使填充为2字节时先写入c.nop
+      if (Sec->Data && (Sec->Flags & SHF_EXECINSTR)) {
+        if (F->Pad % 4 == 2)
+          writeInt(Buf, 0x0001, 2);
+        for (uint64_t I = F->Pad % 4; I < F->Pad; I += 4)
+          writeInt(Buf + I, 0x13, 4);
+      }
+      break;
+    case FRAG_BRANCH:
+    case FRAG_JUMP: {
+      // 目标不在同一段内时，生成重定位
+      if (!isResolved(Sec, F)) {
+        writeInt(Buf, F->Insn, 4);
+        Cur = Cur->Next = calloc(1, sizeof(Fixup));
+        Cur->Off = F->Addr;
+        Cur->Type = F->Kind == FRAG_BRANCH ? R_RISCV_BRANCH : R_RISCV_JAL;
+        Cur->Sym = F->Target;
+        Cur->Addend = F->Addend;
+        F->Target->IsUsed = true;
+        break;
+      }
+
+      int64_t Off = symValue(F->Target) + F->Addend - F->Addr;
+      if (F->Kind == FRAG_BRANCH && !F->IsLong) {
+        writeInt(Buf, F->Insn | encB(Off), 4);
+        break;
+      }
+
+      // 扩展的条件跳转：反转条件跳过下一条指令，再用jal跳转到目标
+      uint32_t Insn = F->Insn;
+      if (F->Kind == FRAG_BRANCH) {
+        writeInt(Buf, (F->Insn ^ (1 << 12)) | encB(8), 4);
+        Buf += 4;
+        Off -= 4;
+        Insn = 0x6f;
+      }
+      if (Off < -(1 << 20) || Off >= (1 << 20))
+        asmError("jump target %s out of range", F->Target->Name);
+      writeInt(Buf, Insn | encJ(Off), 4);
+      break;
+    }
+    }
+  }
+  Sec->Relocs = Head.Next;
+}
+
+//
+// 调试信息
+//
+
+// 使用到的DWARF常量
+#define DW_TAG_compile_unit 0x11
+#define DW_AT_name 0x03
+#define DW_AT_stmt_list 0x10
+#define DW_AT_low_pc 0x11
+#define DW_AT_high_pc 0x12
+#define DW_AT_producer 0x25
+#define DW_FORM_addr 0x01
+#define DW_FORM_data4 0x06
+#define DW_FORM_string 0x08
+
+// 向当前段写入ULEB128
+static void emitULEB(uint64_t Val) {
+  do {
+    uint8_t Byte = Val & 0x7f;
+    Val >>= 7;
+    if (Val)
+      Byte |= 0x80;
+    emitInt(Byte, 1);
+  } while (Val);
+}
+
+// 向当前段写入SLEB128
+static void emitSLEB(int64_t Val) {
+  for (;;) {
+    uint8_t Byte = Val & 0x7f;
+    Val >>= 7;
+    if ((Val == 0 && !(Byte & 0x40)) || (Val == -1 && (Byte & 0x40))) {
+      emitInt(Byte, 1);
+      return;
+    }
+    emitInt(Byte | 0x80, 1);
+  }
+}
+
+// 向当前段写入字符串
+static void emitStr(char *S) { emitBytes(S, strlen(S) + 1); }
+
+// 当前段的数据片段的长度
+static uint64_t curOff(void) { return dataFrag()->Len; }
+
+// 回填4字节的长度
+static void patch32(uint64_t Off, uint64_t Val) {
+  writeInt(dataFrag()->Data + Off, Val, 4);
+}
+
+// 根据.loc生成DWARF第3版的.debug_line，以及引用它的.debug_info
+static void emitDebugInfo(void) {
+  AsmSec *Code = NULL;
+  int NumCode = 0;
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    if (Sec->Locs) {
+      Code = Sec;
+      NumCode++;
+    }
+  }
+  if (!NumCode)
+    return;
+
+  // .debug_line
+  AsmSec *LineSec = CurSec = getSection(".debug_line", NULL, NULL, 0);
+  emitInt(0, 4);   // unit_length，回填
+  emitInt(3, 2);   // version
+  emitInt(0, 4);   // header_length，回填
+  uint64_t HdrStart = curOff();
+  emitInt(1, 1);   // minimum_instruction_length
+  emitInt(1, 1);   // default_is_stmt
+  emitInt(-5, 1);  // line_base
+  emitInt(14, 1);  // line_range
+  emitInt(13, 1);  // opcode_base
+  char OpLens[] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+  emitBytes(OpLens, sizeof(OpLens));
+  emitInt(0, 1);   // include_directories
+  for (int I = 0; I < DwarfFiles.Len; I++) {
+    emitStr(DwarfFiles.Data[I] ? DwarfFiles.Data[I] : "<unknown>");
+    emitULEB(0);   // 目录
+    emitULEB(0);   // 修改时间
+    emitULEB(0);   // 长度
+  }
+  emitInt(0, 1);
+  patch32(6, curOff() - HdrStart);
+
+  // 每个段为一个序列
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    if (!Sec->Locs)
+      continue;
+
+    // DW_LNE_set_address
+    uint64_t Addr = Sec->Locs->Frag->Addr + Sec->Locs->Off;
+    emitInt(0, 1);
+    emitULEB(9);
+    emitInt(2, 1);
+    emitData(Addr, 8, R_RISCV_64, Sec->Sym);
+
+    int File = 1;
+    int Line = 1;
+    for (Loc *L = Sec->Locs; L; L = L->Next) {
+      // 同一地址的多个.loc只保留最后一个
+      uint64_t LocAddr = L->Frag->Addr + L->Off;
+      if (L->Next && L->Next->Frag->Addr + L->Next->Off == LocAddr)
+        continue;
+      if (L->File != File) {
+        emitInt(4, 1); // DW_LNS_set_file
+        emitULEB(L->File);
+        File = L->File;
+      }
+      if (L->Line != Line) {
+        emitInt(3, 1); // DW_LNS_advance_line
+        emitSLEB(L->Line - Line);
+        Line = L->Line;
+      }
+      if (LocAddr != Addr) {
+        emitInt(2, 1); // DW_LNS_advance_pc
+        emitULEB(LocAddr - Addr);
+        Addr = LocAddr;
+      }
+      emitInt(1, 1); // DW_LNS_copy
+    }
+
+    // DW_LNE_end_sequence
+    if (Sec->Size != Addr) {
+      emitInt(2, 1);
+      emitULEB(Sec->Size - Addr);
+    }
+    emitInt(0, 1);
+    emitULEB(1);
+    emitInt(1, 1);
+  }
+  patch32(0, curOff() - 4);
+
+  // .debug_abbrev
+  AsmSec *AbbrevSec = CurSec = getSection(".debug_abbrev", NULL, NULL, 0);
+  emitULEB(1);
+  emitULEB(DW_TAG_compile_unit);
+  emitInt(0, 1); // DW_CHILDREN_no
+  emitULEB(DW_AT_stmt_list);
+  emitULEB(DW_FORM_data4);
+  emitULEB(DW_AT_name);
+  emitULEB(DW_FORM_string);
+  emitULEB(DW_AT_producer);
+  emitULEB(DW_FORM_string);
+  // 只有一个代码段时，给出其地址范围
+  if (NumCode == 1) {
+    emitULEB(DW_AT_low_pc);
+    emitULEB(DW_FORM_addr);
+    emitULEB(DW_AT_high_pc);
+    emitULEB(DW_FORM_addr);
+  }
+  emitULEB(0);
+  emitULEB(0);
+  emitULEB(0);
+
+  // .debug_info
+  CurSec = getSection(".debug_info", NULL, NULL, 0);
+  emitInt(0, 4); // unit_length，回填
+  emitInt(3, 2); // version
+  emitData(0, 4, R_RISCV_32, AbbrevSec->Sym);
+  emitInt(8, 1); // address_size
+  emitULEB(1);
+  emitData(0, 4, R_RISCV_32, LineSec->Sym);
+  emitStr(DwarfFiles.Data[0] ? DwarfFiles.Data[0] : "<unknown>");
+  emitStr("rvcc");
+  if (NumCode == 1) {
+    emitData(0, 8, R_RISCV_64, Code->Sym);
+    emitData(Code->Size, 8, R_RISCV_64, Code->Sym);
+  }
+  patch32(0, curOff() - 4);
+}
+
+//
+// 输出ELF文件
+//
+
+// 字符串表
+typedef struct {
+  char *Buf;
+  size_t Len;
+  FILE *Out;
+} StrTab;
+
+// 向字符串表中加入字符串，返回其偏移量
+static uint32_t addStr(StrTab *T, char *S) {
+  if (!*S)
+    return 0;
+  uint32_t Off = ftell(T->Out);
+  fwrite(S, strlen(S) + 1, 1, T->Out);
+  return Off;
+}
+
+// 打开字符串表，首个字符为空
+static void openStrTab(StrTab *T) {
+  T->Out = open_memstream(&T->Buf, &T->Len);
+  fputc('\0', T->Out);
+}
+
+// 写入时对齐文件的偏移量
+static uint64_t alignFile(FILE *Out, uint64_t Align) {
+  uint64_t Off = ftell(Out);
+  while (Align > 1 && Off % Align) {
+    fputc('\0', Out);
+    Off++;
+  }
+  return Off;
+}
+
+// 是否写入符号表
+static bool isEmitted(AsmSym *S) {
+  if (S->IsGlobal || S->IsWeak || S->IsCommon || S->IsUsed)
+    return true;
+  // 未被引用的.L开头的局部标签不写入
+  return S->Sec && strncmp(S->Name, ".L", 2);
+}
+
+// 是否为局部符号
+static bool isLocalSym(AsmSym *S) {
+  return S->Sec && !S->IsGlobal && !S->IsWeak;
+}
+
+// 符号表的项
+static void writeSym(FILE *Out, uint32_t Name, int Bind, int Type, int Other,
+                     int Shndx, uint64_t Value, uint64_t Size) {
+  Elf64_Sym Sym = {0};
+  Sym.st_name = Name;
+  Sym.st_info = ELF64_ST_INFO(Bind, Type);
+  Sym.st_other = Other;
+  Sym.st_shndx = Shndx;
+  Sym.st_value = Value;
+  Sym.st_size = Size;
+  fwrite(&Sym, sizeof(Sym), 1, Out);
+}
+
+// 符号的类型
+static int symType(AsmSym *S) {
+  if (S->IsTLS || (S->Sec && (S->Sec->Flags & SHF_TLS)))
+    return STT_TLS;
+  return S->Type;
+}
+
+// 生成ELF可重定位文件，写入到缓冲区中
+static void writeELF(char **Buf, size_t *BufLen) {
+  // 段的索引：用户的段、重定位段、.symtab、.strtab、.shstrtab
+  int NumSecs = 1;
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next)
+    Sec->Index = NumSecs++;
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    for (Fixup *Fx = Sec->Relocs; Fx; Fx = Fx->Next)
+      Sec->NumRelocs++;
+    if (Sec->NumRelocs)
+      Sec->RelaIndex = NumSecs++;
+  }
+  int SymtabIdx = NumSecs++;
+  int StrtabIdx = NumSecs++;
+  int ShstrtabIdx = NumSecs++;
+
+  // 符号表：空符号、文件符号、段符号、局部符号、全局符号
+  StrTab Strtab;
+  openStrTab(&Strtab);
+  char *SymBuf;
+  size_t SymLen;
+  FILE *SymOut = open_memstream(&SymBuf, &SymLen);
+  int NumSyms = 0;
+  writeSym(SymOut, 0, 0, 0, 0, 0, 0, 0);
+  NumSyms++;
+  if (SourceFile) {
+    writeSym(SymOut, addStr(&Strtab, SourceFile), STB_LOCAL, STT_FILE, 0,
+             SHN_ABS, 0, 0);
+    NumSyms++;
+  }
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    Sec->Sym->Index = NumSyms++;
+    writeSym(SymOut, 0, STB_LOCAL, STT_SECTION, 0, Sec->Index, 0, 0);
+  }
+
+  int FirstGlobal = 0;
+  for (int Pass = 0; Pass < 2; Pass++) {
+    if (Pass == 1)
+      FirstGlobal = NumSyms;
+    for (AsmSym *S = Syms; S; S = S->Next) {
+      if (!isEmitted(S) || isLocalSym(S) != (Pass == 0))
+        continue;
+      S->Index = NumSyms++;
+
+      int Bind = S->IsWeak ? STB_WEAK : Pass == 0 ? STB_LOCAL : STB_GLOBAL;
+      uint64_t Size = S->Size;
+      if (S->EndFrag)
+        Size = S->EndFrag->Addr + S->EndOff - symValue(S);
+
+      if (S->IsCommon)
+        writeSym(SymOut, addStr(&Strtab, S->Name), Bind, symType(S),
+                 S->Visibility, SHN_COMMON, S->Common, Size);
+      else if (S->Sec)
+        writeSym(SymOut, addStr(&Strtab, S->Name), Bind, symType(S),
+                 S->Visibility, S->Sec->Index, symValue(S), Size);
+      else
+        writeSym(SymOut, addStr(&Strtab, S->Name), Bind, symType(S),
+                 S->Visibility, SHN_UNDEF, 0, 0);
+    }
+  }
+  fclose(SymOut);
+  fclose(Strtab.Out);
+
+  // 写入文件的内容：ELF头、段的内容、段头
+  FILE *Out = open_memstream(Buf, BufLen);
+  Elf64_Ehdr Ehdr = {0};
+  fwrite(&Ehdr, sizeof(Ehdr), 1, Out);
+
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    Sec->FileOff = alignFile(Out, Sec->Align);
+    if (Sec->Data)
+      fwrite(Sec->Data, Sec->Size, 1, Out);
+  }
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    if (!Sec->NumRelocs)
+      continue;
+    Sec->RelaFileOff = alignFile(Out, 8);
+    for (Fixup *Fx = Sec->Relocs; Fx; Fx = Fx->Next) {
+      Elf64_Rela Rela;
+      Rela.r_offset = Fx->Off;
+      Rela.r_info = ELF64_R_INFO(Fx->Sym->Index, Fx->Type);
+      Rela.r_addend = Fx->Addend;
+      fwrite(&Rela, sizeof(Rela), 1, Out);
+    }
+  }
+  uint64_t SymtabOff = alignFile(Out, 8);
+  fwrite(SymBuf, SymLen, 1, Out);
+  uint64_t StrtabOff = ftell(Out);
+  fwrite(Strtab.Buf, Strtab.Len, 1, Out);
+
+  // 段名称的字符串表
+  StrTab Shstrtab;
+  openStrTab(&Shstrtab);
+  Elf64_Shdr *Shdrs = calloc(NumSecs, sizeof(Elf64_Shdr));
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    Elf64_Shdr *Sh = &Shdrs[Sec->Index];
+    Sh->sh_name = addStr(&Shstrtab, Sec->Name);
+    Sh->sh_type = Sec->Type;
+    Sh->sh_flags = Sec->Flags;
+    Sh->sh_offset = Sec->FileOff;
+    Sh->sh_size = Sec->Size;
+    Sh->sh_addralign = Sec->Align;
+    Sh->sh_entsize = Sec->EntSize;
+
+    if (!Sec->NumRelocs)
+      continue;
+    Sh = &Shdrs[Sec->RelaIndex];
+    Sh->sh_name = addStr(&Shstrtab, format(".rela%s", Sec->Name));
+    Sh->sh_type = SHT_RELA;
+    Sh->sh_flags = SHF_INFO_LINK;
+    Sh->sh_offset = Sec->RelaFileOff;
+    Sh->sh_size = Sec->NumRelocs * sizeof(Elf64_Rela);
+    Sh->sh_link = SymtabIdx;
+    Sh->sh_info = Sec->Index;
+    Sh->sh_addralign = 8;
+    Sh->sh_entsize = sizeof(Elf64_Rela);
+  }
+
+  Elf64_Shdr *Sh = &Shdrs[SymtabIdx];
+  Sh->sh_name = addStr(&Shstrtab, ".symtab");
+  Sh->sh_type = SHT_SYMTAB;
+  Sh->sh_offset = SymtabOff;
+  Sh->sh_size = SymLen;
+  Sh->sh_link = StrtabIdx;
+  Sh->sh_info = FirstGlobal;
+  Sh->sh_addralign = 8;
+  Sh->sh_entsize = sizeof(Elf64_Sym);
+
+  Sh = &Shdrs[StrtabIdx];
+  Sh->sh_name = addStr(&Shstrtab, ".strtab");
+  Sh->sh_type = SHT_STRTAB;
+  Sh->sh_offset = StrtabOff;
+  Sh->sh_size = Strtab.Len;
+  Sh->sh_addralign = 1;
+
+  Sh = &Shdrs[ShstrtabIdx];
+  Sh->sh_name = addStr(&Shstrtab, ".shstrtab");
+  fclose(Shstrtab.Out);
+  Sh->sh_type = SHT_STRTAB;
+  Sh->sh_offset = ftell(Out);
+  Sh->sh_size = Shstrtab.Len;
+  Sh->sh_addralign = 1;
+  fwrite(Shstrtab.Buf, Shstrtab.Len, 1, Out);
+
+  uint64_t ShOff = alignFile(Out, 8);
+  fwrite(Shdrs, sizeof(Elf64_Shdr), NumSecs, Out);
+  fclose(Out);
+
+  // ELF头
+  Elf64_Ehdr *Eh = (Elf64_Ehdr *)*Buf;
+  memcpy(Eh->e_ident, ELFMAG, SELFMAG);
+  Eh->e_ident[EI_CLASS] = ELFCLASS64;
+  Eh->e_ident[EI_DATA] = ELFDATA2LSB;
+  Eh->e_ident[EI_VERSION] = EV_CURRENT;
+  Eh->e_ident[EI_OSABI] = ELFOSABI_NONE;
+  Eh->e_type = ET_REL;
+  Eh->e_machine = EM_RISCV;
+  Eh->e_version = EV_CURRENT;
+  Eh->e_shoff = ShOff;
+  Eh->e_flags = EF_RISCV_FLOAT_ABI_DOUBLE | (UsesRVC ? EF_RISCV_RVC : 0);
+  Eh->e_ehsize = sizeof(Elf64_Ehdr);
+  Eh->e_shentsize = sizeof(Elf64_Shdr);
+  Eh->e_shnum = NumSecs;
+  Eh->e_shstrndx = ShstrtabIdx;
+}
+
+// 开始汇编，之后通过asmEmit和asmText输入汇编代码
+void asmBegin(void) {
+  initTables();
+  CurSec = getSection(".text", NULL, NULL, 0);
+}
+
+// 按照格式字符串Fmt和参数VA汇编，与printf的格式相同
+// 返回汇编的指令数
+int asmEmit(char *Fmt, va_list VA) {
+  // 先查找直接映射的缓存，再查找哈希表
+  Tmpl **Slot = &TmplCache[((uintptr_t)Fmt >> 3) % TMPL_CACHE_SIZE];
+  Tmpl *T = *Slot;
+  if (!T || T->Fmt != Fmt) {
+    T = hashmapGet2(&Tmpls, (char *)&Fmt, sizeof(Fmt));
+    if (!T) {
+      T = compileTmpl(Fmt, true);
+      hashmapPut2(&Tmpls, (char *)&T->Fmt, sizeof(T->Fmt), T);
+    }
+    *Slot = T;
+  }
+
+  ArgVal Vals[16];
+  if (T->NumArgs > 16)
+    asmError("too many arguments in format string");
+  for (int I = 0; I < T->NumArgs; I++) {
+    switch (T->Types[I]) {
+    case ARG_INT:
+      Vals[I].L = va_arg(VA, int);
+      break;
+    case ARG_LONG:
+      Vals[I].L = va_arg(VA, long);
+      break;
+    case ARG_DOUBLE:
+      Vals[I].D = va_arg(VA, double);
+      break;
+    case ARG_LDOUBLE:
+      Vals[I].LD = va_arg(VA, long double);
+      break;
+    case ARG_STR:
+      Vals[I].S = va_arg(VA, char *);
+      break;
+    }
+  }
+  return runTmpl(T, Vals);
+}
+
+// 汇编一段汇编代码，例如codegen的冷代码块
+void asmText(char *Text) { runTmpl(compileTmpl(Text, false), NULL); }
+
+// 结束汇编，将可重定位文件写入到缓冲区Buf中
+void asmEnd(char **Buf, size_t *Len) {
+  // 布局后生成调试信息，调试信息的段不含跳转
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next)
+    layoutSection(Sec);
+  emitDebugInfo();
+  for (AsmSec *Sec = Sections; Sec; Sec = Sec->Next) {
+    layoutSection(Sec);
+    encodeSection(Sec);
+  }
+
+  writeELF(Buf, Len);
+}
+
+// 将汇编代码Text汇编为可重定位文件，写入到缓冲区Buf中
+// 遇到不支持的指令或汇编指示时返回false
+bool assembleObj(char *Text, char **Buf, size_t *Len) {
+  if (setjmp(Unsupported))
+    return false;
+  CanFallback = true;
+
+  // 先编译整个文件，不支持的指令在写入任何内容之前就会被发现
+  asmBegin();
+  Tmpl *T = compileTmpl(Text, false);
+  runTmpl(T, NULL);
+  asmEnd(Buf, Len);
+  return true;
+}
@@ -0,0 +1,232 @@
+#include "rvcc.h"
+#include <fcntl.h>
+
+// 编译缓存，-fcache-dir=DIR
+// 缓存的键由编译器自身、影响编译结果的选项、输入文件以及预处理后的终结符流
+// 计算得到，命中时cc1直接输出缓存的汇编代码或可重定位文件，
+// 不再进行语法分析和代码生成。
+//
+// 缓存项位于DIR/键的前两位/键的剩余部分，先写入同目录下的临时文件再重命名，
+// 读取者只会看到完整的缓存项，因此多个进程可以同时使用同一个缓存目录。
+// 统计信息位于DIR/stats，在文件锁的保护下更新
+
+// 缓存项的格式版本，缓存项的格式改变时需要增加
+#define CACHE_VERSION 1
+
+// 128位FNV-1a哈希值，W[0]为最低的32位
+typedef struct {
+  uint32_t W[4];
+} Hash128;
+
+// 初始化为FNV偏移值（FNV_offset_basis）
+static void hashInit(Hash128 *H) {
+  H->W[3] = 0x6c62272e;
+  H->W[2] = 0x07bb0142;
+  H->W[1] = 0x62b82175;
+  H->W[0] = 0x6295c58d;
+}
+
+// 将Len个字节加入哈希值
+static void hashBytes(Hash128 *H, void *P, size_t Len) {
+  unsigned char *S = P;
+  for (size_t I = 0; I < Len; I++) {
+    H->W[0] ^= S[I];
+
+    // 乘以128位的FNV质数：2^88 + 0x13b
+    uint32_t R[4];
+    uint64_t C = 0;
+    for (int J = 0; J < 4; J++) {
+      C += (uint64_t)H->W[J] * 0x13b;
+      R[J] = C;
+      C >>= 32;
+    }
+    uint64_t T = (uint64_t)R[2] + (uint32_t)(H->W[0] << 24);
+    R[2] = T;
+    R[3] += (uint32_t)(T >> 32) + (H->W[0] >> 8) + (H->W[1] << 24);
+    memcpy(H->W, R, sizeof(R));
+  }
+}
+
+// 将字符串加入哈希值，包括结尾的'\0'，以区分相邻的字符串
+static void hashStr(Hash128 *H, char *S) { hashBytes(H, S, strlen(S) + 1); }
+
+// 将整数加入哈希值
+static void hashInt(Hash128 *H, int64_t Val) { hashBytes(H, &Val, sizeof(Val)); }
+
+// 读取整个文件，失败时返回NULL
+char *readAll(char *Path, size_t *Len) {
+  FILE *FP = fopen(Path, "r");
+  if (!FP)
+    return NULL;
+
+  char *Buf;
+  FILE *Out = open_memstream(&Buf, Len);
+  char Buf2[4096];
+  size_t N;
+  while ((N = fread(Buf2, 1, sizeof(Buf2), FP)) > 0)
+    fwrite(Buf2, 1, N, Out);
+  fclose(FP);
+  fclose(Out);
+  return Buf;
+}
+
+// 计算缓存的键，返回32个十六进制字符
+// Options为影响编译结果的选项，DataFile为其他影响结果的文件，可以为NULL
+char *cacheKey(Token *Tok, char *Options, char *DataFile) {
+  Hash128 H;
+  hashInit(&H);
+  hashInt(&H, CACHE_VERSION);
+
+  // 编译器自身，重新构建rvcc后之前的缓存项不再有效
+  struct stat St;
+  if (stat("/proc/self/exe", &St) == 0) {
+    hashInt(&H, St.st_size);
+    hashInt(&H, St.st_mtim.tv_sec);
+    hashInt(&H, St.st_mtim.tv_nsec);
+  }
+
+  hashStr(&H, Options);
+
+  // 其他影响结果的文件，如-fprofile-use的剖析数据
+  size_t Len;
+  char *Data = DataFile ? readAll(DataFile, &Len) : NULL;
+  if (Data) {
+    hashBytes(&H, Data, Len);
+    free(Data);
+  }
+
+  // 所有的输入文件，代码生成时输出为.file指示
+  File **Files = getInputFiles();
+  for (int I = 0; Files[I]; I++) {
+    hashInt(&H, Files[I]->FileNo);
+    hashStr(&H, Files[I]->Name);
+  }
+
+  // 终结符流，文件编号和行号用于.loc指示
+  for (; Tok->Kind != TK_EOF; Tok = Tok->Next) {
+    hashInt(&H, Tok->Kind);
+    hashInt(&H, Tok->File->FileNo);
+    hashInt(&H, Tok->LineNo);
+    hashInt(&H, Tok->Len);
+    hashBytes(&H, Tok->Loc, Tok->Len);
+  }
+
+  return format("%08x%08x%08x%08x", H.W[3], H.W[2], H.W[1], H.W[0]);
+}
+
+// 缓存项的路径
+static char *entryPath(char *Dir, char *Key) {
+  return format("%s/%.2s/%s", Dir, Key, Key + 2);
+}
+
+// 创建目录，已存在时忽略
+static bool makeDir(char *Path) {
+  return mkdir(Path, 0777) == 0 || errno == EEXIST;
+}
+
+// 查找缓存项，命中时返回缓存的内容，Ns写入当初编译所用的纳秒数
+char *cacheLookup(char *Dir, char *Key, size_t *Len, int64_t *Ns) {
+  size_t FileLen;
+  char *Buf = readAll(entryPath(Dir, Key), &FileLen);
+  if (!Buf)
+    return NULL;
+
+  // 缓存项的头部：rvcc-cache 版本 纳秒数\n
+  int Version;
+  int HdrLen = 0;
+  if (sscanf(Buf, "rvcc-cache %d %ld%n", &Version, Ns, &HdrLen) != 2 ||
+      Buf[HdrLen] != '\n' || Version != CACHE_VERSION) {
+    free(Buf);
+    return NULL;
+  }
+  *Len = FileLen - HdrLen - 1;
+  return Buf + HdrLen + 1;
+}
+
+// 写入缓存项，Ns为编译所用的纳秒数
+// 写入失败时不影响编译，只是不进行缓存
+void cacheStore(char *Dir, char *Key, char *Buf, size_t Len, int64_t Ns) {
+  char *SubDir = format("%s/%.2s", Dir, Key);
+  if (!makeDir(Dir) || !makeDir(SubDir))
+    return;
+
+  // 先写入临时文件，再重命名为缓存项，重命名是原子操作
+  char *Tmp = format("%s/tmp.XXXXXX", SubDir);
+  int FD = mkstemp(Tmp);
+  if (FD == -1)
+    return;
+  FILE *Out = fdopen(FD, "w");
+  fprintf(Out, "rvcc-cache %d %ld\n", CACHE_VERSION, Ns);
+  fwrite(Buf, 1, Len, Out);
+  if (fclose(Out) != 0 || rename(Tmp, entryPath(Dir, Key)) != 0)
+    unlink(Tmp);
+}
+
+// 缓存的统计信息
+typedef struct {
+  int64_t Hits;    // 命中次数
+  int64_t Misses;  // 未命中次数
+  int64_t SavedNs; // 命中所节省的纳秒数
+} CacheStats;
+
+// 从文件描述符中读取统计信息
+static void readStats(int FD, CacheStats *S) {
+  char Buf[256] = {0};
+  if (pread(FD, Buf, sizeof(Buf) - 1, 0) <= 0)
+    return;
+  sscanf(Buf, "hits %ld\nmisses %ld\nsaved_ns %ld\n", &S->Hits, &S->Misses,
+         &S->SavedNs);
+}
+
+// 更新统计信息，Hit为是否命中，SavedNs为命中时节省的纳秒数
+void cacheUpdateStats(char *Dir, bool Hit, int64_t SavedNs) {
+  if (!makeDir(Dir))
+    return;
+  int FD = open(format("%s/stats", Dir), O_RDWR | O_CREAT, 0666);
+  if (FD == -1)
+    return;
+
+  // 对整个文件加写锁，其他进程会等待锁被释放
+  struct flock Lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+  while (fcntl(FD, F_SETLKW, &Lock) == -1)
+    if (errno != EINTR) {
+      close(FD);
+      return;
+    }
+
+  CacheStats S = {0};
+  readStats(FD, &S);
+  if (Hit) {
+    S.Hits++;
+    S.SavedNs += MAX(SavedNs, 0);
+  } else {
+    S.Misses++;
+  }
+
+  char Buf[256];
+  int Len = snprintf(Buf, sizeof(Buf), "hits %ld\nmisses %ld\nsaved_ns %ld\n",
+                     S.Hits, S.Misses, S.SavedNs);
+  if (ftruncate(FD, 0) == 0)
+    pwrite(FD, Buf, Len, 0);
+  // 关闭文件时释放锁
+  close(FD);
+}
+
+// 打印统计信息
+void cachePrintStats(char *Dir) {
+  CacheStats S = {0};
+  int FD = open(format("%s/stats", Dir), O_RDONLY);
+  if (FD != -1) {
+    struct flock Lock = {.l_type = F_RDLCK, .l_whence = SEEK_SET};
+    fcntl(FD, F_SETLKW, &Lock);
+    readStats(FD, &S);
+    close(FD);
+  }
+
+  int64_t Total = S.Hits + S.Misses;
+  fprintf(stderr, "cache directory: %s\n", Dir);
+  fprintf(stderr, "hits: %ld\n", S.Hits);
+  fprintf(stderr, "misses: %ld\n", S.Misses);
+  fprintf(stderr, "hit rate: %.1f%%\n", Total ? S.Hits * 100.0 / Total : 0.0);
+  fprintf(stderr, "time saved: %.3f s\n", S.SavedNs / 1e9);
+}
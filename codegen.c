@@ -7,11 +7,41 @@
 static FILE *OutputFile;
 // 记录栈深度
 static int Depth;
+// 当前函数中栈的最大深度
+static int MaxDepth;
 // 记录大结构体的深度
 static int BSDepth;
 // 当前的函数
 static Obj *CurrentFn;
 
+// 浮点常量池中的常量
+typedef struct FloConst FloConst;
+struct FloConst {
+  FloConst *Next; // 下一常量
+  char *Label;    // 常量的标签
+  int Size;       // 常量的字节数，4或8
+  uint64_t Bits;  // 常量的位模式
+};
+
+// 浮点常量池，每个翻译单元输出一次
+static FloConst *FloConsts;
+// 以大小和位模式为键，对常量进行去重
+static HashMap FloConstMap;
+
+// 当前函数的冷代码块，在函数末尾输出
+static StringArray ColdBlocks;
+
+// 剖析计数器的键，形式为"函数名:编号"，每个翻译单元输出一次
+static StringArray ProfKeys;
+// 当前函数第一个剖析计数器在ProfKeys中的位置
+static int ProfBase;
+// 当前函数的剖析计数器数量
+static int ProfCnt;
+// -fprofile-use读入的剖析数据
+static HashMap ProfData;
+// 剖析数据中函数入口计数的最大值
+static long ProfMaxEntry;
+
 // 我们将fs0～fs11两两组对形成6个寄存器对
 // 用于long double类型的存储，每次+2
 static int LDSP;
@@ -19,15 +49,77 @@ static int LDSP;
 static void genExpr(Node *Nd);
 static void genStmt(Node *Nd);
 
+// 统计输出的文本中的指令数
+// 文本可能包含多行，每行可以用;分隔多条语句，
+// 跳过空语句、标签、伪指令和#之后的注释
+static int countInsns(char *S) {
+  int N = 0;
+  while (*S) {
+    // 跳过空白和语句分隔符
+    if (isspace(*S) || *S == ';') {
+      S++;
+      continue;
+    }
+
+    // 伪指令和注释：跳过当前行
+    if (*S == '.' || *S == '#') {
+      S += strcspn(S, "\n");
+      continue;
+    }
+
+    // 语句的第一个单词
+    char *End = S + strcspn(S, " \t\n;#:");
+    // 标签：跳过后继续识别同一行中的语句
+    if (*End == ':') {
+      S = End + 1;
+      continue;
+    }
+
+    N++;
+    S = End + strcspn(End, "\n;#");
+  }
+  return N;
+}
+
 // 输出字符串到目标文件并换行
 __attribute__((format(printf, 1, 2))) static void printLn(char *Fmt, ...) {
   va_list VA;
 
+  // 直接输出可重定位文件时，由集成汇编器按照格式字符串编码
+  if (!OutputFile) {
+    va_start(VA, Fmt);
+    Counters.Insns += asmEmit(Fmt, VA);
+    va_end(VA);
+    return;
+  }
+
+  // 格式化到缓冲区中，以便统计实际输出的指令数
+  char Buf[256];
+  char *S = Buf;
   va_start(VA, Fmt);
-  vfprintf(OutputFile, Fmt, VA);
+  int Len = vsnprintf(Buf, sizeof(Buf), Fmt, VA);
   va_end(VA);
+  if (Len >= (int)sizeof(Buf)) {
+    S = calloc(1, Len + 1);
+    va_start(VA, Fmt);
+    vsnprintf(S, Len + 1, Fmt, VA);
+    va_end(VA);
+  }
 
-  fprintf(OutputFile, "\n");
+  fputs(S, OutputFile);
+  fputc('\n', OutputFile);
+  Counters.Insns += countInsns(S);
+
+  if (S != Buf)
+    free(S);
+}
+
+// 判断全局变量是否位于小数据段中
+// 小数据段中的变量可以被链接器松弛为基于gp的访问
+static bool isSmallData(Obj *Var) {
+  if (OptFPIC || Var->IsFunction || Var->IsTLS || Var->IsLocal)
+    return false;
+  return Var->Ty->Size > 0 && Var->Ty->Size <= OptG;
 }
 
 // 代码段计数
@@ -36,6 +128,35 @@ static int count(void) {
   return I++;
 }
 
+// 获取浮点常量在常量池中的标签，相同的常量只存储一次
+static char *floConstLabel(int Size, uint64_t Bits) {
+  char *Key = format("%d:%lx", Size, Bits);
+  FloConst *FC = hashmapGet(&FloConstMap, Key);
+  if (FC)
+    return FC->Label;
+
+  FC = allocMem(MEM_OTHER, sizeof(FloConst));
+  FC->Label = format(".LC%d", count());
+  FC->Size = Size;
+  FC->Bits = Bits;
+  FC->Next = FloConsts;
+  FloConsts = FC;
+  hashmapPut(&FloConstMap, Key, FC);
+  return FC->Label;
+}
+
+// 从常量池加载浮点常量到fa0
+static void loadFloConst(int Size, uint64_t Bits) {
+  char *Label = floConstLabel(Size, Bits);
+  int C = count();
+  printLn(".Lpcrel_hi%d:", C);
+  // 高20位地址，存到a0中
+  printLn("  auipc a0, %%pcrel_hi(%s)", Label);
+  // 低12位地址，加载对应的值到fa0中
+  printLn("  %s fa0, %%pcrel_lo(.Lpcrel_hi%d)(a0)", Size == 4 ? "flw" : "fld",
+          C);
+}
+
 // 压栈，将结果临时压入栈中备用
 // sp为栈指针，栈反向向下增长，64位下，8个字节为一个单位，所以sp-8
 // 当前栈指针的地址就是sp，将a0的值压入栈
@@ -45,6 +166,7 @@ static void push(void) {
   printLn("  addi sp, sp, -8");
   printLn("  sd a0, 0(sp)");
   Depth++;
+  MaxDepth = MAX(MaxDepth, Depth);
 }
 
 // 弹栈，将sp指向的地址的值，弹出到a1
@@ -55,12 +177,120 @@ static void pop(int Reg) {
   Depth--;
 }
 
+// 暂存中间结果的寄存器池
+// 函数调用之外，a2~a7只用于传递参数、原子比较交换和long double运算
+static char *RegPool[] = {"a2", "a3", "a4", "a5", "a6", "a7"};
+#define REG_POOL_SIZE 6
+// 不能使用寄存器池的子树的标号
+#define REG_UNSAFE 1000
+// 寄存器池中已使用的寄存器数量
+static int RegTop;
+// 当前函数中寄存器池的最大使用量
+static int MaxRegTop;
+
+// 判断节点是否为在a0和a1之间进行运算的整型二元运算
+static bool isIntBinary(Node *Nd) {
+  switch (Nd->Kind) {
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_DIV:
+  case ND_MOD:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+  case ND_SHL:
+  case ND_SHR:
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+    return isInteger(Nd->LHS->Ty) || Nd->LHS->Ty->Base;
+  default:
+    return false;
+  }
+}
+
+// Sethi-Ullman标号，计算子树所需的寄存器数量
+// 子树中存在会破坏寄存器池的代码时，返回REG_UNSAFE
+static int regNeed(Node *Nd) {
+  if (!Nd)
+    return 0;
+  if (Nd->RegNeed)
+    return Nd->RegNeed;
+
+  int Need = 1;
+  switch (Nd->Kind) {
+  // 函数调用会破坏所有的调用者保存寄存器
+  // 语句表达式和汇编中可以包含任意的代码
+  case ND_FUNCALL:
+  case ND_STMT_EXPR:
+  case ND_ASM:
+  case ND_CAS:
+    Need = REG_UNSAFE;
+    break;
+  // global-dynamic模型的线程局部变量需要调用__tls_get_addr
+  case ND_VAR:
+    if (Nd->Var->IsTLS)
+      Need = REG_UNSAFE;
+    break;
+  default: {
+    int L = regNeed(Nd->LHS), R = regNeed(Nd->RHS);
+    int Others = MAX(regNeed(Nd->Cond),
+                     MAX(regNeed(Nd->Then), regNeed(Nd->Els)));
+    for (Node *N = Nd->Body; N; N = N->Next)
+      Others = MAX(Others, regNeed(N));
+    for (Node *N = Nd->Args; N; N = N->Next)
+      Others = MAX(Others, regNeed(N));
+    // 二元运算的两个子树需要的寄存器数量相同时，需要额外的寄存器保存中间结果
+    if (isIntBinary(Nd))
+      Need = L == R ? L + 1 : MAX(L, R);
+    else
+      Need = MAX(Need, MAX(L, R));
+    Need = MAX(Need, Others);
+    break;
+  }
+  }
+
+  // long double运算需要调用库函数
+  if (Nd->Ty && Nd->Ty->Kind == TY_LDOUBLE)
+    Need = REG_UNSAFE;
+  Nd->RegNeed = MIN(Need, REG_UNSAFE);
+  return Nd->RegNeed;
+}
+
+// 暂存a0的值，之后计算子树Nd
+// 子树不会破坏寄存器池时，保存到寄存器池中，否则压栈
+// 返回寄存器池的下标，压栈时返回-1
+static int holdA0(Node *Nd) {
+  if (RegTop < REG_POOL_SIZE && regNeed(Nd) < REG_UNSAFE) {
+    printLn("  # 将a0的值暂存到%s", RegPool[RegTop]);
+    printLn("  mv %s, a0", RegPool[RegTop]);
+    MaxRegTop = MAX(MaxRegTop, RegTop + 1);
+    return RegTop++;
+  }
+  push();
+  return -1;
+}
+
+// 将holdA0暂存的值取出到a{Reg}
+static void releaseHeld(int Held, int Reg) {
+  if (Held < 0) {
+    pop(Reg);
+    return;
+  }
+  RegTop--;
+  printLn("  # 取出%s中暂存的值到a%d", RegPool[Held], Reg);
+  printLn("  mv a%d, %s", Reg, RegPool[Held]);
+}
+
 // 对于浮点类型进行压栈
 static void pushF(void) {
   printLn("  # 压栈，将fa0的值存入栈顶");
   printLn("  addi sp, sp, -8");
   printLn("  fsd fa0, 0(sp)");
   Depth++;
+  MaxDepth = MAX(MaxDepth, Depth);
 }
 
 // 对于浮点类型进行弹栈
@@ -97,6 +327,100 @@ int alignTo(int N, int Align) {
   return (N + Align - 1) / Align * Align;
 }
 
+// 判断符号是否绑定在当前模块内，不会被动态链接器替换
+// static和非default可见性的符号可以直接通过pc相对地址访问
+static bool isLocalBinding(Obj *Var) {
+  return Var->IsStatic || Var->Visibility;
+}
+
+// 获取直接调用的目标，需要通过函数指针调用时返回NULL
+static char *directCallee(Node *Fn) {
+  if (Fn->Kind != ND_VAR || Fn->Ty->Kind != TY_FUNC)
+    return NULL;
+  // 非PIC或模块内绑定的函数直接调用，可以被链接器松弛为jal
+  if (!OptFPIC || isLocalBinding(Fn->Var))
+    return Fn->Var->Name;
+  // 可能被其他模块替换的函数通过PLT调用
+  if (OptFPLT)
+    return format("%s@plt", Fn->Var->Name);
+  // -fno-plt时从GOT中读取函数地址后调用
+  return NULL;
+}
+
+// 选择线程局部变量的访问模型
+// 非PIC时变量位于可执行文件中：本文件定义的使用local-exec，外部的使用initial-exec
+// -ftls-model只限定最通用的模型，编译器可以选用更高效的模型
+static TLSModel tlsModel(Obj *Var) {
+  TLSModel Model = TLS_GLOBAL_DYNAMIC;
+  if (!OptFPIC)
+    Model = Var->IsDefinition ? TLS_LOCAL_EXEC : TLS_INITIAL_EXEC;
+  return Model > OptTLSModel ? Model : OptTLSModel;
+}
+
+// 计算线程局部变量的地址
+static void genTLSAddr(Obj *Var) {
+  switch (tlsModel(Var)) {
+  case TLS_LOCAL_EXEC:
+    printLn("  # 获取TLS%s的地址（local-exec）", Var->Name);
+    // 计算相对tp偏移量的高20位
+    printLn("  lui a0, %%tprel_hi(%s)", Var->Name);
+    // 加上线程指针，%tprel_add供链接器松弛使用
+    printLn("  add a0, a0, tp, %%tprel_add(%s)", Var->Name);
+    // 加上相对tp偏移量的低12位
+    printLn("  addi a0, a0, %%tprel_lo(%s)", Var->Name);
+    return;
+  case TLS_INITIAL_EXEC: {
+    int C = count();
+    printLn("  # 获取TLS%s的地址（initial-exec）", Var->Name);
+    printLn(".Lpcrel_hi%d:", C);
+    // 从GOT中读取相对tp的偏移量
+    printLn("  auipc a0, %%tls_ie_pcrel_hi(%s)", Var->Name);
+    printLn("  ld a0, %%pcrel_lo(.Lpcrel_hi%d)(a0)", C);
+    printLn("  add a0, a0, tp");
+    return;
+  }
+  default: {
+    // RISC-V没有local-dynamic的重定位，与global-dynamic相同
+    int C = count();
+    printLn("  # 获取TLS%s的地址（global-dynamic）", Var->Name);
+    printLn(".Lpcrel_hi%d:", C);
+    // 计算TLS高20位地址
+    printLn("  auipc a0, %%tls_gd_pcrel_hi(%s)", Var->Name);
+    // 计算TLS低12位地址
+    printLn("  addi a0, a0, %%pcrel_lo(.Lpcrel_hi%d)", C);
+    // 获取地址
+    printLn("  call __tls_get_addr@plt");
+    return;
+  }
+  }
+}
+
+// 获取存放返回缓冲区指针的隐式形参，不通过内存返回结构体时为NULL
+static Obj *retBufferPtr(void) {
+  Type *Ty = CurrentFn->Ty->ReturnTy;
+  if ((Ty->Kind == TY_STRUCT || Ty->Kind == TY_UNION) && Ty->Size > 16)
+    return CurrentFn->Params;
+  return NULL;
+}
+
+// 计算局部变量的地址，存入a0
+static void genLVarAddr(Obj *Var) {
+  // 具名返回值优化的变量，以及转交给被调用函数的返回缓冲区
+  // 都位于调用者的返回缓冲区中
+  Obj *Ptr = retBufferPtr();
+  if (Ptr && (Var == CurrentFn->RetVar || Var == Ptr)) {
+    printLn("  # 获取返回缓冲区中%s的地址", Var->Name);
+    printLn("  li t0, %d", Ptr->Offset);
+    printLn("  add t0, fp, t0");
+    printLn("  ld a0, 0(t0)");
+    return;
+  }
+
+  printLn("  # 获取局部变量%s的栈内地址为%d(fp)", Var->Name, Var->Offset);
+  printLn("  li t0, %d", Var->Offset);
+  printLn("  add a0, fp, t0");
+}
+
 // 计算给定节点的绝对地址
 // 如果报错，说明节点不在内存中
 static void genAddr(Node *Nd) {
@@ -114,10 +438,13 @@ static void genAddr(Node *Nd) {
 
     // 局部变量
     if (Nd->Var->IsLocal) { // 偏移量是相对于fp的
-      printLn("  # 获取局部变量%s的栈内地址为%d(fp)", Nd->Var->Name,
-              Nd->Var->Offset);
-      printLn("  li t0, %d", Nd->Var->Offset);
-      printLn("  add a0, fp, t0");
+      genLVarAddr(Nd->Var);
+      return;
+    }
+
+    // 线程局部变量
+    if (Nd->Var->IsTLS) {
+      genTLSAddr(Nd->Var);
       return;
     }
 
@@ -125,15 +452,11 @@ static void genAddr(Node *Nd) {
     if (OptFPIC) {
       int C = count();
       printLn(".Lpcrel_hi%d:", C);
-      // 线程局部变量
-      if (Nd->Var->IsTLS) {
-        printLn("  # 获取PIC中TLS%s的地址", Nd->Var->Name);
-        // 计算TLS高20位地址
-        printLn("  auipc a0, %%tls_gd_pcrel_hi(%s)", Nd->Var->Name);
-        // 计算TLS低12位地址
+      // 模块内绑定的符号不需要经过GOT
+      if (isLocalBinding(Nd->Var)) {
+        printLn("  # 获取PIC中模块内符号%s的地址", Nd->Var->Name);
+        printLn("  auipc a0, %%pcrel_hi(%s)", Nd->Var->Name);
         printLn("  addi a0, a0, %%pcrel_lo(.Lpcrel_hi%d)", C);
-        // 获取地址
-        printLn("  call __tls_get_addr@plt");
         return;
       }
 
@@ -147,12 +470,16 @@ static void genAddr(Node *Nd) {
       return;
     }
 
-    // 线程局部变量
-    if (Nd->Var->IsTLS) {
-      // 计算TLS高20位地址
-      printLn("  lui a0, %%tprel_hi(%s)", Nd->Var->Name);
-      // 计算TLS低12位地址
-      printLn("  addi a0, a0, %%tprel_lo(%s)", Nd->Var->Name);
+    // 小数据段中的全局变量
+    // auipc+addi可以被链接器松弛为一条基于gp的指令
+    if (isSmallData(Nd->Var)) {
+      int C = count();
+      printLn("  # 获取小数据段全局变量%s的地址", Nd->Var->Name);
+      printLn(".Lpcrel_hi%d:", C);
+      // 高20位地址，存到a0中
+      printLn("  auipc a0, %%pcrel_hi(%s)", Nd->Var->Name);
+      // 低12位地址，加到a0中
+      printLn("  addi a0, a0, %%pcrel_lo(.Lpcrel_hi%d)", C);
       return;
     }
 
@@ -271,10 +598,8 @@ static void load(Type *Ty) {
     printLn("  ld a0, 0(a0)");
 }
 
-// 将栈顶值(为一个地址)存入a0
-static void store(Type *Ty) {
-  pop(1);
-
+// 将a0的值存入a1中存放的地址
+static void storeToA1(Type *Ty) {
   switch (Ty->Kind) {
   case TY_STRUCT:
   case TY_UNION:
@@ -318,6 +643,12 @@ static void store(Type *Ty) {
     printLn("  sd a0, 0(a1)");
 };
 
+// 将栈顶值(为一个地址)存入a1，然后将a0的值写入该地址
+static void store(Type *Ty) {
+  pop(1);
+  storeToA1(Ty);
+}
+
 // 与0进行比较，不等于0则置1
 static void notZero(Type *Ty) {
   switch (Ty->Kind) {
@@ -908,8 +1239,7 @@ static int pushArgs(Node *Nd) {
 
   if (Nd->RetBuffer && Nd->Ty->Size > 16) {
     printLn("  # 返回类型是大于16字节的结构体，指向其的指针，压入栈顶");
-    printLn("  li t0, %d", Nd->RetBuffer->Offset);
-    printLn("  add a0, fp, t0");
+    genLVarAddr(Nd->RetBuffer);
     push();
   }
 
@@ -955,20 +1285,16 @@ static void copyRetBuffer(Obj *Var) {
 
   printLn("  # 复制整型结构体返回值到缓冲区中");
   for (int Off = 0; Off < Ty->Size; Off += 8) {
-    switch (Ty->Size - Off) {
-    case 1:
-      printLn("  sb a%d, %d(t1)", GP++, Off);
-      break;
-    case 2:
-      printLn("  sh a%d, %d(t1)", GP++, Off);
-      break;
-    case 3:
-    case 4:
-      printLn("  sw a%d, %d(t1)", GP++, Off);
-      break;
-    default:
-      printLn("  sd a%d, %d(t1)", GP++, Off);
-      break;
+    int Sz = MIN(8, Ty->Size - Off);
+    // 只写入结构体内的字节，缓冲区可能是被赋值的变量
+    printLn("  mv t2, a%d", GP++);
+    for (int I = 0; I < Sz;) {
+      int W = Sz - I >= 8 ? 8 : Sz - I >= 4 ? 4 : Sz - I >= 2 ? 2 : 1;
+      char *S = W == 8 ? "d" : W == 4 ? "w" : W == 2 ? "h" : "b";
+      printLn("  s%s t2, %d(t1)", S, Off + I);
+      if (I + W < Sz)
+        printLn("  srli t2, t2, %d", W * 8);
+      I += W;
     }
   }
 }
@@ -1040,11 +1366,37 @@ static void copyStructMem(void) {
   printLn("  add t0, fp, t0");
   printLn("  ld t1, 0(t0)");
 
-  printLn("  # 遍历结构体并从a0位置复制所有字节到t1");
-  for (int I = 0; I < Ty->Size; I++) {
-    printLn("  lb t0, %d(a0)", I);
-    printLn("  sb t0, %d(t1)", I);
+  // 按照结构体的对齐量，每次复制尽可能多的字节
+  int W = MIN(Ty->Align, 8);
+  char *S = W == 8 ? "d" : W == 4 ? "w" : W == 2 ? "h" : "b";
+  printLn("  # 遍历结构体并从a0位置每次复制%d字节到t1", W);
+  for (int I = 0; I < Ty->Size; I += W) {
+    printLn("  l%s t0, %d(a0)", S, I);
+    printLn("  s%s t0, %d(t1)", S, I);
   }
+  // 与GCC一致，返回调用者的缓冲区指针
+  printLn("  mv a0, t1");
+}
+
+// 判断结构体是否只通过整型寄存器返回
+static bool isIntRegStruct(Type *Ty) {
+  setFloStMemsTy(&Ty, 0, 0);
+  return !isSFloNum(Ty->FSReg1Ty) && !isSFloNum(Ty->FSReg2Ty);
+}
+
+// 判断赋值语句能否进行返回值优化
+// 函数直接将结构体返回到被赋值的局部变量中，不再经过临时的返回缓冲区
+static bool isRVOAssign(Node *Nd) {
+  Node *LHS = Nd->LHS, *RHS = Nd->RHS;
+  if (LHS->Kind != ND_VAR || !LHS->Var->IsLocal || RHS->Kind != ND_FUNCALL ||
+      !RHS->RetBuffer)
+    return false;
+  // 通过内存返回时，被调用函数会在返回前写入缓冲区
+  // 变量的地址未被获取时，被调用函数无法观察到变量被提前修改
+  if (RHS->Ty->Size > 16)
+    return !LHS->Var->IsAddrTaken;
+  // 通过寄存器返回时，在调用返回后写入缓冲区
+  return isIntRegStruct(RHS->Ty);
 }
 
 // 开辟Alloca空间
@@ -1128,6 +1480,326 @@ static void builtinAlloca(void) {
   printLn("sd a0, 0(t0)");
 }
 
+// 跳过不改变浮点类型的类型转换节点
+static Node *skipFloCast(Node *Nd, Type *Ty) {
+  while (Nd->Kind == ND_CAST && Nd->Ty->Kind == Ty->Kind &&
+         Nd->LHS->Ty->Kind == Ty->Kind)
+    Nd = Nd->LHS;
+  return Nd;
+}
+
+// 判断是否为float或double类型的乘法节点，是则返回该节点
+static Node *floMul(Node *Nd, Type *Ty) {
+  Nd = skipFloCast(Nd, Ty);
+  return Nd->Kind == ND_MUL ? Nd : NULL;
+}
+
+// 判断是否为float或double类型乘法的取反节点，是则返回乘法节点
+static Node *floNegMul(Node *Nd, Type *Ty) {
+  Nd = skipFloCast(Nd, Ty);
+  return Nd->Kind == ND_NEG ? floMul(Nd->LHS, Ty) : NULL;
+}
+
+// 尝试将 a*b±c 融合为乘加指令
+// 成功生成时返回true，结果写入fa0
+static bool genFMA(Node *Nd) {
+  if (!OptFPContract || (Nd->Kind != ND_ADD && Nd->Kind != ND_SUB))
+    return false;
+
+  Type *Ty = Nd->LHS->Ty;
+  if (Ty->Kind != TY_FLOAT && Ty->Kind != TY_DOUBLE)
+    return false;
+
+  // 乘法节点，加数，指令名
+  Node *Mul;
+  Node *Addend;
+  char *Inst;
+  if (Nd->Kind == ND_ADD && (Mul = floMul(Nd->LHS, Ty))) {
+    // a*b+c
+    Addend = Nd->RHS, Inst = "fmadd";
+  } else if (Nd->Kind == ND_ADD && (Mul = floMul(Nd->RHS, Ty))) {
+    // c+a*b
+    Addend = Nd->LHS, Inst = "fmadd";
+  } else if (Nd->Kind == ND_SUB && (Mul = floMul(Nd->LHS, Ty))) {
+    // a*b-c
+    Addend = Nd->RHS, Inst = "fmsub";
+  } else if (Nd->Kind == ND_SUB && (Mul = floMul(Nd->RHS, Ty))) {
+    // c-a*b = -(a*b)+c
+    Addend = Nd->LHS, Inst = "fnmsub";
+  } else if (Nd->Kind == ND_ADD && (Mul = floNegMul(Nd->LHS, Ty))) {
+    // -(a*b)+c
+    Addend = Nd->RHS, Inst = "fnmsub";
+  } else if (Nd->Kind == ND_ADD && (Mul = floNegMul(Nd->RHS, Ty))) {
+    // c+(-(a*b))
+    Addend = Nd->LHS, Inst = "fnmsub";
+  } else if (Nd->Kind == ND_SUB && (Mul = floNegMul(Nd->LHS, Ty))) {
+    // -(a*b)-c
+    Addend = Nd->RHS, Inst = "fnmadd";
+  } else {
+    return false;
+  }
+
+  // 依次计算a、b、c，a和b压栈，c留在fa0中
+  genExpr(Mul->LHS);
+  pushF();
+  genExpr(Mul->RHS);
+  pushF();
+  genExpr(Addend);
+  popF(2);
+  popF(1);
+
+  char *Suffix = (Ty->Kind == TY_FLOAT) ? "s" : "d";
+  printLn("  # 乘加融合，fa1×fa2与fa0运算，结果写入fa0");
+  printLn("  %s.%s fa0, fa1, fa2, fa0", Inst, Suffix);
+  return true;
+}
+
+// 内存序是否具有获取语义
+static bool isAcquire(MemOrder Order) {
+  return Order == MO_CONSUME || Order == MO_ACQUIRE || Order == MO_ACQ_REL ||
+         Order == MO_SEQ_CST;
+}
+
+// 内存序是否具有释放语义
+static bool isRelease(MemOrder Order) {
+  return Order == MO_RELEASE || Order == MO_ACQ_REL || Order == MO_SEQ_CST;
+}
+
+// AMO指令的aq、rl后缀
+static char *amoSuffix(MemOrder Order) {
+  if (isAcquire(Order) && isRelease(Order))
+    return ".aqrl";
+  if (isAcquire(Order))
+    return ".aq";
+  if (isRelease(Order))
+    return ".rl";
+  return "";
+}
+
+// lr指令的后缀，顺序一致时使用aqrl
+static char *lrSuffix(MemOrder Order) {
+  if (Order == MO_SEQ_CST)
+    return ".aqrl";
+  return isAcquire(Order) ? ".aq" : "";
+}
+
+// sc指令的后缀
+static char *scSuffix(MemOrder Order) { return isRelease(Order) ? ".rl" : ""; }
+
+// 生成内存屏障
+static void genFence(MemOrder Order) {
+  switch (Order) {
+  case MO_CONSUME:
+  case MO_ACQUIRE:
+    printLn("  fence r, rw");
+    return;
+  case MO_RELEASE:
+    printLn("  fence rw, w");
+    return;
+  case MO_ACQ_REL:
+    printLn("  fence.tso");
+    return;
+  case MO_SEQ_CST:
+    printLn("  fence rw, rw");
+    return;
+  default:
+    return;
+  }
+}
+
+// 对字和双字可以直接使用的AMO指令
+static char *amoName(AtomicOp Op, Type *Ty) {
+  bool IsUnsigned = Ty->IsUnsigned || Ty->Kind == TY_PTR;
+  switch (Op) {
+  case AO_XCHG:
+    return "amoswap";
+  case AO_ADD:
+    return "amoadd";
+  case AO_AND:
+    return "amoand";
+  case AO_OR:
+    return "amoor";
+  case AO_XOR:
+    return "amoxor";
+  case AO_MAX:
+    return IsUnsigned ? "amomaxu" : "amomax";
+  case AO_MIN:
+    return IsUnsigned ? "amominu" : "amomin";
+  default:
+    return NULL;
+  }
+}
+
+// 生成原子读改写的运算，Dst = A op B
+static void genAtomicOp(AtomicOp Op, Type *Ty, char *Dst, char *A, char *B) {
+  char *U = (Ty->IsUnsigned || Ty->Kind == TY_PTR) ? "u" : "";
+  switch (Op) {
+  case AO_XCHG:
+    printLn("  mv %s, %s", Dst, B);
+    return;
+  case AO_ADD:
+    printLn("  add %s, %s, %s", Dst, A, B);
+    return;
+  case AO_SUB:
+    printLn("  sub %s, %s, %s", Dst, A, B);
+    return;
+  case AO_AND:
+    printLn("  and %s, %s, %s", Dst, A, B);
+    return;
+  case AO_OR:
+    printLn("  or %s, %s, %s", Dst, A, B);
+    return;
+  case AO_XOR:
+    printLn("  xor %s, %s, %s", Dst, A, B);
+    return;
+  case AO_NAND:
+    printLn("  and %s, %s, %s", Dst, A, B);
+    printLn("  not %s, %s", Dst, Dst);
+    return;
+  case AO_MAX:
+  case AO_MIN:
+    printLn("  mv %s, %s", Dst, A);
+    printLn("  %s%s %s, %s, 2f", Op == AO_MAX ? "bge" : "ble", U, A, B);
+    printLn("  mv %s, %s", Dst, B);
+    printLn("2:");
+    return;
+  }
+  unreachable();
+}
+
+// 将字内的单字节或双字节对齐到所在的字
+// a0为对象地址，运算后为字的地址，t3为对象在字内的位移，t4为掩码
+static void alignSubword(int Size) {
+  printLn("  # 计算对象在所在字中的位移和掩码");
+  printLn("  andi t3, a0, 3");
+  printLn("  slli t3, t3, 3");
+  printLn("  andi a0, a0, -4");
+  printLn("  li t4, %d", Size == 1 ? 0xff : 0xffff);
+  printLn("  sll t4, t4, t3");
+}
+
+// 生成原子读改写
+// 字和双字使用AMO指令，单字节、双字节和与非运算使用lr/sc循环
+static void genAtomicRMW(Node *Nd) {
+  genExpr(Nd->LHS);
+  push();
+  genExpr(Nd->RHS);
+  printLn("  mv a1, a0");
+  pop(0);
+
+  Type *Ty = Nd->Ty;
+  int Bits = Ty->Size * 8;
+  char *S = Ty->Size == 8 ? "d" : "w";
+  AtomicOp Op = Nd->AtomOp;
+  printLn("  # 原子读改写，a0为地址，a1为操作数");
+
+  if (Ty->Size >= 4 && Op != AO_NAND) {
+    // 减法转换为加上相反数
+    if (Op == AO_SUB) {
+      printLn("  neg a1, a1");
+      Op = AO_ADD;
+    }
+    printLn("  %s.%s%s t0, a1, (a0)", amoName(Op, Ty), S,
+            amoSuffix(Nd->Order));
+  } else if (Ty->Size >= 4) {
+    printLn("1:");
+    printLn("  lr.%s%s t0, (a0)", S, lrSuffix(Nd->Order));
+    genAtomicOp(Op, Ty, "t1", "t0", "a1");
+    printLn("  sc.%s%s t2, t1, (a0)", S, scSuffix(Nd->Order));
+    printLn("  bnez t2, 1b");
+  } else {
+    // 读取所在的字，只修改掩码内的部分
+    alignSubword(Ty->Size);
+    printLn("  not t5, t4");
+    printLn("1:");
+    printLn("  lr.w%s t6, (a0)", lrSuffix(Nd->Order));
+    printLn("  # 取出对象的原值到t0");
+    printLn("  srl t0, t6, t3");
+    printLn("  slli t0, t0, %d", 64 - Bits);
+    printLn("  sr%si t0, t0, %d", Ty->IsUnsigned ? "l" : "a", 64 - Bits);
+    genAtomicOp(Op, Ty, "t1", "t0", "a1");
+    printLn("  # 将新值写回字中对象的位置");
+    printLn("  sll t1, t1, t3");
+    printLn("  and t1, t1, t4");
+    printLn("  and t2, t6, t5");
+    printLn("  or t1, t1, t2");
+    printLn("  sc.w%s t2, t1, (a0)", scSuffix(Nd->Order));
+    printLn("  bnez t2, 1b");
+  }
+
+  // 原值在t0中，根据需要返回原值或运算后的值
+  printLn("  mv a0, t0");
+  cast(TyLong, Ty);
+  if (!Nd->RetOld) {
+    printLn("  mv t0, a0");
+    genAtomicOp(Op, Ty, "a0", "t0", "a1");
+    cast(TyLong, Ty);
+  }
+}
+
+// 生成原子比较交换
+// 当地址中的值与旧值相同时，写入新值并返回1
+// 否则将地址中的值写入旧值的地址，并返回0
+static void genCAS(Node *Nd) {
+  printLn("# =====原子比较交换===============");
+  genExpr(Nd->CasAddr);
+  push();
+  genExpr(Nd->CasOld);
+  push();
+  genExpr(Nd->CasNew);
+  // a2为新值，a1为旧值的地址，a0为地址
+  printLn("  mv a2, a0");
+  pop(1);
+  pop(0);
+
+  Type *Ty = Nd->CasAddr->Ty->Base;
+  char *S = Ty->Size == 1   ? "b"
+            : Ty->Size == 2 ? "h"
+            : Ty->Size == 4 ? "w"
+                            : "d";
+  // 旧值按照有符号数读取，与lr指令的符号扩展一致
+  printLn("  l%s a3, 0(a1)", S);
+
+  if (Ty->Size >= 4) {
+    printLn("1:");
+    // lr（Load-Reserved）：加载并保留对该内存地址的控制权
+    printLn("  lr.%s%s t0, (a0)", S, lrSuffix(Nd->Order));
+    // 地址的值和旧值比较，若不等则退出
+    printLn("  bne t0, a3, 2f");
+    // sc（Store-Conditional）：只有在该内存地址仍然被保留时才会写入
+    printLn("  sc.%s%s t1, a2, (a0)", S, scSuffix(Nd->Order));
+    // 不为0时，写入失败，重新写入
+    printLn("  bnez t1, 1b");
+    printLn("2:");
+    printLn("  xor t2, t0, a3");
+  } else {
+    // 比较和写入所在字中掩码内的部分
+    alignSubword(Ty->Size);
+    printLn("  sll a3, a3, t3");
+    printLn("  and a3, a3, t4");
+    printLn("  sll a2, a2, t3");
+    printLn("  and a2, a2, t4");
+    printLn("  not t5, t4");
+    printLn("1:");
+    printLn("  lr.w%s t6, (a0)", lrSuffix(Nd->Order));
+    printLn("  and t0, t6, t4");
+    printLn("  bne t0, a3, 2f");
+    printLn("  and t1, t6, t5");
+    printLn("  or t1, t1, a2");
+    printLn("  sc.w%s a4, t1, (a0)", scSuffix(Nd->Order));
+    printLn("  bnez a4, 1b");
+    printLn("2:");
+    printLn("  xor t2, t0, a3");
+    printLn("  srl t0, t0, t3");
+  }
+
+  // t2为0时表示成功，否则将地址中的值写入旧值的地址
+  printLn("  seqz a0, t2");
+  printLn("  beqz t2, 3f");
+  printLn("  s%s t0, 0(a1)", S);
+  printLn("3:");
+}
+
 // 生成表达式
 static void genExpr(Node *Nd) {
   // .loc 文件编号 行号
@@ -1149,9 +1821,14 @@ static void genExpr(Node *Nd) {
         uint32_t U32;
       } U;
       U.F32 = Nd->FVal;
-      printLn("  # 将a0转换到float类型值为%Lf的fa0中", Nd->FVal);
-      printLn("  li a0, %u  # float %Lf", U.U32, Nd->FVal);
-      printLn("  fmv.w.x fa0, a0");
+      // +0.0直接从零寄存器转换
+      if (U.U32 == 0) {
+        printLn("  # 将float类型值0.0加载到fa0中");
+        printLn("  fmv.w.x fa0, zero");
+        return;
+      }
+      printLn("  # 从常量池加载float类型值%Lf到fa0中", Nd->FVal);
+      loadFloConst(4, U.U32);
       return;
     }
     case TY_DOUBLE: {
@@ -1159,10 +1836,15 @@ static void genExpr(Node *Nd) {
         double F64;
         uint64_t U64;
       } U;
-      printLn("  # 将a0转换到double类型值为%Lf的fa0中", Nd->FVal);
       U.F64 = Nd->FVal;
-      printLn("  li a0, %lu  # double %Lf", U.U64, Nd->FVal);
-      printLn("  fmv.d.x fa0, a0");
+      // +0.0直接从零寄存器转换
+      if (U.U64 == 0) {
+        printLn("  # 将double类型值0.0加载到fa0中");
+        printLn("  fmv.d.x fa0, zero");
+        return;
+      }
+      printLn("  # 从常量池加载double类型值%Lf到fa0中", Nd->FVal);
+      loadFloConst(8, U.U64);
       return;
     }
     case TY_LDOUBLE: {
@@ -1265,15 +1947,29 @@ static void genExpr(Node *Nd) {
     genAddr(Nd->LHS);
     return;
   // 赋值
-  case ND_ASSIGN:
+  case ND_ASSIGN: {
+    // 返回值优化，以被赋值的变量作为返回缓冲区
+    if (isRVOAssign(Nd)) {
+      printLn("  # 返回值优化，直接返回到变量%s中", Nd->LHS->Var->Name);
+      Nd->RHS->RetBuffer = Nd->LHS->Var;
+      genExpr(Nd->RHS);
+      return;
+    }
+
     // 左部是左值，保存值到的地址
     genAddr(Nd->LHS);
-    push();
+    // 位域成员变量需要从栈顶读取地址，其他情况可以暂存在寄存器池中
+    bool IsBitfield = Nd->LHS->Kind == ND_MEMBER && Nd->LHS->Mem->IsBitfield;
+    int Held = -1;
+    if (IsBitfield)
+      push();
+    else
+      Held = holdA0(Nd->RHS);
     // 右部是右值，为表达式的值
     genExpr(Nd->RHS);
 
     // 如果是位域成员变量，需要先从内存中读取当前值，然后合并到新值中
-    if (Nd->LHS->Kind == ND_MEMBER && Nd->LHS->Mem->IsBitfield) {
+    if (IsBitfield) {
       printLn("\n  # 位域成员变量进行赋值↓");
       printLn("  # 备份需要赋的a0值");
       printLn("  mv t2, a0");
@@ -1314,8 +2010,10 @@ static void genExpr(Node *Nd) {
       return;
     }
 
-    store(Nd->Ty);
+    releaseHeld(Held, 1);
+    storeToA1(Nd->Ty);
     return;
+  }
   // 语句表达式
   case ND_STMT_EXPR:
     for (Node *N = Nd->Body; N; N = N->Next)
@@ -1333,6 +2031,19 @@ static void genExpr(Node *Nd) {
     return;
   // 内存清零
   case ND_MEMZERO: {
+    // 具名返回值优化的变量位于返回缓冲区中
+    if (Nd->Var == CurrentFn->RetVar) {
+      printLn("  # 对返回缓冲区中的%s清零%d位", Nd->Var->Name,
+              Nd->Var->Ty->Size);
+      genLVarAddr(Nd->Var);
+      for (int I = 0; I < Nd->Var->Ty->Size; I++) {
+        printLn("  li t0, %d", I);
+        printLn("  add t0, a0, t0");
+        printLn("  sb zero, 0(t0)");
+      }
+      return;
+    }
+
     printLn("  # 对%s的内存%d(fp)清零%d位", Nd->Var->Name, Nd->Var->Offset,
             Nd->Var->Ty->Size);
     // 对栈内变量所占用的每个字节都进行清零
@@ -1430,9 +2141,13 @@ static void genExpr(Node *Nd) {
     // 计算所有参数的值，正向压栈
     // 此处获取到栈传递参数的数量
     int StackArgs = pushArgs(Nd);
-    genExpr(Nd->LHS);
-    // 将a0的值存入t5
-    printLn("  mv t5, a0");
+    // 直接调用的函数，不需要计算函数地址
+    char *Callee = directCallee(Nd->LHS);
+    if (!Callee) {
+      genExpr(Nd->LHS);
+      // 将a0的值存入t5
+      printLn("  mv t5, a0");
+    }
 
     // 反向弹栈，a0->参数1，a1->参数2……
     int GP = 0, FP = 0;
@@ -1543,7 +2258,10 @@ static void genExpr(Node *Nd) {
 
     // 调用函数
     printLn("  # 调用函数");
-    printLn("  jalr t5");
+    if (Callee)
+      printLn("  call %s", Callee);
+    else
+      printLn("  jalr t5");
 
     if (Nd->Ty->Kind == TY_LDOUBLE) {
       printLn("  # 保存Long double类型函数的返回值");
@@ -1597,6 +2315,9 @@ static void genExpr(Node *Nd) {
       printLn("  li t0, %d", Nd->RetBuffer->Offset);
       printLn("  add a0, fp, t0");
     }
+    // 通过内存返回的结构体，值位于返回缓冲区中
+    if (Nd->RetBuffer && Nd->Ty->Size > 16)
+      genLVarAddr(Nd->RetBuffer);
 
     return;
   }
@@ -1604,62 +2325,36 @@ static void genExpr(Node *Nd) {
     printLn("  # 加载标签%s的值到a0中", Nd->UniqueLabel);
     printLn("  la a0, %s", Nd->UniqueLabel);
     return;
-  case ND_CAS: {
-    printLn("# =====原子比较交换===============");
-    // 当 t1地址中的值t0 与 t3旧值 相同时，将 t1地址中的值 替换为 t4新值
-    // 若不同时，将 地址中的值t0 替换掉 旧值
-    genExpr(Nd->CasAddr);
-    printLn("  mv t1, a0"); // t1地址
-    genExpr(Nd->CasOld);
-    printLn("  mv t2, a0"); // t2旧值地址
-    load(Nd->CasOld->Ty->Base);
-    printLn("  mv t3, a0"); // t3旧值
-    genExpr(Nd->CasNew);
-    printLn("  mv t4, a0"); // t4新值
-
-    // fence用于控制设备、内存的读写顺序
-    // iorw：之前的设备输入输出、内存读写指令，不能晚于fence指令
-    // ow：之后的设备输出、内存写的指令，不能早于fence指令
-    printLn("  fence iorw, ow");
-    printLn("1:");
-    // 加载地址中的值到t0
-    // lr（Load-Reserved）：加载并保留对该内存地址的控制权
-    // aq（acquisition）：若设置了aq位，
-    // 则此硬件线程中在AMO（原子内存操作）之后的任何内存操作，都不会在AMO之前发生
-    printLn("  lr.w.aq t0, (t1)");
-    // 地址的值和旧值比较，若不等则退出
-    printLn("  bne t0, t3, 2f");
-    // 写入新值到地址
-    // sc（Store-Conditional）：将寄存器中的值写入指定内存地址。
-    // 写入操作只有在该内存地址仍然被处理器保留时才会生效。
-    printLn("  sc.w.aq a0, t4, (t1)");
-    // 不为0时，写入失败，重新写入
-    printLn("  bnez a0, 1b");
-
-    printLn("2:");
-    // t0地址中的值 减去 t3旧值，将 差值 存入 t3
-    printLn("  subw t3, t0, t3");
-    // 判断差值t3，t3为0时 返回值a0为1，t3不为0时 返回值a0为0
-    printLn("  seqz a0, t3");
-    // 判断差值t3，t3为0时跳转到最后
-    printLn("  beqz t3, 3f");
-    // 若不同时，将 地址中的值t0 写入 t2旧值的地址，替换掉 旧值
-    printLn("  sw t0, (t2)");
-    printLn("3:");
-    return;
-  }
-  case ND_EXCH: {
+  case ND_CAS:
+    genCAS(Nd);
+    return;
+  case ND_ATOM_LD:
+    genExpr(Nd->LHS);
+    printLn("  # 原子读取");
+    // 顺序一致的读取，需要等待之前的读写完成
+    if (Nd->Order == MO_SEQ_CST)
+      printLn("  fence rw, rw");
+    load(Nd->Ty);
+    // 获取语义，之后的读写不能早于此次读取
+    if (isAcquire(Nd->Order))
+      printLn("  fence r, rw");
+    return;
+  case ND_ATOM_ST:
     genExpr(Nd->LHS);
     push();
     genExpr(Nd->RHS);
-    pop(1);
-
-    int Sz = Nd->LHS->Ty->Base->Size;
-    char *S = (Sz <= 4) ? "w" : "d";
-    printLn("  # 原子交换");
-    printLn("  amoswap.%s.aq a0, a0, (a1)", S);
+    printLn("  # 原子写入");
+    // 释放语义，之前的读写不能晚于此次写入
+    if (isRelease(Nd->Order))
+      printLn("  fence rw, w");
+    store(Nd->RHS->Ty);
+    return;
+  case ND_ATOM_RMW:
+    genAtomicRMW(Nd);
+    return;
+  case ND_FENCE:
+    genFence(Nd->Order);
     return;
-  }
   default:
     break;
   }
@@ -1668,6 +2363,10 @@ static void genExpr(Node *Nd) {
   switch (Nd->LHS->Ty->Kind) {
   case TY_FLOAT:
   case TY_DOUBLE: {
+    // 尝试生成乘加融合指令
+    if (genFMA(Nd))
+      return;
+
     // 递归到最右节点
     genExpr(Nd->RHS);
     // 将结果压入栈
@@ -1774,14 +2473,25 @@ static void genExpr(Node *Nd) {
     break;
   }
 
-  // 递归到最右节点
-  genExpr(Nd->RHS);
-  // 将结果压入栈
-  push();
-  // 递归到左节点
-  genExpr(Nd->LHS);
-  // 将结果弹栈到a1
-  pop(1);
+  // Sethi-Ullman：先计算需要寄存器较多的子树
+  // 后计算的子树不会破坏寄存器池时，中间结果暂存在寄存器中
+  if (regNeed(Nd->LHS) > regNeed(Nd->RHS)) {
+    // 递归到左节点
+    genExpr(Nd->LHS);
+    int Held = holdA0(Nd->RHS);
+    // 递归到右节点，结果存入a1
+    genExpr(Nd->RHS);
+    printLn("  mv a1, a0");
+    releaseHeld(Held, 0);
+  } else {
+    // 递归到最右节点
+    genExpr(Nd->RHS);
+    int Held = holdA0(Nd->LHS);
+    // 递归到左节点
+    genExpr(Nd->LHS);
+    // 将结果取出到a1
+    releaseHeld(Held, 1);
+  }
 
   // 生成各个二叉树节点
   char *Suffix = Nd->LHS->Ty->Kind == TY_LONG || Nd->LHS->Ty->Base ? "" : "w";
@@ -1886,6 +2596,103 @@ static void genExpr(Node *Nd) {
   errorTok(Nd->Tok, "invalid expression");
 }
 
+// 分配当前函数内的剖析计数器，返回其编号
+// 计数器按照代码生成的顺序编号，-fprofile-generate和-fprofile-use保持一致
+static int newProfCounter(void) {
+  if (OptFProfileGenerate)
+    strArrayPush(&ProfKeys, format("%s:%d", CurrentFn->Name, ProfCnt));
+  return ProfCnt++;
+}
+
+// 生成剖析计数器自增的代码
+static void genProfInc(int Idx) {
+  if (!OptFProfileGenerate)
+    return;
+
+  int C = count();
+  printLn("  # 剖析计数器%s自增", ProfKeys.Data[ProfBase + Idx]);
+  printLn(".Lpcrel_hi%d:", C);
+  printLn("  auipc t0, %%pcrel_hi(.L.prof.counts)");
+  printLn("  addi t0, t0, %%pcrel_lo(.Lpcrel_hi%d)", C);
+  printLn("  li t1, %d", (ProfBase + Idx) * 8);
+  printLn("  add t0, t0, t1");
+  printLn("  ld t1, 0(t0)");
+  printLn("  addi t1, t1, 1");
+  printLn("  sd t1, 0(t0)");
+}
+
+// 读取剖析计数，没有剖析数据时返回-1
+static long profCount(char *FnName, int Idx) {
+  long *Cnt = hashmapGet(&ProfData, format("%s:%d", FnName, Idx));
+  return Cnt ? *Cnt : -1;
+}
+
+// 根据剖析数据判断分支是否不太可能被执行
+// 执行次数不足另一分支的十分之一时，视为冷分支
+static bool profUnlikely(int Idx, int Other) {
+  long A = profCount(CurrentFn->Name, Idx);
+  long B = profCount(CurrentFn->Name, Other);
+  return A >= 0 && B > 0 && A * 10 < B;
+}
+
+// 判断表达式中是否调用了冷函数或者不返回的函数
+static bool hasColdCall(Node *Nd) {
+  if (!Nd)
+    return false;
+
+  if (Nd->Kind == ND_FUNCALL && Nd->LHS->Kind == ND_VAR) {
+    Obj *Fn = Nd->LHS->Var;
+    if (Fn->IsCold || Fn->IsNoreturn)
+      return true;
+  }
+
+  for (Node *Arg = Nd->Args; Arg; Arg = Arg->Next)
+    if (hasColdCall(Arg))
+      return true;
+  return hasColdCall(Nd->LHS) || hasColdCall(Nd->RHS);
+}
+
+// 判断语句是否不太可能被执行
+// 即语句会直接调用冷函数或者不返回的函数
+static bool isUnlikely(Node *Nd) {
+  if (!Nd)
+    return false;
+
+  switch (Nd->Kind) {
+  case ND_BLOCK:
+    for (Node *N = Nd->Body; N; N = N->Next)
+      if (isUnlikely(N))
+        return true;
+    return false;
+  case ND_EXPR_STMT:
+  case ND_RETURN:
+    return hasColdCall(Nd->LHS);
+  default:
+    return false;
+  }
+}
+
+// 将不太可能被执行的语句生成到冷代码块中，在函数末尾输出
+// 执行完后跳转回分支C的.L.end.C段
+static void genColdStmt(Node *Nd, int C, int ProfIdx) {
+  char *Buf;
+  size_t BufLen;
+  FILE *Out = open_memstream(&Buf, &BufLen);
+  FILE *Saved = OutputFile;
+  OutputFile = Out;
+
+  printLn("\n# 分支%d的.L.cold.%d段标签", C, C);
+  printLn(".L.cold.%d:", C);
+  genProfInc(ProfIdx);
+  genStmt(Nd);
+  printLn("  # 跳转回分支%d的.L.end.%d段", C, C);
+  printLn("  j .L.end.%d", C);
+
+  fclose(Out);
+  OutputFile = Saved;
+  strArrayPush(&ColdBlocks, Buf);
+}
+
 // 生成语句
 static void genStmt(Node *Nd) {
   // .loc 文件编号 行号
@@ -1896,16 +2703,48 @@ static void genStmt(Node *Nd) {
   case ND_IF: {
     // 代码段计数
     int C = count();
+    // Then和Else分支的剖析计数器
+    int ThenIdx = newProfCounter();
+    int ElsIdx = newProfCounter();
     printLn("\n# =====分支语句%d==============", C);
     // 生成条件内语句
     printLn("\n# Cond表达式%d", C);
     genExpr(Nd->Cond);
     notZero(Nd->Cond->Ty);
+
+    // Then语句不太可能被执行，将其移到函数末尾
+    if (isUnlikely(Nd->Then) || profUnlikely(ThenIdx, ElsIdx)) {
+      printLn("  # 若a0不为0，则跳转到分支%d的.L.cold.%d段", C, C);
+      printLn("  bnez a0, .L.cold.%d", C);
+      genColdStmt(Nd->Then, C, ThenIdx);
+      printLn("\n# Else语句%d", C);
+      genProfInc(ElsIdx);
+      if (Nd->Els)
+        genStmt(Nd->Els);
+      printLn("\n# 分支%d的.L.end.%d段标签", C, C);
+      printLn(".L.end.%d:", C);
+      return;
+    }
+
+    // Else语句不太可能被执行，将其移到函数末尾
+    if (isUnlikely(Nd->Els) || (Nd->Els && profUnlikely(ElsIdx, ThenIdx))) {
+      printLn("  # 若a0为0，则跳转到分支%d的.L.cold.%d段", C, C);
+      printLn("  beqz a0, .L.cold.%d", C);
+      printLn("\n# Then语句%d", C);
+      genProfInc(ThenIdx);
+      genStmt(Nd->Then);
+      genColdStmt(Nd->Els, C, ElsIdx);
+      printLn("\n# 分支%d的.L.end.%d段标签", C, C);
+      printLn(".L.end.%d:", C);
+      return;
+    }
+
     // 判断结果是否为0，为0则跳转到else标签
     printLn("  # 若a0为0，则跳转到分支%d的.L.else.%d段", C, C);
     printLn("  beqz a0, .L.else.%d", C);
     // 生成符合条件后的语句
     printLn("\n# Then语句%d", C);
+    genProfInc(ThenIdx);
     genStmt(Nd->Then);
     // 执行完后跳转到if语句后面的语句
     printLn("  # 跳转到分支%d的.L.end.%d段", C, C);
@@ -1914,6 +2753,7 @@ static void genStmt(Node *Nd) {
     printLn("\n# Else语句%d", C);
     printLn("# 分支%d的.L.else.%d段标签", C, C);
     printLn(".L.else.%d:", C);
+    genProfInc(ElsIdx);
     // 生成不符合条件后的语句
     if (Nd->Els)
       genStmt(Nd->Els);
@@ -1986,12 +2826,37 @@ static void genStmt(Node *Nd) {
     printLn("%s:", Nd->BrkLabel);
     return;
   }
-  case ND_SWITCH:
+  case ND_SWITCH: {
     printLn("\n# =====switch语句===============");
     genExpr(Nd->Cond);
 
-    printLn("  # 遍历跳转到值等于a0的case标签");
+    // 为每个case和default分配剖析计数器
+    int NCase = 0;
     for (Node *N = Nd->CaseNext; N; N = N->CaseNext) {
+      N->ProfIdx = newProfCounter();
+      NCase++;
+    }
+    if (Nd->DefaultCase)
+      Nd->DefaultCase->ProfIdx = newProfCounter();
+
+    // 按照剖析数据中的执行次数，从高到低排列case的比较顺序
+    // case的值互不重叠，因此比较顺序不影响结果
+    Node **Cases = allocMem(MEM_OTHER, NCase * sizeof(Node *));
+    int I = 0;
+    for (Node *N = Nd->CaseNext; N; N = N->CaseNext, I++) {
+      long Cnt = profCount(CurrentFn->Name, N->ProfIdx);
+      int J = I;
+      while (J > 0 &&
+             profCount(CurrentFn->Name, Cases[J - 1]->ProfIdx) < Cnt) {
+        Cases[J] = Cases[J - 1];
+        J--;
+      }
+      Cases[J] = N;
+    }
+
+    printLn("  # 遍历跳转到值等于a0的case标签");
+    for (I = 0; I < NCase; I++) {
+      Node *N = Cases[I];
       // 常规case，case范围前后一致
       if (N->Begin == N->End) {
         printLn("  li t0, %ld", N->Begin);
@@ -2023,9 +2888,11 @@ static void genStmt(Node *Nd) {
     printLn("# switch的break标签，结束switch");
     printLn("%s:", Nd->BrkLabel);
     return;
+  }
   case ND_CASE:
     printLn("# case标签，值为%ld", Nd->Val);
     printLn("%s:", Nd->Label);
+    genProfInc(Nd->ProfIdx);
     genStmt(Nd->LHS);
     return;
   // 生成代码块，遍历代码块的语句链表
@@ -2052,14 +2919,23 @@ static void genStmt(Node *Nd) {
     printLn("# 返回语句");
     // 不为空返回语句时
     if (Nd->LHS) {
-      genExpr(Nd->LHS);
-
-      Type *Ty = Nd->LHS->Ty;
+      Node *Exp = Nd->LHS;
+      Obj *Ptr = retBufferPtr();
+      // 返回值优化，被调用函数直接写入当前函数的返回缓冲区
+      if (Ptr && Exp->Kind == ND_FUNCALL && Exp->RetBuffer)
+        Exp->RetBuffer = Ptr;
+      genExpr(Exp);
+
+      Type *Ty = Exp->Ty;
       // 处理结构体作为返回值的情况
       if (Ty->Kind == TY_STRUCT || Ty->Kind == TY_UNION) {
         if (Ty->Size <= 16)
           // 小于16字节拷贝寄存器
           copyStructReg();
+        else if ((Exp->Kind == ND_VAR && Exp->Var == CurrentFn->RetVar) ||
+                 (Exp->Kind == ND_FUNCALL && Exp->RetBuffer == Ptr))
+          // 值已经位于返回缓冲区中，a0为缓冲区的地址
+          printLn("  # 返回值已位于返回缓冲区中");
         else
           // 大于16字节拷贝内存
           copyStructMem();
@@ -2238,6 +3114,168 @@ static int simpleLog2(int Num) {
   return E;
 }
 
+// 判断变量的初始值是否全部为零
+static bool isZeroInit(Obj *Var) {
+  if (Var->Rel)
+    return false;
+  for (int I = 0; I < Var->Ty->Size; I++)
+    if (Var->InitData[I])
+      return false;
+  return true;
+}
+
+// 计算从Pos开始，到End为止的连续零字节数
+static int zeroRun(char *Buf, int Pos, int End) {
+  int I = Pos;
+  while (I < End && Buf[I] == 0)
+    I++;
+  return I - Pos;
+}
+
+// 判断字符是否可以在字符串指示中输出
+static bool isStrChar(char C) {
+  return isprint(C) || C == '\n' || C == '\t' || C == '\r';
+}
+
+// 计算从Pos开始，到End为止的连续可输出为字符串的字符数
+static int printableRun(char *Buf, int Pos, int End) {
+  int I = Pos;
+  while (I < End && isStrChar(Buf[I]))
+    I++;
+  return I - Pos;
+}
+
+// 输出字符串，包括转义字符
+static void emitString(char *Directive, char *Buf, int Len) {
+  char *Str;
+  size_t StrLen;
+  FILE *Out = open_memstream(&Str, &StrLen);
+  for (int I = 0; I < Len; I++) {
+    switch (Buf[I]) {
+    case '\n':
+      fprintf(Out, "\\n");
+      break;
+    case '\t':
+      fprintf(Out, "\\t");
+      break;
+    case '\r':
+      fprintf(Out, "\\r");
+      break;
+    case '"':
+    case '\\':
+      fputc('\\', Out);
+      // fallthrough
+    default:
+      fputc(Buf[I], Out);
+    }
+  }
+  fclose(Out);
+  printLn("  %s \"%s\"", Directive, Str);
+  free(Str);
+}
+
+// 输出全局变量的初始值
+// 连续的零使用.zero，可打印字符串使用.ascii或.string，
+// 其余数据按照对齐使用.dword、.word、.half和.byte
+static void emitInitData(Obj *Var) {
+  char *Buf = Var->InitData;
+  int Size = Var->Ty->Size;
+  // 字符数组以字符串的形式输出
+  bool IsStr = Var->Ty->Kind == TY_ARRAY && Var->Ty->Base->Size == 1;
+  Relocation *Rel = Var->Rel;
+  int Pos = 0;
+
+  while (Pos < Size) {
+    if (Rel && Rel->Offset == Pos) {
+      // 使用其他变量进行初始化
+      printLn("  # %s全局变量", Var->Name);
+      printLn("  .quad %s%+ld", *Rel->Label, Rel->Addend);
+      Rel = Rel->Next;
+      Pos += 8;
+      continue;
+    }
+
+    // 不能越过下一个重定位的位置
+    int End = Rel ? Rel->Offset : Size;
+
+    // 连续的零
+    int Zeros = zeroRun(Buf, Pos, End);
+    if (Zeros >= 8 || Zeros == End - Pos) {
+      printLn("  .zero %d", Zeros);
+      Pos += Zeros;
+      continue;
+    }
+
+    // 可打印的字符串，如果以'\0'结尾，则使用.string
+    int Len = printableRun(Buf, Pos, End);
+    if (Len >= 4 || (IsStr && Len > 0)) {
+      if (Pos + Len < End && Buf[Pos + Len] == 0) {
+        emitString(".string", Buf + Pos, Len);
+        Pos += Len + 1;
+      } else {
+        emitString(".ascii", Buf + Pos, Len);
+        Pos += Len;
+      }
+      continue;
+    }
+
+    // 按照对齐，选取最大的数据单元
+    int Sz = 8;
+    while (Pos % Sz != 0 || Pos + Sz > End)
+      Sz /= 2;
+
+    uint64_t Val = 0;
+    for (int I = Sz - 1; I >= 0; I--)
+      Val = (Val << 8) | (unsigned char)Buf[Pos + I];
+
+    char *Directive[] = {[1] = "byte", [2] = "half", [4] = "word",
+                         [8] = "dword"};
+    printLn("  .%s 0x%lx", Directive[Sz], Val);
+    Pos += Sz;
+  }
+}
+
+// 判断类型是否为const的，数组判断其元素类型
+static bool isConstType(Type *Ty) {
+  while (Ty->Kind == TY_ARRAY)
+    Ty = Ty->Base;
+  return Ty->IsConst && !Ty->IsVolatile;
+}
+
+// 判断全局变量是否可以放入只读段中
+static bool isReadOnly(Obj *Var) {
+  return !Var->IsTLS && (Var->IsStrLit || isConstType(Var->Ty));
+}
+
+// 判断字符串字面量是否可以放入可合并的字符串段中
+// 要求只在末尾存在一个空字符
+static bool isMergeableStr(Obj *Var) {
+  if (!Var->IsStrLit || Var->Rel)
+    return false;
+
+  int Sz = Var->Ty->Base->Size;
+  int Len = Var->Ty->Size / Sz;
+  for (int I = 0; I < Len; I++) {
+    bool IsNull = true;
+    for (int J = 0; J < Sz; J++)
+      if (Var->InitData[I * Sz + J])
+        IsNull = false;
+    // 空字符必须且只能在末尾
+    if (IsNull != (I == Len - 1))
+      return false;
+  }
+  return true;
+}
+
+// 输出全局变量所在的段
+// -fdata-sections时，每个变量放入单独的段中，以便链接器回收
+static void emitDataSection(Obj *Var, char *Sec, char *Flags, char *Type) {
+  if (OptFDataSections)
+    printLn("  .section %s.%s,\"%s\",@%s", Sec, Var->Name, Flags, Type);
+  else
+    printLn("  .section %s,\"%s\",@%s", Sec, Flags, Type);
+}
+
 static void emitData(Obj *Prog) {
   for (Obj *Var = Prog; Var; Var = Var->Next) {
     // 跳过是函数或者无定义的变量
@@ -2251,6 +3289,8 @@ static void emitData(Obj *Prog) {
       printLn("\n  # 全局变量%s", Var->Name);
       printLn("  .globl %s", Var->Name);
     }
+    if (Var->Visibility)
+      printLn("  .%s %s", Var->Visibility, Var->Name);
 
     printLn("  # 对齐全局变量");
     if (!Var->Align)
@@ -2266,43 +3306,48 @@ static void emitData(Obj *Prog) {
       continue;
     }
 
-    // 判断是否有初始值
-    // .data 或 .tdata 段
-    if (Var->InitData) {
+    // 判断是否有非零的初始值，全部为零的变量放入bss段
+    // 只读的变量始终放入只读段
+    // .data 或 .tdata 或 .rodata 段
+    if (Var->InitData && (!isZeroInit(Var) || isReadOnly(Var))) {
       if (Var->IsTLS) {
         printLn("\n  # TLS数据段标签");
         // a：可加载执行
         // w：可写
         // T：线程局部的
         // progbits：包含程序数据
-        printLn("  .section .tdata,\"awT\",@progbits");
+        emitDataSection(Var, ".tdata", "awT", "progbits");
+      } else if (isMergeableStr(Var)) {
+        // 字符串字面量放入可合并的字符串段，由链接器进行合并
+        // M：可合并的
+        // S：包含以空字符结尾的字符串
+        int Sz = Var->Ty->Base->Size;
+        printLn("\n  # 字符串字面量段标签");
+        printLn("  .section .rodata.str%d.%d,\"aMS\",@progbits,%d", Sz, Sz,
+                Sz);
+        Align = Sz;
+      } else if (isReadOnly(Var)) {
+        // 位置无关代码中，含有重定位的只读数据需要在加载时被修改
+        if (OptFPIC && Var->Rel) {
+          printLn("\n  # 重定位后只读的数据段标签");
+          emitDataSection(Var, ".data.rel.ro", "aw", "progbits");
+        } else {
+          printLn("\n  # 只读数据段标签");
+          emitDataSection(Var, ".rodata", "a", "progbits");
+        }
+      } else if (isSmallData(Var)) {
+        printLn("\n  # 小数据段标签");
+        emitDataSection(Var, ".sdata", "aw", "progbits");
       } else {
         printLn("\n  # 数据段标签");
-        printLn("  .data");
+        emitDataSection(Var, ".data", "aw", "progbits");
       }
 
       printLn("  .type %s, @object", Var->Name);
       printLn("  .size %s, %d", Var->Name, Var->Ty->Size);
       printLn("  .align %d", simpleLog2(Align));
       printLn("%s:", Var->Name);
-      Relocation *Rel = Var->Rel;
-      int Pos = 0;
-      while (Pos < Var->Ty->Size) {
-        if (Rel && Rel->Offset == Pos) {
-          // 使用其他变量进行初始化
-          printLn("  # %s全局变量", Var->Name);
-          printLn("  .quad %s%+ld", *Rel->Label, Rel->Addend);
-          Rel = Rel->Next;
-          Pos += 8;
-        } else {
-          // 打印出字符串的内容，包括转义字符
-          char C = Var->InitData[Pos++];
-          if (isprint(C))
-            printLn("  .byte %d\t# 字符：%c", C, C);
-          else
-            printLn("  .byte %d", C);
-        }
-      }
+      emitInitData(Var);
       continue;
     }
 
@@ -2311,12 +3356,17 @@ static void emitData(Obj *Prog) {
     if (Var->IsTLS) {
       // nobits：不含数据
       printLn("\n  # TLS未初始化的全局变量");
-      printLn("  .section .tbss,\"awT\",@nobits");
+      emitDataSection(Var, ".tbss", "awT", "nobits");
+    } else if (isSmallData(Var)) {
+      printLn("\n  # 小数据段未初始化的全局变量");
+      emitDataSection(Var, ".sbss", "aw", "nobits");
     } else {
       printLn("\n  # 未初始化的全局变量");
-      printLn("  .bss");
+      emitDataSection(Var, ".bss", "aw", "nobits");
     }
 
+    printLn("  .type %s, @object", Var->Name);
+    printLn("  .size %s, %d", Var->Name, Var->Ty->Size);
     printLn("  .align %d", simpleLog2(Align));
     printLn("%s:", Var->Name);
     printLn("  # 全局变量零填充%d字节", Var->Ty->Size);
@@ -2377,6 +3427,33 @@ static void storeStruct(int Reg, int Offset, int Size) {
   return;
 }
 
+// 生成函数插桩的调用，参数为当前函数的地址和调用点
+static void genInstrumentCall(Obj *Fn, char *Hook) {
+  Node Nd = {.Kind = ND_VAR, .Var = Fn, .Ty = Fn->Ty};
+  printLn("  # 调用插桩函数%s", Hook);
+  genAddr(&Nd);
+  printLn("  ld a1, 8(fp)");
+  printLn("  call %s@plt", Hook);
+}
+
+// 输出函数所在的段
+// -ffunction-sections时，每个函数放入单独的段中，以便链接器回收
+// 冷热函数分别放在一起，使热代码更加紧凑
+static void emitTextSection(Obj *Fn) {
+  // 冷函数放入.text.unlikely段，热函数放入.text.hot段
+  char *Sec = Fn->IsCold ? ".text.unlikely" : Fn->IsHot ? ".text.hot" : NULL;
+
+  if (OptFFunctionSections)
+    printLn("  .section %s.%s,\"ax\",@progbits", Sec ? Sec : ".text",
+            Fn->Name);
+  else if (Sec)
+    printLn("  .section %s,\"ax\",@progbits", Sec);
+  else
+    printLn("  .text");
+  // 指令按4字节对齐
+  printLn("  .align 2");
+}
+
 // 代码生成入口函数，包含代码块的基础信息
 void emitText(Obj *Prog) {
   // 为每个函数单独生成代码
@@ -2388,6 +3465,8 @@ void emitText(Obj *Prog) {
     if (!Fn->IsLive)
       continue;
 
+    int64_t Start = OptFTrace ? nowNs() : 0;
+
     if (Fn->IsStatic) {
       printLn("\n  # 定义局部%s函数", Fn->Name);
       printLn("  .local %s", Fn->Name);
@@ -2395,15 +3474,22 @@ void emitText(Obj *Prog) {
       printLn("\n  # 定义全局%s函数", Fn->Name);
       printLn("  .globl %s", Fn->Name);
     }
+    if (Fn->Visibility)
+      printLn("  .%s %s", Fn->Visibility, Fn->Name);
 
     printLn("  # 代码段标签");
-    printLn("  .text");
+    emitTextSection(Fn);
     printLn("# =====%s段开始===============", Fn->Name);
     printLn("# %s段标签", Fn->Name);
     printLn("  .type %s, @function", Fn->Name);
     printLn("%s:", Fn->Name);
     CurrentFn = Fn;
 
+    // 函数入口的剖析计数器，编号为0
+    ProfBase = ProfKeys.Len;
+    ProfCnt = 0;
+    int EntryIdx = newProfCounter();
+
     // 栈布局
     // ------------------------------//
     //        上一级函数的栈传递参数
@@ -2617,8 +3703,22 @@ void emitText(Obj *Prog) {
 
     // 生成语句链表的代码
     printLn("# =====%s段主体===============", Fn->Name);
+    genProfInc(EntryIdx);
+
+    // 函数入口的插桩，-pg调用_mcount，参数为调用者的返回地址
+    if (OptPG && !Fn->IsNoInstr) {
+      printLn("  # 调用_mcount");
+      printLn("  ld a0, 8(fp)");
+      printLn("  call _mcount@plt");
+    }
+    if (OptFInstrumentFunctions && !Fn->IsNoInstr)
+      genInstrumentCall(Fn, "__cyg_profile_func_enter");
+
+    MaxDepth = MaxRegTop = 0;
     genStmt(Fn->Body);
-    assert(Depth == 0);
+    assert(Depth == 0 && RegTop == 0);
+    printLn("  # %s的表达式栈最大深度为%d，寄存器池最多使用%d个寄存器",
+            Fn->Name, MaxDepth, MaxRegTop);
 
     // main默认返回0
     if (strcmp(Fn->Name, "main") == 0)
@@ -2630,6 +3730,23 @@ void emitText(Obj *Prog) {
     printLn("# return段标签");
     printLn(".L.return.%s:", Fn->Name);
 
+    // 函数出口的插桩，需要保留返回值所在的寄存器
+    if (OptFInstrumentFunctions && !Fn->IsNoInstr) {
+      printLn("  # 保存返回值寄存器");
+      printLn("  addi sp, sp, -32");
+      printLn("  sd a0, 0(sp)");
+      printLn("  sd a1, 8(sp)");
+      printLn("  fsd fa0, 16(sp)");
+      printLn("  fsd fa1, 24(sp)");
+      genInstrumentCall(Fn, "__cyg_profile_func_exit");
+      printLn("  # 恢复返回值寄存器");
+      printLn("  ld a0, 0(sp)");
+      printLn("  ld a1, 8(sp)");
+      printLn("  fld fa0, 16(sp)");
+      printLn("  fld fa1, 24(sp)");
+      printLn("  addi sp, sp, 32");
+    }
+
     printLn("  # 恢复所有的fs0~fs11寄存器");
     for (int I = 0; I <= 11; ++I)
         printLn("  fsgnj.d fs%d, ft%d, ft%d", I, I, I);
@@ -2654,11 +3771,161 @@ void emitText(Obj *Prog) {
     // 返回
     printLn("  # 返回a0值给系统调用");
     printLn("  ret");
+
+    // 输出冷代码块
+    for (int I = 0; I < ColdBlocks.Len; I++) {
+      if (OutputFile)
+        fputs(ColdBlocks.Data[I], OutputFile);
+      else
+        asmText(ColdBlocks.Data[I]);
+    }
+    ColdBlocks.Len = 0;
+
+    if (OptFTrace)
+      traceSpan("codegen", Fn->Name, Start, nowNs());
+  }
+}
+
+// 输出浮点常量池，放入可合并的只读段中
+static void emitFloConsts(void) {
+  for (int Size = 8; Size >= 4; Size /= 2) {
+    bool First = true;
+    for (FloConst *FC = FloConsts; FC; FC = FC->Next) {
+      if (FC->Size != Size)
+        continue;
+      if (First) {
+        printLn("\n  # 浮点常量池");
+        printLn("  .section .rodata.cst%d,\"aM\",@progbits,%d", Size, Size);
+        printLn("  .align %d", simpleLog2(Size));
+        First = false;
+      }
+      printLn("%s:", FC->Label);
+      if (Size == 4)
+        printLn("  .word 0x%08lx", FC->Bits);
+      else
+        printLn("  .dword 0x%016lx", FC->Bits);
+    }
+  }
+}
+
+// 读入-fprofile-use的剖析数据，每行为"函数名:编号 计数"
+// 剖析数据文件不存在时，正常进行编译
+static void readProfile(void) {
+  FILE *In = fopen(OptFProfileUse, "r");
+  if (!In)
+    return;
+
+  char Key[4096];
+  long Cnt;
+  while (fscanf(In, "%4095s %ld", Key, &Cnt) == 2) {
+    long *Val = allocMem(MEM_OTHER, sizeof(long));
+    *Val = Cnt;
+    hashmapPut(&ProfData, strdup(Key), Val);
+
+    // 记录函数入口计数的最大值
+    char *Idx = strrchr(Key, ':');
+    if (Idx && !strcmp(Idx, ":0"))
+      ProfMaxEntry = MAX(ProfMaxEntry, Cnt);
+  }
+  fclose(In);
+}
+
+// 根据剖析数据标记冷热函数
+// 从未被调用的函数为冷函数，调用次数达到最多者十分之一的为热函数
+static void applyProfile(Obj *Prog) {
+  for (Obj *Fn = Prog; Fn; Fn = Fn->Next) {
+    if (!Fn->IsFunction || !Fn->IsDefinition || Fn->IsHot || Fn->IsCold)
+      continue;
+
+    long Cnt = profCount(Fn->Name, 0);
+    if (Cnt == 0)
+      Fn->IsCold = true;
+    else if (Cnt > 0 && Cnt * 10 >= ProfMaxEntry)
+      Fn->IsHot = true;
+  }
+}
+
+// 输出-fprofile-generate的剖析计数器，及程序退出时写出剖析数据的函数
+static void emitProfile(void) {
+  if (!OptFProfileGenerate || ProfKeys.Len == 0)
+    return;
+
+  printLn("\n  # 剖析计数器");
+  printLn("  .bss");
+  printLn("  .align 3");
+  printLn(".L.prof.counts:");
+  printLn("  .zero %d", ProfKeys.Len * 8);
+
+  printLn("\n  # 剖析计数器的键，以及写出剖析数据所用的字符串");
+  printLn("  .section .rodata");
+  for (int I = 0; I < ProfKeys.Len; I++) {
+    printLn(".L.prof.key.%d:", I);
+    emitString(".string", ProfKeys.Data[I], strlen(ProfKeys.Data[I]));
   }
+  printLn(".L.prof.path:");
+  emitString(".string", OptFProfileGenerate, strlen(OptFProfileGenerate));
+  printLn(".L.prof.mode:");
+  printLn("  .string \"w\"");
+  printLn(".L.prof.fmt:");
+  printLn("  .string \"%%s %%ld\\n\"");
+
+  // 键的地址表需要重定位，PIC时放入.data.rel.ro段
+  printLn("\n  # 剖析计数器的键的地址表");
+  if (OptFPIC)
+    printLn("  .section .data.rel.ro,\"aw\",@progbits");
+  printLn("  .align 3");
+  printLn(".L.prof.keys:");
+  for (int I = 0; I < ProfKeys.Len; I++)
+    printLn("  .quad .L.prof.key.%d", I);
+
+  // 写出剖析数据的函数只在程序退出时执行一次，放入冷代码段
+  printLn("\n  # 写出剖析数据的函数");
+  printLn("  .section .text.unlikely,\"ax\",@progbits");
+  printLn("  .align 2");
+  printLn(".L.prof.dump:");
+  printLn("  addi sp, sp, -32");
+  printLn("  sd ra, 24(sp)");
+  printLn("  sd s1, 16(sp)");
+  printLn("  sd s2, 8(sp)");
+  printLn("  # 打开剖析数据文件");
+  printLn("  lla a0, .L.prof.path");
+  printLn("  lla a1, .L.prof.mode");
+  printLn("  call fopen@plt");
+  printLn("  beqz a0, .L.prof.dump.end");
+  printLn("  mv s1, a0");
+  printLn("  # 遍历计数器，逐行写出键和计数");
+  printLn("  li s2, 0");
+  printLn(".L.prof.dump.loop:");
+  printLn("  slli t1, s2, 3");
+  printLn("  lla t0, .L.prof.keys");
+  printLn("  add t0, t0, t1");
+  printLn("  ld a2, 0(t0)");
+  printLn("  lla t0, .L.prof.counts");
+  printLn("  add t0, t0, t1");
+  printLn("  ld a3, 0(t0)");
+  printLn("  mv a0, s1");
+  printLn("  lla a1, .L.prof.fmt");
+  printLn("  call fprintf@plt");
+  printLn("  addi s2, s2, 1");
+  printLn("  li t0, %d", ProfKeys.Len);
+  printLn("  blt s2, t0, .L.prof.dump.loop");
+  printLn("  mv a0, s1");
+  printLn("  call fclose@plt");
+  printLn(".L.prof.dump.end:");
+  printLn("  ld ra, 24(sp)");
+  printLn("  ld s1, 16(sp)");
+  printLn("  ld s2, 8(sp)");
+  printLn("  addi sp, sp, 32");
+  printLn("  ret");
+
+  printLn("\n  # 程序退出时写出剖析数据");
+  printLn("  .section .fini_array,\"aw\",@fini_array");
+  printLn("  .align 3");
+  printLn("  .quad .L.prof.dump");
 }
 
 void codegen(Obj *Prog, FILE *Out) {
-  // 设置目标文件的文件流指针
+  // 设置目标文件的文件流指针，为空时直接交给集成汇编器
   OutputFile = Out;
 
   // 获取所有的输入文件，并输出.file指示
@@ -2666,10 +3933,20 @@ void codegen(Obj *Prog, FILE *Out) {
   for (int I = 0; Files[I]; I++)
     printLn("  .file %d \"%s\"", Files[I]->FileNo, Files[I]->Name);
 
+  // 读入剖析数据，标记冷热函数
+  if (OptFProfileUse) {
+    readProfile();
+    applyProfile(Prog);
+  }
+
   // 计算局部变量的偏移量
   assignLVarOffsets(Prog);
   // 生成数据
   emitData(Prog);
   // 生成代码
   emitText(Prog);
+  // 生成浮点常量池
+  emitFloConsts();
+  // 生成剖析计数器
+  emitProfile();
 }
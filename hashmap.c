@@ -54,7 +54,7 @@ static void rehash(HashMap *Map) {
   // 定义一个新的哈希表Map2，并拷贝所有的键值对
   HashMap Map2 = {};
   // 为Map2分配足够的内存来存储Cap个桶
-  Map2.Buckets = calloc(Cap, sizeof(HashEntry));
+  Map2.Buckets = allocMem(MEM_OTHER, Cap * sizeof(HashEntry));
   // 设置Map2的容量为Cap
   Map2.Capacity = Cap;
 
@@ -110,7 +110,7 @@ static HashEntry *getEntry(HashMap *Map, char *Key, int KeyLen) {
 static HashEntry *getOrInsertEntry(HashMap *Map, char *Key, int KeyLen) {
   if (!Map->Buckets) {
     // 如果哈希表没有初始化，则初始化INIT_SIZE个
-    Map->Buckets = calloc(INIT_SIZE, sizeof(HashEntry));
+    Map->Buckets = allocMem(MEM_OTHER, INIT_SIZE * sizeof(HashEntry));
     Map->Capacity = INIT_SIZE;
   } else if ((Map->Used * 100) / Map->Capacity >= HIGH_WATERMARK) {
     // 如果哈希表使用量超过了HIGH_WATERMARK，则重新进行哈希计算
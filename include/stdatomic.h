@@ -24,42 +24,65 @@ typedef enum {
 #define ATOMIC_FLAG_INIT(x) (x)
 #define atomic_init(addr, val) (*(addr) = (val))
 #define kill_dependency(x) (x)
-#define atomic_thread_fence(order)
-#define atomic_signal_fence(order)
-#define atomic_is_lock_free(x) 1
+#define atomic_thread_fence(order) __atomic_thread_fence(order)
+#define atomic_signal_fence(order) __atomic_signal_fence(order)
+#define atomic_is_lock_free(x) __atomic_is_lock_free(sizeof(*(x)), (x))
 
-#define atomic_load(addr) (*(addr))
-#define atomic_store(addr, val) (*(addr) = (val))
+#define atomic_load(addr) __atomic_load_n((addr), __ATOMIC_SEQ_CST)
+#define atomic_store(addr, val)                                                \
+  __atomic_store_n((addr), (val), __ATOMIC_SEQ_CST)
 
-#define atomic_load_explicit(addr, order) (*(addr))
-#define atomic_store_explicit(addr, val, order) (*(addr) = (val))
+#define atomic_load_explicit(addr, order) __atomic_load_n((addr), (order))
+#define atomic_store_explicit(addr, val, order)                                \
+  __atomic_store_n((addr), (val), (order))
 
-#define atomic_fetch_add(obj, val) (*(obj) += (val))
-#define atomic_fetch_sub(obj, val) (*(obj) -= (val))
-#define atomic_fetch_or(obj, val) (*(obj) |= (val))
-#define atomic_fetch_xor(obj, val) (*(obj) ^= (val))
-#define atomic_fetch_and(obj, val) (*(obj) &= (val))
+#define atomic_fetch_add(obj, val)                                             \
+  __atomic_fetch_add((obj), (val), __ATOMIC_SEQ_CST)
+#define atomic_fetch_sub(obj, val)                                             \
+  __atomic_fetch_sub((obj), (val), __ATOMIC_SEQ_CST)
+#define atomic_fetch_or(obj, val)                                              \
+  __atomic_fetch_or((obj), (val), __ATOMIC_SEQ_CST)
+#define atomic_fetch_xor(obj, val)                                             \
+  __atomic_fetch_xor((obj), (val), __ATOMIC_SEQ_CST)
+#define atomic_fetch_and(obj, val)                                             \
+  __atomic_fetch_and((obj), (val), __ATOMIC_SEQ_CST)
 
-#define atomic_fetch_add_explicit(obj, val, order) (*(obj) += (val))
-#define atomic_fetch_sub_explicit(obj, val, order) (*(obj) -= (val))
-#define atomic_fetch_or_explicit(obj, val, order) (*(obj) |= (val))
-#define atomic_fetch_xor_explicit(obj, val, order) (*(obj) ^= (val))
-#define atomic_fetch_and_explicit(obj, val, order) (*(obj) &= (val))
+#define atomic_fetch_add_explicit(obj, val, order)                             \
+  __atomic_fetch_add((obj), (val), (order))
+#define atomic_fetch_sub_explicit(obj, val, order)                             \
+  __atomic_fetch_sub((obj), (val), (order))
+#define atomic_fetch_or_explicit(obj, val, order)                              \
+  __atomic_fetch_or((obj), (val), (order))
+#define atomic_fetch_xor_explicit(obj, val, order)                             \
+  __atomic_fetch_xor((obj), (val), (order))
+#define atomic_fetch_and_explicit(obj, val, order)                             \
+  __atomic_fetch_and((obj), (val), (order))
 
 #define atomic_compare_exchange_weak(p, old, new)                              \
-  __builtin_compare_and_swap((p), (old), (new))
+  __atomic_compare_exchange_n((p), (old), (new), 1, __ATOMIC_SEQ_CST,          \
+                              __ATOMIC_SEQ_CST)
 
 #define atomic_compare_exchange_strong(p, old, new)                            \
-  __builtin_compare_and_swap((p), (old), (new))
+  __atomic_compare_exchange_n((p), (old), (new), 0, __ATOMIC_SEQ_CST,          \
+                              __ATOMIC_SEQ_CST)
 
-#define atomic_exchange(obj, val) __builtin_atomic_exchange((obj), (val))
+#define atomic_compare_exchange_weak_explicit(p, old, new, succ, fail)         \
+  __atomic_compare_exchange_n((p), (old), (new), 1, (succ), (fail))
+
+#define atomic_compare_exchange_strong_explicit(p, old, new, succ, fail)       \
+  __atomic_compare_exchange_n((p), (old), (new), 0, (succ), (fail))
+
+#define atomic_exchange(obj, val)                                              \
+  __atomic_exchange_n((obj), (val), __ATOMIC_SEQ_CST)
 #define atomic_exchange_explicit(obj, val, order)                              \
-  __builtin_atomic_exchange((obj), (val))
+  __atomic_exchange_n((obj), (val), (order))
 
-#define atomic_flag_test_and_set(obj) atomic_exchange((obj), 1)
-#define atomic_flag_test_and_set_explicit(obj, order) atomic_exchange((obj), 1)
-#define atomic_flag_clear(obj) (*(obj) = 0)
-#define atomic_flag_clear_explicit(obj, order) (*(obj) = 0)
+#define atomic_flag_test_and_set(obj)                                          \
+  __atomic_test_and_set((obj), __ATOMIC_SEQ_CST)
+#define atomic_flag_test_and_set_explicit(obj, order)                          \
+  __atomic_test_and_set((obj), (order))
+#define atomic_flag_clear(obj) __atomic_clear((obj), __ATOMIC_SEQ_CST)
+#define atomic_flag_clear_explicit(obj, order) __atomic_clear((obj), (order))
 
 typedef _Atomic _Bool atomic_flag;
 typedef _Atomic _Bool atomic_bool;
@@ -1,4 +1,5 @@
 #include "rvcc.h"
+#include <sys/resource.h>
 
 // 【注意】
 // 如果是交叉编译，请把这个路径改为$RISCV对应的路径
@@ -21,11 +22,39 @@ StringArray IncludePaths;
 bool OptFCommon = true;
 // 位置无关代码的标记
 bool OptFPIC;
+// 通过PLT调用外部函数，-fno-plt时通过GOT调用
+bool OptFPLT = true;
+// 浮点乘加融合的标记，默认与GCC的GNU模式一致
+bool OptFPContract = true;
+// 线程局部存储访问模型，编译器可以选用更高效的模型
+TLSModel OptTLSModel = TLS_GLOBAL_DYNAMIC;
+// 小数据段的大小阈值，-G选项
+int OptG;
+// 每个函数使用单独的段
+bool OptFFunctionSections;
+// 每个全局变量使用单独的段
+bool OptFDataSections;
+// -fprofile-generate的目录，未指定时为空字符串，cc1中替换为剖析数据文件的路径
+char *OptFProfileGenerate;
+// -fprofile-use的目录，未指定时为空字符串，cc1中替换为剖析数据文件的路径
+char *OptFProfileUse;
+// 在函数入口和出口调用__cyg_profile_func_enter/exit
+bool OptFInstrumentFunctions;
+// 在函数入口调用_mcount，-pg选项
+bool OptPG;
+// -ftime-report输出统计的文件，"-"为标准错误
+char *OptFTimeReport;
+// -ftrace输出跟踪事件的文件
+char *OptFTrace;
+// -fmem-report输出内存统计的文件，"-"为标准错误
+char *OptFMemReport;
 
 // -x选项
 static FileType OptX;
 // -include所引入的文件
 static StringArray OptInclude;
+// 是否指定了-ffp-contract
+static bool OptFPContractSet;
 // -E选项
 static bool OptE;
 // -M选项
@@ -54,6 +83,22 @@ static char *OptMF;
 static char *OptMT;
 // 目标文件的路径
 static char *OptO;
+// -j选项，同时运行的编译任务数
+static int OptJobs = 1;
+// -pipe选项
+static bool OptPipe;
+// cc1是否直接将汇编代码写入管道
+static bool StreamOutput;
+// -fintegrated-as选项，使用集成汇编器，默认开启，-fno-integrated-as时使用as
+static bool OptIntegratedAs = true;
+// cc1是否直接输出可重定位文件
+static bool EmitObj;
+// -fcache-dir选项，编译缓存的目录
+static char *OptFCacheDir;
+// -fcache-stats选项，打印编译缓存的统计信息
+static bool OptFCacheStats;
+// 影响编译结果的选项，用于计算编译缓存的键
+static char *CacheOptions;
 
 // 链接器额外参数
 static StringArray LdExtraArgs;
@@ -64,6 +109,8 @@ static StringArray StdIncludePaths;
 char *BaseFile;
 // 输出文件名
 static char *OutputFile;
+// 输出的可重定位文件名，用于命名剖析数据文件，为NULL时使用输入文件名
+static char *ObjFile;
 
 // 输入文件区
 static StringArray InputPaths;
@@ -79,7 +126,7 @@ static void usage(int Status) {
 // 判断需要一个参数的选项，是否具有一个参数
 static bool takeArg(char *Arg) {
   char *X[] = {"-o", "-I",  "-idirafter", "-include",
-               "-x", "-MF", "-MT",        "-Xlinker"};
+               "-x", "-MF", "-MT",        "-Xlinker", "-G"};
 
   for (int I = 0; I < sizeof(X) / sizeof(*X); I++)
     if (!strcmp(Arg, X[I]))
@@ -127,6 +174,15 @@ static FileType parseOptX(char *S) {
   error("<command line>: unknown argument for -x: %s", S);
 }
 
+// 解析小数据段的大小阈值
+static int parseSmallDataLimit(char *S) {
+  char *End;
+  long N = strtol(S, &End, 10);
+  if (*S == '\0' || *End != '\0' || N < 0)
+    error("<command line>: invalid small data limit: %s", S);
+  return N;
+}
+
 // 对Make的目标中的特殊字符进行处理
 static char *quoteMakefile(char *S) {
   // 新字符串，确保即使S的全部字符都处理，加上'\0'也能够存储下
@@ -205,6 +261,29 @@ static void parseArgs(int Argc, char **Argv) {
       continue;
     }
 
+    // 解析-j，未指定任务数时使用所有在线的处理器
+    if (!strcmp(Argv[I], "-j")) {
+      OptJobs = sysconf(_SC_NPROCESSORS_ONLN);
+      if (OptJobs < 1)
+        OptJobs = 1;
+      continue;
+    }
+
+    // 解析-jN
+    if (!strncmp(Argv[I], "-j", 2)) {
+      char *End;
+      OptJobs = strtol(Argv[I] + 2, &End, 10);
+      if (*End || OptJobs < 1)
+        error("<command line>: invalid number of jobs: %s", Argv[I] + 2);
+      continue;
+    }
+
+    // 解析-pipe
+    if (!strcmp(Argv[I], "-pipe")) {
+      OptPipe = true;
+      continue;
+    }
+
     // 解析-S
     if (!strcmp(Argv[I], "-S")) {
       OptS = true;
@@ -223,6 +302,56 @@ static void parseArgs(int Argc, char **Argv) {
       continue;
     }
 
+    // 解析-fcache-dir=DIR
+    if (!strncmp(Argv[I], "-fcache-dir=", 12)) {
+      OptFCacheDir = Argv[I] + 12;
+      continue;
+    }
+
+    // 解析-fcache-stats
+    if (!strcmp(Argv[I], "-fcache-stats")) {
+      OptFCacheStats = true;
+      continue;
+    }
+
+    // 解析-ftime-report[=FILE]
+    if (!strcmp(Argv[I], "-ftime-report")) {
+      OptFTimeReport = "-";
+      continue;
+    }
+    if (!strncmp(Argv[I], "-ftime-report=", 14)) {
+      OptFTimeReport = Argv[I] + 14;
+      continue;
+    }
+
+    // 解析-fmem-report[=FILE]
+    if (!strcmp(Argv[I], "-fmem-report")) {
+      OptFMemReport = "-";
+      continue;
+    }
+    if (!strncmp(Argv[I], "-fmem-report=", 13)) {
+      OptFMemReport = Argv[I] + 13;
+      continue;
+    }
+
+    // 解析-ftrace=FILE
+    if (!strncmp(Argv[I], "-ftrace=", 8)) {
+      OptFTrace = Argv[I] + 8;
+      continue;
+    }
+
+    // 解析-fintegrated-as
+    if (!strcmp(Argv[I], "-fintegrated-as")) {
+      OptIntegratedAs = true;
+      continue;
+    }
+
+    // 解析-fno-integrated-as
+    if (!strcmp(Argv[I], "-fno-integrated-as")) {
+      OptIntegratedAs = false;
+      continue;
+    }
+
     // 解析-c
     if (!strcmp(Argv[I], "-c")) {
       OptC = true;
@@ -361,6 +490,138 @@ static void parseArgs(int Argc, char **Argv) {
       continue;
     }
 
+    // 解析-fno-pic或-fno-PIC
+    if (!strcmp(Argv[I], "-fno-pic") || !strcmp(Argv[I], "-fno-PIC")) {
+      OptFPIC = false;
+      continue;
+    }
+
+    // 解析-fplt和-fno-plt
+    if (!strcmp(Argv[I], "-fplt")) {
+      OptFPLT = true;
+      continue;
+    }
+    if (!strcmp(Argv[I], "-fno-plt")) {
+      OptFPLT = false;
+      continue;
+    }
+
+    // 解析-ffp-contract=
+    // on只在单个表达式内进行融合，与fast的行为一致
+    if (!strncmp(Argv[I], "-ffp-contract=", 14)) {
+      char *Arg = Argv[I] + 14;
+      if (!strcmp(Arg, "fast") || !strcmp(Arg, "on"))
+        OptFPContract = true;
+      else if (!strcmp(Arg, "off"))
+        OptFPContract = false;
+      else
+        error("<command line>: unknown argument for -ffp-contract: %s", Arg);
+      OptFPContractSet = true;
+      continue;
+    }
+
+    // 解析-ftls-model=
+    if (!strncmp(Argv[I], "-ftls-model=", 12)) {
+      char *Arg = Argv[I] + 12;
+      if (!strcmp(Arg, "global-dynamic"))
+        OptTLSModel = TLS_GLOBAL_DYNAMIC;
+      else if (!strcmp(Arg, "local-dynamic"))
+        OptTLSModel = TLS_LOCAL_DYNAMIC;
+      else if (!strcmp(Arg, "initial-exec"))
+        OptTLSModel = TLS_INITIAL_EXEC;
+      else if (!strcmp(Arg, "local-exec"))
+        OptTLSModel = TLS_LOCAL_EXEC;
+      else
+        error("<command line>: unknown TLS model: %s", Arg);
+      continue;
+    }
+
+    // 解析-std=
+    // 与GCC一致，ISO C模式下默认不进行浮点乘加融合
+    if (!strncmp(Argv[I], "-std=", 5)) {
+      if (!OptFPContractSet)
+        OptFPContract = strncmp(Argv[I] + 5, "gnu", 3) == 0;
+      continue;
+    }
+
+    // 解析-G N
+    if (!strcmp(Argv[I], "-G")) {
+      OptG = parseSmallDataLimit(Argv[++I]);
+      continue;
+    }
+
+    // 解析-GN
+    if (!strncmp(Argv[I], "-G", 2)) {
+      OptG = parseSmallDataLimit(Argv[I] + 2);
+      continue;
+    }
+
+    // 解析-msmall-data-limit=N，与-G相同
+    if (!strncmp(Argv[I], "-msmall-data-limit=", 19)) {
+      OptG = parseSmallDataLimit(Argv[I] + 19);
+      continue;
+    }
+
+    // 解析-ffunction-sections
+    if (!strcmp(Argv[I], "-ffunction-sections")) {
+      OptFFunctionSections = true;
+      continue;
+    }
+
+    // 解析-fno-function-sections
+    if (!strcmp(Argv[I], "-fno-function-sections")) {
+      OptFFunctionSections = false;
+      continue;
+    }
+
+    // 解析-fdata-sections
+    if (!strcmp(Argv[I], "-fdata-sections")) {
+      OptFDataSections = true;
+      continue;
+    }
+
+    // 解析-fno-data-sections
+    if (!strcmp(Argv[I], "-fno-data-sections")) {
+      OptFDataSections = false;
+      continue;
+    }
+
+    // 解析-fprofile-generate
+    if (!strcmp(Argv[I], "-fprofile-generate")) {
+      OptFProfileGenerate = "";
+      continue;
+    }
+
+    // 解析-fprofile-generate=
+    if (!strncmp(Argv[I], "-fprofile-generate=", 19)) {
+      OptFProfileGenerate = Argv[I] + 19;
+      continue;
+    }
+
+    // 解析-fprofile-use
+    if (!strcmp(Argv[I], "-fprofile-use")) {
+      OptFProfileUse = "";
+      continue;
+    }
+
+    // 解析-fprofile-use=
+    if (!strncmp(Argv[I], "-fprofile-use=", 14)) {
+      OptFProfileUse = Argv[I] + 14;
+      continue;
+    }
+
+    // 解析-finstrument-functions
+    if (!strcmp(Argv[I], "-finstrument-functions")) {
+      OptFInstrumentFunctions = true;
+      continue;
+    }
+
+    // 解析-pg
+    if (!strcmp(Argv[I], "-pg")) {
+      OptPG = true;
+      continue;
+    }
+
     // 解析-cc1-input
     if (!strcmp(Argv[I], "-cc1-input")) {
       BaseFile = Argv[++I];
@@ -373,6 +634,12 @@ static void parseArgs(int Argc, char **Argv) {
       continue;
     }
 
+    // 解析-cc1-emit-obj
+    if (!strcmp(Argv[I], "-cc1-emit-obj")) {
+      EmitObj = true;
+      continue;
+    }
+
     // 解析-idirafter
     // 将参数存入Idirafter
     if (!strcmp(Argv[I], "-idirafter")) {
@@ -416,7 +683,7 @@ static void parseArgs(int Argc, char **Argv) {
 
     // 忽略多个选项
     if (!strncmp(Argv[I], "-O", 2) || !strncmp(Argv[I], "-W", 2) ||
-        !strncmp(Argv[I], "-g", 2) || !strncmp(Argv[I], "-std=", 5) ||
+        !strncmp(Argv[I], "-g", 2) ||
         !strcmp(Argv[I], "-ffreestanding") ||
         !strcmp(Argv[I], "-fno-builtin") ||
         !strcmp(Argv[I], "-fno-omit-frame-pointer") ||
@@ -438,13 +705,24 @@ static void parseArgs(int Argc, char **Argv) {
   for (int I = 0; I < Idirafter.Len; I++)
     strArrayPush(&IncludePaths, Idirafter.Data[I]);
 
-  // 不存在输入文件时报错
-  if (InputPaths.Len == 0)
+  // -fcache-stats需要指定缓存目录
+  if (OptFCacheStats && !OptFCacheDir)
+    error("-fcache-stats requires -fcache-dir");
+
+  // 不存在输入文件时报错，只打印编译缓存的统计信息时除外
+  if (InputPaths.Len == 0 && !OptFCacheStats)
     error("no input files");
 
   // -E隐式包含输入是C语言的宏
   if (OptE)
     OptX = FILE_C;
+
+  // 静态链接时所有符号都在可执行文件中
+  // 不需要位置无关代码，函数调用不经过PLT，线程局部变量使用local-exec
+  if (OptStatic) {
+    OptFPIC = false;
+    OptTLSModel = TLS_LOCAL_EXEC;
+  }
 }
 
 // 打开需要写入的文件
@@ -480,11 +758,34 @@ static char *replaceExtn(char *Tmpl, char *Extn) {
   return format("%s%s", Filename, Extn);
 }
 
+// 剖析数据文件的路径，Dir为-fprofile-generate或-fprofile-use指定的目录
+// 与-MD的.d文件相同，以输出的可重定位文件命名，替换后缀名为.prof；
+// 链接时可重定位文件为临时文件，此时以输入文件命名。
+// 未指定目录时位于可重定位文件所在的目录，指定目录时将路径中的'/'替换为'#'，
+// 不同目录中的同名文件不会互相覆盖
+static char *profilePath(char *Dir) {
+  char *Path = strdup(ObjFile ? ObjFile : BaseFile);
+  // 去除后缀名，不包括目录名中的'.'
+  char *Dot = strrchr(Path, '.');
+  if (Dot && !strchr(Dot, '/'))
+    *Dot = '\0';
+
+  if (!*Dir)
+    return format("%s.prof", Path);
+  for (char *P = Path; *P; P++)
+    if (*P == '/')
+      *P = '#';
+  return format("%s/%s.prof", Dir, Path);
+}
+
 // 清理临时文件区
 static void cleanup(void) {
   // 遍历删除临时文件
   for (int I = 0; I < TmpFiles.Len; I++)
     unlink(TmpFiles.Data[I]);
+  // 写入跟踪文件的结尾
+  if (OptFTrace)
+    endTrace();
 }
 
 // 创建临时文件
@@ -504,23 +805,105 @@ static char *createTmpFile(void) {
   return Path;
 }
 
-// 开辟子进程
-static void runSubprocess(char **Argv) {
-  // 打印出子进程所有的命令行参数
-  if (OptHashHashHash) {
-    // 程序名
-    fprintf(stderr, "%s", Argv[0]);
-    // 程序参数
-    for (int I = 1; Argv[I]; I++)
-      fprintf(stderr, " %s", Argv[I]);
-    // 换行
-    fprintf(stderr, "\n");
+// 打印出子进程所有的命令行参数
+static void printCommand(char **Argv) {
+  // 程序名
+  fprintf(stderr, "%s", Argv[0]);
+  // 程序参数
+  for (int I = 1; Argv[I]; I++)
+    fprintf(stderr, " %s", Argv[I]);
+  // 换行
+  fprintf(stderr, "\n");
+}
+
+// -ftime-report和-ftrace记录的子进程
+typedef struct Subprocess Subprocess;
+struct Subprocess {
+  Subprocess *Next; // 下一个子进程
+  pid_t Pid;        // 进程号
+  char *Name;       // 程序名
+  char *File;       // 处理的文件
+  int64_t Start;    // 开始的时间
+};
+
+static Subprocess *Subprocesses;
+
+// 记录开始运行的子进程，Start为fork之前的时间
+static void trackSubprocess(pid_t Pid, char *Name, char *File, int64_t Start) {
+  if (!OptFTimeReport && !OptFTrace)
+    return;
+  Subprocess *S = calloc(1, sizeof(Subprocess));
+  S->Pid = Pid;
+  S->Name = Name;
+  S->File = File;
+  S->Start = Start;
+  S->Next = Subprocesses;
+  Subprocesses = S;
+}
+
+// 将timeval转换为纳秒
+static int64_t timevalNs(struct timeval TV) {
+  return TV.tv_sec * 1000000000LL + TV.tv_usec * 1000LL;
+}
+
+// 等待指定的子进程结束，返回其退出状态
+// 被记录的子进程结束时，输出其墙钟时间和CPU时间，以及跟踪的区间
+static int waitPid(pid_t Pid) {
+  struct rusage Before, After;
+  if (OptFTimeReport)
+    getrusage(RUSAGE_CHILDREN, &Before);
+
+  int Status;
+  while (waitpid(Pid, &Status, 0) == -1)
+    if (errno != EINTR)
+      error("waitpid failed: %s", strerror(errno));
+
+  for (Subprocess **Cur = &Subprocesses; *Cur; Cur = &(*Cur)->Next) {
+    Subprocess *S = *Cur;
+    if (S->Pid != Pid)
+      continue;
+    // 两次getrusage之间只回收了这一个子进程，其差值即为该子进程所用的时间
+    getrusage(RUSAGE_CHILDREN, &After);
+    int64_t User = timevalNs(After.ru_utime) - timevalNs(Before.ru_utime);
+    int64_t Sys = timevalNs(After.ru_stime) - timevalNs(Before.ru_stime);
+    if (OptFTimeReport)
+      timeReportSubprocess(S->Name, S->File,
+                           WIFEXITED(Status) ? WEXITSTATUS(Status) : -1,
+                           nowNs() - S->Start, User, Sys);
+    if (OptFTrace) {
+      traceSubprocess(Pid, "subprocess", format("%s %s", S->Name, S->File),
+                      S->Start, nowNs());
+      flushTrace();
+    }
+    *Cur = S->Next;
+    free(S);
+    break;
   }
+  return Status;
+}
+
+// 等待子进程结束，子进程失败时退出
+static void waitSubprocess(pid_t Pid) {
+  // 只等待这一个子进程结束，其他并行的编译任务不受影响
+  int Status = waitPid(Pid);
+  // 处理子进程返回值
+  if (Status != 0)
+    exit(1);
+}
+
+// 开辟子进程，File为其处理的文件
+static void runSubprocess(char **Argv, char *File) {
+  if (OptHashHashHash)
+    printCommand(Argv);
 
   // Fork–exec模型
   // 创建当前进程的副本，这里开辟了一个子进程
   // 返回-1表示错位，为0表示成功
-  if (fork() == 0) {
+  int64_t Start = nowNs();
+  pid_t Pid = fork();
+  if (Pid == -1)
+    error("fork failed: %s", strerror(errno));
+  if (Pid == 0) {
     // 执行文件rvcc，没有斜杠时搜索环境变量，此时会替换子进程
     execvp(Argv[0], Argv);
     // 如果exec函数返回，表明没有正常执行命令
@@ -528,40 +911,84 @@ static void runSubprocess(char **Argv) {
     _exit(1);
   }
 
-  // 父进程， 等待子进程结束
-  int Status;
-  while (wait(&Status) > 0)
-    ;
-  // 处理子进程返回值
-  if (Status != 0)
-    exit(1);
+  // 父进程，等待子进程结束
+  trackSubprocess(Pid, Argv[0], File, Start);
+  waitSubprocess(Pid);
 }
 
-// 执行调用cc1程序
-// 因为rvcc自身就是cc1程序
-// 所以调用自身，并传入-cc1参数作为子进程
-static void runCC1(int Argc, char **Argv, char *Input, char *Output) {
-  // 多开辟10个字符串的位置，用于传递需要新传入的参数
-  char **Args = calloc(Argc + 10, sizeof(char *));
-  // 将传入程序的参数全部写入Args
-  memcpy(Args, Argv, Argc * sizeof(char *));
-  // 在选项最后新加入"-cc1"选项
-  Args[Argc++] = "-cc1";
-
-  // 存入输入文件的参数
-  if (Input) {
-    Args[Argc++] = "-cc1-input";
-    Args[Argc++] = Input;
+static void cc1Main(void);
+static void assemble(char *Input, char *Output);
+
+// 开始运行cc1程序，返回子进程的pid
+// 因为rvcc自身就是cc1程序，所以fork出子进程后直接调用cc1()，不再exec自身。
+// 省去了程序加载、initMacros()和参数的重新解析，
+// 子进程复制了驱动程序解析完参数后的状态，各个编译单元之间互不影响
+// OutFd不为-1时，cc1将汇编代码直接写入该文件描述符
+// Obj为真时，cc1使用集成汇编器直接输出可重定位文件
+static pid_t startCC1(int Argc, char **Argv, char *Input, char *Output,
+                      int OutFd, bool Obj) {
+  // 打印出等价的命令行，即传入-cc1参数调用自身
+  if (OptHashHashHash) {
+    // 多开辟10个字符串的位置，用于传递需要新传入的参数
+    char **Args = calloc(Argc + 10, sizeof(char *));
+    // 将传入程序的参数全部写入Args
+    memcpy(Args, Argv, Argc * sizeof(char *));
+    // 在选项最后新加入"-cc1"选项
+    Args[Argc++] = "-cc1";
+
+    // 存入输入文件的参数
+    if (Input) {
+      Args[Argc++] = "-cc1-input";
+      Args[Argc++] = Input;
+    }
+
+    // 存入输出文件的参数
+    if (Output) {
+      Args[Argc++] = "-cc1-output";
+      Args[Argc++] = Output;
+    }
+
+    // 输出可重定位文件
+    if (Obj)
+      Args[Argc++] = "-cc1-emit-obj";
+    printCommand(Args);
   }
 
-  // 存入输出文件的参数
-  if (Output) {
-    Args[Argc++] = "-cc1-output";
-    Args[Argc++] = Output;
+  // 避免缓冲区中的内容在子进程中被再次输出
+  fflush(stdout);
+  fflush(stderr);
+
+  int64_t Start = nowNs();
+  pid_t Pid = fork();
+  if (Pid == -1)
+    error("fork failed: %s", strerror(errno));
+  if (Pid == 0) {
+    // 临时文件由驱动程序删除，子进程退出时不能删除
+    TmpFiles.Len = 0;
+    // 相当于-cc1-input和-cc1-output选项
+    BaseFile = Input;
+    OutputFile = Output;
+    EmitObj = Obj;
+    // 将标准输出重定向到管道
+    if (OutFd != -1) {
+      dup2(OutFd, STDOUT_FILENO);
+      close(OutFd);
+      StreamOutput = true;
+    }
+    // 增加默认引入路径
+    addDefaultIncludePaths(Argv[0]);
+    if (OptFTrace)
+      startTrace(format("cc1 %s", BaseFile), false);
+    cc1Main();
+    exit(0);
   }
+  trackSubprocess(Pid, "cc1", Input, Start);
+  return Pid;
+}
 
-  // 运行自身作为子进程，同时传入选项
-  runSubprocess(Args);
+// 执行调用cc1程序，并等待其结束
+static void runCC1(int Argc, char **Argv, char *Input, char *Output) {
+  waitSubprocess(startCC1(Argc, Argv, Input, Output, -1, false));
 }
 
 // 当指定-E选项时，打印出所有终结符
@@ -673,6 +1100,50 @@ static Token *appendTokens(Token *Tok1, Token *Tok2) {
   return Tok1;
 }
 
+// 集成汇编器不支持的指令（例如内联汇编中的指令），改用外部的as
+// 返回生成的可重定位文件的内容
+static char *assembleExternal(char *Buf, size_t BufLen, size_t *ObjLen) {
+  char *Asm = createTmpFile();
+  char *Obj = createTmpFile();
+  FILE *Out = openFile(Asm);
+  fwrite(Buf, BufLen, 1, Out);
+  fclose(Out);
+  assemble(Asm, Obj);
+  char *Data = readAll(Obj, ObjLen);
+  if (!Data)
+    error("cannot read %s: %s", Obj, strerror(errno));
+  return Data;
+}
+
+// 将编译的结果写入输出文件
+static void writeOutput(char *Buf, size_t Len) {
+  FILE *Out = openFile(OutputFile);
+  fwrite(Buf, Len, 1, Out);
+  fclose(Out);
+}
+
+// 写入编译的结果，CacheKey不为空时同时写入缓存
+static void writeResult(char *Buf, size_t Len, char *CacheKey, int64_t Start) {
+  // 写入缓存
+  if (CacheKey) {
+    enterPhase(PHASE_CACHE);
+    cacheStore(OptFCacheDir, CacheKey, Buf, Len, nowNs() - Start);
+    cacheUpdateStats(OptFCacheDir, false, 0);
+  }
+
+  // 从缓冲区中写入到文件中
+  enterPhase(PHASE_OUTPUT);
+  writeOutput(Buf, Len);
+}
+
+// 是否有函数含有内联汇编
+static bool hasInlineAsm(Obj *Prog) {
+  for (Obj *Fn = Prog; Fn; Fn = Fn->Next)
+    if (Fn->IsFunction && Fn->HasAsm)
+      return true;
+  return false;
+}
+
 // 编译C文件到汇编文件
 static void cc1(void) {
   Token *Tok = NULL;
@@ -703,7 +1174,9 @@ static void cc1(void) {
   Tok = appendTokens(Tok, Tok2);
 
   // 预处理
+  enterPhase(PHASE_PREPROCESS);
   Tok = preprocess(Tok);
+  enterPhase(PHASE_OTHER);
 
   // 如果指定了-M，打印出文件的依赖关系
   if (OptM || OptMD) {
@@ -718,11 +1191,69 @@ static void cc1(void) {
     return;
   }
 
+  // 剖析数据文件
+  if (OptFProfileGenerate)
+    OptFProfileGenerate = profilePath(OptFProfileGenerate);
+  if (OptFProfileUse)
+    OptFProfileUse = profilePath(OptFProfileUse);
+
+  // 编译缓存，命中时直接输出缓存的结果，不再进行语法分析和代码生成
+  // 剖析数据也会影响代码生成，因此计入缓存的键中；
+  // 插桩代码中包含剖析数据文件的路径，因此也计入键中
+  char *CacheKey = NULL;
+  int64_t Start = nowNs();
+  if (OptFCacheDir) {
+    enterPhase(PHASE_CACHE);
+    CacheKey = cacheKey(Tok,
+                        format("%s%s\n%d\n%s\n", CacheOptions, BaseFile,
+                               EmitObj,
+                               OptFProfileGenerate ? OptFProfileGenerate : ""),
+                        OptFProfileUse);
+    size_t Len;
+    int64_t Ns;
+    char *Buf = cacheLookup(OptFCacheDir, CacheKey, &Len, &Ns);
+    if (Buf) {
+      enterPhase(PHASE_OUTPUT);
+      writeOutput(Buf, Len);
+      // 节省的时间为当初编译所用的时间减去本次查找缓存的时间
+      cacheUpdateStats(OptFCacheDir, true, Ns - (nowNs() - Start));
+      return;
+    }
+  }
+
   // 解析终结符流
+  enterPhase(PHASE_PARSE);
   Obj *Prog = parse(Tok);
+  // 删除局部变量的死代码和死存储
+  enterPhase(PHASE_OPTIMIZE);
+  optimize(Prog);
+  enterPhase(PHASE_CODEGEN);
 
   // 生成代码
 
+  // 使用集成汇编器时，codegen直接将指令编码到可重定位文件中
+  // 内联汇编中可能有集成汇编器不支持的指令，这时仍然先输出汇编代码，
+  // 以便改用外部的as
+  if (EmitObj && !hasInlineAsm(Prog)) {
+    asmBegin();
+    codegen(Prog, NULL);
+    enterPhase(PHASE_ASSEMBLE);
+    char *Buf;
+    size_t BufLen;
+    asmEnd(&Buf, &BufLen);
+    writeResult(Buf, BufLen, CacheKey, Start);
+    return;
+  }
+
+  // -pipe时直接写入管道，as同时进行汇编
+  // cc1出错时由驱动程序删除as的输出，因此也不会留下不完整的文件
+  // 需要写入缓存时，仍然先输出到缓冲区中
+  if (StreamOutput && !CacheKey) {
+    codegen(Prog, stdout);
+    fclose(stdout);
+    return;
+  }
+
   // 防止编译器在编译途中退出，而只生成了部分的文件
   // 开启临时输出缓冲区
   char *Buf;
@@ -733,20 +1264,158 @@ static void cc1(void) {
   codegen(Prog, OutputBuf);
   fclose(OutputBuf);
 
-  // 从缓冲区中写入到文件中
-  FILE *Out = openFile(OutputFile);
-  fwrite(Buf, BufLen, 1, Out);
-  fclose(Out);
+  // 使用集成汇编器，直接输出可重定位文件
+  if (EmitObj) {
+    enterPhase(PHASE_ASSEMBLE);
+    char *Obj;
+    size_t ObjLen;
+    if (!assembleObj(Buf, &Obj, &ObjLen))
+      Obj = assembleExternal(Buf, BufLen, &ObjLen);
+    Buf = Obj;
+    BufLen = ObjLen;
+  }
+
+  writeResult(Buf, BufLen, CacheKey, Start);
+}
+
+// 运行cc1，并输出-ftime-report和-fmem-report的统计以及-ftrace的跟踪事件
+static void cc1Main(void) {
+  startTimeReport();
+  resetMemCounts();
+  int64_t Start = nowNs();
+  cc1();
+  if (OptFTimeReport)
+    timeReportCC1(BaseFile);
+  if (OptFMemReport)
+    memReportCC1(BaseFile);
+  if (OptFTrace) {
+    traceSpan("cc1", BaseFile, Start, nowNs());
+    flushTrace();
+  }
+}
+
+// 选择对应环境内的汇编器
+static char *asPath(void) {
+  return strlen(RVPath) ? format("%s/bin/riscv64-unknown-linux-gnu-as", RVPath)
+                        : "as";
 }
 
 // 调用汇编器
 static void assemble(char *Input, char *Output) {
-  // 选择对应环境内的汇编器
-  char *As = strlen(RVPath)
-                 ? format("%s/bin/riscv64-unknown-linux-gnu-as", RVPath)
-                 : "as";
-  char *Cmd[] = {As, "-c", Input, "-o", Output, NULL};
-  runSubprocess(Cmd);
+  char *Cmd[] = {asPath(), "-c", Input, "-o", Output, NULL};
+  runSubprocess(Cmd, Input);
+}
+
+// -pipe，cc1的输出通过管道传给从标准输入读取的as，不使用临时的汇编文件
+// cc1边生成代码边写入管道，as同时进行汇编
+static void compileAndAssemble(int Argc, char **Argv, char *Input,
+                               char *Output) {
+  int Fds[2];
+  if (pipe(Fds) == -1)
+    error("pipe failed: %s", strerror(errno));
+
+  // as，未指定输入文件时从标准输入读取
+  char *Cmd[] = {asPath(), "-c", "-o", Output, NULL};
+  if (OptHashHashHash)
+    printCommand(Cmd);
+  fflush(stdout);
+  fflush(stderr);
+  int64_t Start = nowNs();
+  pid_t AsPid = fork();
+  if (AsPid == -1)
+    error("fork failed: %s", strerror(errno));
+  if (AsPid == 0) {
+    dup2(Fds[0], STDIN_FILENO);
+    close(Fds[0]);
+    close(Fds[1]);
+    execvp(Cmd[0], Cmd);
+    fprintf(stderr, "exec failed: %s: %s\n", Cmd[0], strerror(errno));
+    _exit(1);
+  }
+  trackSubprocess(AsPid, Cmd[0], "-", Start);
+
+  // cc1，写入管道
+  close(Fds[0]);
+  pid_t CC1Pid = startCC1(Argc, Argv, Input, NULL, Fds[1], false);
+  // 关闭驱动程序中的写端，cc1结束后as才能读到文件结尾
+  close(Fds[1]);
+
+  int Status = waitPid(CC1Pid);
+
+  // cc1失败时，终止as并删除其输出，不留下不完整的文件
+  if (Status != 0) {
+    kill(AsPid, SIGKILL);
+    waitpid(AsPid, NULL, 0);
+    unlink(Output);
+    exit(1);
+  }
+  waitSubprocess(AsPid);
+}
+
+// 正在运行的编译任务数
+static int RunningJobs;
+// 是否有编译任务失败
+static bool JobFailed;
+
+// 等待任意一个编译任务结束，并记录其退出状态
+static void waitJob(void) {
+  int Status;
+  if (waitpid(-1, &Status, 0) == -1) {
+    if (errno == EINTR)
+      return;
+    error("waitpid failed: %s", strerror(errno));
+  }
+  RunningJobs--;
+  if (Status != 0)
+    JobFailed = true;
+}
+
+// 依次运行cc1和as，-pipe时cc1和as通过管道同时运行
+// 使用集成汇编器时，cc1直接输出可重定位文件
+static void runPipeline(int Argc, char **Argv, char *Input, char *Asm,
+                        char *Obj) {
+  if (OptIntegratedAs && Input && Obj) {
+    waitSubprocess(startCC1(Argc, Argv, Input, Obj, -1, true));
+    return;
+  }
+  if (OptPipe && Input && Obj) {
+    compileAndAssemble(Argc, Argv, Input, Obj);
+    return;
+  }
+  if (Input)
+    runCC1(Argc, Argv, Input, Asm);
+  if (Obj)
+    assemble(Asm, Obj);
+}
+
+// 运行一个编译任务：cc1将Input编译为汇编文件Asm，as再将Asm汇编为Obj
+// Input为NULL时不运行cc1，Obj为NULL时不运行as
+// 指定了-j时，任务在子进程中运行，最多同时运行OptJobs个
+static void runJob(int Argc, char **Argv, char *Input, char *Asm, char *Obj) {
+  if (OptJobs == 1) {
+    runPipeline(Argc, Argv, Input, Asm, Obj);
+    return;
+  }
+
+  // 运行的任务数达到上限时，等待其中一个结束
+  while (RunningJobs >= OptJobs)
+    waitJob();
+  // 已有任务失败时，不再开始新的任务
+  if (JobFailed)
+    return;
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t Pid = fork();
+  if (Pid == -1)
+    error("fork failed: %s", strerror(errno));
+  if (Pid == 0) {
+    // 临时文件由父进程在所有任务结束后删除，子进程退出时不能删除
+    TmpFiles.Len = 0;
+    runPipeline(Argc, Argv, Input, Asm, Obj);
+    exit(0);
+  }
+  RunningJobs++;
 }
 
 // 查找文件
@@ -840,7 +1509,8 @@ static void runLinker(StringArray *Inputs, char *Output) {
     strArrayPush(&Arr, format("%s/crti.o", LibPath));
     strArrayPush(&Arr, format("%s/crtbeginS.o", GccLibPath));
   } else {
-    strArrayPush(&Arr, format("%s/crt1.o", LibPath));
+    // -pg使用gcrt1.o，程序退出时写出gmon.out
+    strArrayPush(&Arr, format("%s/%s", LibPath, OptPG ? "gcrt1.o" : "crt1.o"));
     strArrayPush(&Arr, format("%s/crti.o", LibPath));
     strArrayPush(&Arr, format("%s/crtbegin.o", GccLibPath));
   }
@@ -868,6 +1538,10 @@ static void runLinker(StringArray *Inputs, char *Output) {
     strArrayPush(&Arr, "-L/lib");
   }
 
+  // 每个符号使用单独的段时，回收未被使用的段
+  if (OptFFunctionSections || OptFDataSections)
+    strArrayPush(&Arr, "--gc-sections");
+
   // 链接器额外参数存入到链接器参数中
   for (int I = 0; I < LdExtraArgs.Len; I++)
     strArrayPush(&Arr, LdExtraArgs.Data[I]);
@@ -898,7 +1572,7 @@ static void runLinker(StringArray *Inputs, char *Output) {
   strArrayPush(&Arr, NULL);
 
   // 开辟的链接器子进程
-  runSubprocess(Arr.Data);
+  runSubprocess(Arr.Data, Output);
 }
 
 // 获取文件的类型
@@ -938,21 +1612,94 @@ static FileType getFileType(char *Filename) {
 //   ↓
 // ld链接为可执行文件
 
+// 影响编译结果的选项，用于计算编译缓存的键
+// 输入输出文件、依赖文件、并行、管道和缓存本身的选项不影响结果，不计入其中
+// 预处理相关的选项通过预处理后的终结符流体现
+// 参数单独给出的选项（如-G 8）与其参数一起计入
+static char *cacheOptions(int Argc, char **Argv) {
+  char *Buf;
+  size_t BufLen;
+  FILE *Out = open_memstream(&Buf, &BufLen);
+  for (int I = 1; I < Argc; I++) {
+    char *Arg = Argv[I];
+    // 不影响结果的带有参数的选项
+    if (!strcmp(Arg, "-o") || !strcmp(Arg, "-MF") || !strcmp(Arg, "-MT") ||
+        !strcmp(Arg, "-MQ") || !strcmp(Arg, "-cc1-input") ||
+        !strcmp(Arg, "-cc1-output")) {
+      I++;
+      continue;
+    }
+    // 其他带有参数的选项
+    if (takeArg(Arg) && I + 1 < Argc) {
+      fprintf(Out, "%s\n%s\n", Arg, Argv[++I]);
+      continue;
+    }
+    // 输入文件
+    if (Arg[0] != '-')
+      continue;
+    if (!strncmp(Arg, "-o", 2) || !strncmp(Arg, "-j", 2) ||
+        !strncmp(Arg, "-M", 2) || !strncmp(Arg, "-cc1", 4) ||
+        !strncmp(Arg, "-fcache-", 8) || !strncmp(Arg, "-ftime-report", 13) ||
+        !strncmp(Arg, "-fmem-report", 12) || !strncmp(Arg, "-ftrace=", 8) ||
+        !strcmp(Arg, "-pipe") || !strcmp(Arg, "-###") || !strcmp(Arg, "-c") ||
+        !strcmp(Arg, "-S"))
+      continue;
+    fprintf(Out, "%s\n", Arg);
+  }
+  fclose(Out);
+  return Buf;
+}
+
 // rvcc的程序入口函数
 int main(int Argc, char **Argv) {
+  // 将参数转发给编译服务器，--client[=SOCKET]
+  if (Argc > 1 && (!strcmp(Argv[1], "--client") ||
+                   !strncmp(Argv[1], "--client=", 9))) {
+    char *Socket = Argv[1][8] ? Argv[1] + 9 : NULL;
+    // 去掉--client，转发的参数仍以rvcc自身开始
+    Argv[1] = Argv[0];
+    return runClient(Socket, Argc - 1, Argv + 1);
+  }
+
   // 在程序退出时，执行cleanup函数
   atexit(cleanup);
   // 初始化预定义的宏
   initMacros();
+
+  // 运行编译服务器，--server[=SOCKET]
+  // 只在处理请求的子进程中返回，之后按照请求的参数正常编译
+  if (Argc > 1 && (!strcmp(Argv[1], "--server") ||
+                   !strncmp(Argv[1], "--server=", 9))) {
+    runServer(Argv[1][8] ? Argv[1] + 9 : NULL, &Argc, &Argv);
+    // 服务器启动时定义的日期和时间已经过时
+    defineDateMacros();
+  }
+
   // 解析传入程序的参数
   parseArgs(Argc, Argv);
 
+  // 跟踪编译活动，-cc1时由cc1开始跟踪
+  if (OptFTrace && !OptCC1)
+    startTrace("rvcc", true);
+
+  // 编译缓存
+  if (OptFCacheDir) {
+    CacheOptions = cacheOptions(Argc, Argv);
+    // 没有输入文件时，只打印统计信息
+    if (OptFCacheStats && InputPaths.Len == 0) {
+      cachePrintStats(OptFCacheDir);
+      return 0;
+    }
+  }
+
   // 如果指定了-cc1选项
   // 直接编译C文件到汇编文件
   if (OptCC1) {
     // 增加默认引入路径
     addDefaultIncludePaths(Argv[0]);
-    cc1();
+    if (OptFTrace)
+      startTrace(format("cc1 %s", BaseFile), true);
+    cc1Main();
     return 0;
   }
 
@@ -1015,7 +1762,7 @@ int main(int Argc, char **Argv) {
     if (Ty == FILE_ASM) {
       // 如果没有指定-S，那么需要进行汇编
       if (!OptS)
-        assemble(Input, Output);
+        runJob(Argc, Argv, NULL, Input, Output);
       continue;
     }
 
@@ -1030,35 +1777,42 @@ int main(int Argc, char **Argv) {
 
     // 如果有-S选项，那么执行调用cc1程序
     if (OptS) {
-      runCC1(Argc, Argv, Input, Output);
+      runJob(Argc, Argv, Input, Output, NULL);
       continue;
     }
 
-    // 编译并汇编
+    // 编译并汇编，剖析数据文件以输出的可重定位文件命名
     if (OptC) {
-      // 临时文件Tmp作为cc1输出的汇编文件
-      char *Tmp = createTmpFile();
+      ObjFile = Output;
+      // 临时文件Tmp作为cc1输出的汇编文件，-pipe和集成汇编器时不需要
+      char *Tmp = (OptPipe || OptIntegratedAs) ? NULL : createTmpFile();
       // cc1，编译C文件为汇编文件
-      runCC1(Argc, Argv, Input, Tmp);
       // as，编译汇编文件为可重定位文件
-      assemble(Tmp, Output);
+      runJob(Argc, Argv, Input, Tmp, Output);
       continue;
     }
 
     // 否则运行cc1和as
-    // 临时文件Tmp1作为cc1输出的汇编文件
+    // 临时文件Tmp1作为cc1输出的汇编文件，-pipe和集成汇编器时不需要
     // 临时文件Tmp2作为as输出的可重定位文件
-    char *Tmp1 = createTmpFile();
+    char *Tmp1 = (OptPipe || OptIntegratedAs) ? NULL : createTmpFile();
     char *Tmp2 = createTmpFile();
     // cc1，编译C文件为汇编文件
-    runCC1(Argc, Argv, Input, Tmp1);
     // as，编译汇编文件为可重定位文件
-    assemble(Tmp1, Tmp2);
-    // 将Tmp2存入链接器选项
+    runJob(Argc, Argv, Input, Tmp1, Tmp2);
+    // 将Tmp2存入链接器选项，按输入文件的顺序链接，与任务结束的顺序无关
     strArrayPush(&LdArgs, Tmp2);
     continue;
   }
 
+  // 等待所有编译任务结束，任意一个失败时不进行链接
+  while (RunningJobs > 0)
+    waitJob();
+  if (OptFCacheStats)
+    cachePrintStats(OptFCacheDir);
+  if (JobFailed)
+    return 1;
+
   // 需要链接的情况
   // 未指定文件名时，默认为a.out
   if (LdArgs.Len > 0)
@@ -0,0 +1,404 @@
+#include "rvcc.h"
+
+// 死代码消除，在AST上对每个函数进行以下处理：
+// 1. 删除return、goto以及不返回函数调用之后的不可达语句，
+//    折叠条件为常量的if、for和while语句
+// 2. 删除没有副作用的表达式语句
+// 3. 在语句链表内逆序进行活跃分析，删除写入后不再被读取的局部变量的存储
+// 4. 删除不再被引用的局部变量，以减小栈的大小
+//
+// 可能通过指针访问的（地址被获取的）以及volatile的变量不会被处理
+
+// 当前正在优化的函数
+static Obj *CurrentFn;
+// 当前被标记为死的局部变量的数量
+static int NumDead;
+
+static void optStmt(Node **Link);
+static void optExpr(Node *Nd);
+
+//
+// 节点树遍历
+//
+
+// 判断节点树中是否存在满足条件的节点
+static bool anyNode(Node *Nd, bool (*Pred)(Node *)) {
+  if (!Nd)
+    return false;
+  if (Pred(Nd))
+    return true;
+
+  if (anyNode(Nd->LHS, Pred) || anyNode(Nd->RHS, Pred) ||
+      anyNode(Nd->Cond, Pred) || anyNode(Nd->Then, Pred) ||
+      anyNode(Nd->Els, Pred) || anyNode(Nd->Init, Pred) ||
+      anyNode(Nd->Inc, Pred) || anyNode(Nd->CasAddr, Pred) ||
+      anyNode(Nd->CasOld, Pred) || anyNode(Nd->CasNew, Pred))
+    return true;
+
+  for (Node *N = Nd->Body; N; N = N->Next)
+    if (anyNode(N, Pred))
+      return true;
+  for (Node *N = Nd->Args; N; N = N->Next)
+    if (anyNode(N, Pred))
+      return true;
+  return false;
+}
+
+// 是否为标签，可能从其他位置跳转过来
+static bool isLabel(Node *Nd) {
+  return Nd->Kind == ND_LABEL || Nd->Kind == ND_CASE;
+}
+
+// 是否为语句表达式，其中可能包含跳转和标签
+static bool isStmtExpr(Node *Nd) { return Nd->Kind == ND_STMT_EXPR; }
+
+// 是否为volatile或原子的访问
+static bool isVolatileNode(Node *Nd) {
+  return Nd->Ty && (Nd->Ty->IsVolatile || Nd->Ty->IsAtomic);
+}
+
+// 是否为有副作用的节点
+static bool hasSideEffect(Node *Nd) {
+  switch (Nd->Kind) {
+  case ND_ASSIGN:
+  case ND_FUNCALL:
+  case ND_STMT_EXPR:
+  case ND_MEMZERO:
+  case ND_ASM:
+  case ND_CAS:
+  case ND_ATOM_LD:
+  case ND_ATOM_ST:
+  case ND_ATOM_RMW:
+  case ND_FENCE:
+    return true;
+  case ND_VAR:
+  case ND_DEREF:
+  case ND_MEMBER:
+    return isVolatileNode(Nd);
+  default:
+    return false;
+  }
+}
+
+// 表达式是否没有副作用，可以直接删除
+static bool isPure(Node *Nd) { return !anyNode(Nd, hasSideEffect); }
+
+// 是否为整型常量，并读取其值
+static bool isConstInt(Node *Nd, int64_t *Val) {
+  if (!Nd || Nd->Kind != ND_NUM || !isInteger(Nd->Ty))
+    return false;
+  *Val = Nd->Val;
+  return true;
+}
+
+// 语句执行后，控制流是否不会继续执行下一条语句
+static bool isTerminator(Node *Nd) {
+  switch (Nd->Kind) {
+  case ND_RETURN:
+  case ND_GOTO:
+  case ND_GOTO_EXPR:
+    return true;
+  case ND_EXPR_STMT: {
+    // 调用不返回的函数
+    Node *Call = Nd->LHS;
+    if (Call->Kind == ND_CAST)
+      Call = Call->LHS;
+    return Call->Kind == ND_FUNCALL && Call->LHS->Kind == ND_VAR &&
+           Call->LHS->Var->IsNoreturn;
+  }
+  default:
+    return false;
+  }
+}
+
+//
+// 活跃分析
+//
+
+// 是否为可以跟踪的局部变量，所有读写都在AST中可见
+static bool isTracked(Obj *Var) {
+  if (!Var->IsLocal || Var->IsAddrTaken)
+    return false;
+  if (Var->Ty->IsVolatile || Var->Ty->IsAtomic)
+    return false;
+  if (Var->Ty->Kind == TY_ARRAY || Var->Ty->Kind == TY_VLA)
+    return false;
+  // 这些变量在代码生成时会被隐式访问
+  return Var != CurrentFn->RetVar && Var != CurrentFn->VaArea &&
+         Var != CurrentFn->AllocaBottom;
+}
+
+// 设置变量的死活状态
+static void setDead(Obj *Var, bool IsDead) {
+  if (Var->IsDead == IsDead)
+    return;
+  Var->IsDead = IsDead;
+  NumDead += IsDead ? 1 : -1;
+}
+
+// 将函数内所有可跟踪的局部变量设为死的或活的
+static void setAllDead(bool IsDead) {
+  if (!IsDead && NumDead == 0)
+    return;
+  for (Obj *Var = CurrentFn->Locals; Var; Var = Var->Next)
+    setDead(Var, IsDead && isTracked(Var));
+}
+
+// 读取变量，使其在之前的位置活跃
+static bool markRead(Node *Nd) {
+  if (Nd->Kind == ND_VAR && isTracked(Nd->Var))
+    setDead(Nd->Var, false);
+  return false;
+}
+
+// 逆序处理表达式语句的值，返回删除死存储后的表达式，全部删除时返回NULL
+static Node *dseExpr(Node *Nd) {
+  // A, B：先处理B再处理A
+  if (Nd->Kind == ND_COMMA) {
+    Node *RHS = dseExpr(Nd->RHS);
+    Node *LHS = dseExpr(Nd->LHS);
+    if (!LHS)
+      return RHS;
+    if (!RHS)
+      return LHS;
+    Nd->LHS = LHS;
+    Nd->RHS = RHS;
+    return Nd;
+  }
+
+  // X = B
+  if (Nd->Kind == ND_ASSIGN && Nd->LHS->Kind == ND_VAR &&
+      isTracked(Nd->LHS->Var)) {
+    Obj *Var = Nd->LHS->Var;
+    if (Var->IsDead) {
+      // 写入的值不会再被读取，只保留B的副作用
+      anyNode(Nd->RHS, markRead);
+      return isPure(Nd->RHS) ? NULL : Nd->RHS;
+    }
+    // 在此之前X的值不会再被读取，除非B读取了X
+    setDead(Var, true);
+    anyNode(Nd->RHS, markRead);
+    return Nd;
+  }
+
+  // 局部变量初始化时的清零
+  if (Nd->Kind == ND_MEMZERO && isTracked(Nd->Var)) {
+    if (Nd->Var->IsDead)
+      return NULL;
+    setDead(Nd->Var, true);
+    return Nd;
+  }
+
+  anyNode(Nd, markRead);
+  return Nd;
+}
+
+//
+// 语句优化
+//
+
+// 优化语句链表，AtExit表示链表结束后函数返回，
+// KeepLast表示保留最后一条语句（语句表达式的值）
+static void optList(Node **Head, bool AtExit, bool KeepLast) {
+  // 优化每条语句的内部
+  for (Node **Link = Head; *Link; Link = &(*Link)->Next)
+    optStmt(Link);
+
+  // 将嵌套的代码块（包括声明语句）展开到链表中，使活跃分析可以跨越它们
+  for (Node **Link = Head; *Link;) {
+    Node *Nd = *Link;
+    if (Nd->Kind != ND_BLOCK) {
+      Link = &Nd->Next;
+      continue;
+    }
+    Node *Last = Nd->Body;
+    if (!Last) {
+      *Link = Nd->Next;
+      continue;
+    }
+    while (Last->Next)
+      Last = Last->Next;
+    Last->Next = Nd->Next;
+    *Link = Nd->Body;
+  }
+
+  // 删除不可达的语句，直到遇到可能被跳转到的标签
+  for (Node *Nd = *Head; Nd; Nd = Nd->Next) {
+    if (!isTerminator(Nd))
+      continue;
+    while (Nd->Next && !anyNode(Nd->Next, isLabel) &&
+           !(KeepLast && !Nd->Next->Next))
+      Nd->Next = Nd->Next->Next;
+  }
+
+  // 逆序遍历语句
+  int Len = 0;
+  for (Node *Nd = *Head; Nd; Nd = Nd->Next)
+    Len++;
+  Node ***Links = calloc(Len, sizeof(Node **));
+  int I = 0;
+  for (Node **Link = Head; *Link; Link = &(*Link)->Next)
+    Links[I++] = Link;
+
+  // 链表结束时函数返回，所有局部变量都不会再被读取
+  setAllDead(AtExit);
+
+  for (I = Len - 1; I >= 0; I--) {
+    Node **Link = Links[I];
+    Node *Nd = *Link;
+
+    // 语句表达式的值，必须保留
+    if (KeepLast && I == Len - 1) {
+      setAllDead(false);
+      continue;
+    }
+
+    // return语句之后，所有局部变量都不会再被读取
+    if (Nd->Kind == ND_RETURN && !anyNode(Nd->LHS, isStmtExpr)) {
+      setAllDead(true);
+      anyNode(Nd->LHS, markRead);
+      continue;
+    }
+
+    // 其他语句可能包含跳转和标签，保守地认为所有变量都是活跃的
+    if (Nd->Kind != ND_EXPR_STMT || anyNode(Nd->LHS, isStmtExpr)) {
+      setAllDead(false);
+      continue;
+    }
+
+    // 删除死存储，以及没有副作用的表达式语句
+    Node *Exp = isPure(Nd->LHS) ? NULL : dseExpr(Nd->LHS);
+    if (Exp) {
+      Nd->LHS = Exp;
+      continue;
+    }
+    *Link = Nd->Next;
+  }
+
+  setAllDead(false);
+  free(Links);
+}
+
+// 优化单条语句
+static void optStmt(Node **Link) {
+  Node *Nd = *Link;
+  int64_t Val;
+
+  switch (Nd->Kind) {
+  case ND_BLOCK:
+    optList(&Nd->Body, false, false);
+    return;
+  case ND_IF: {
+    optExpr(Nd->Cond);
+    optStmt(&Nd->Then);
+    if (Nd->Els)
+      optStmt(&Nd->Els);
+
+    // 条件为常量时，只保留会被执行的分支
+    if (!isConstInt(Nd->Cond, &Val))
+      return;
+    Node *Live = Val ? Nd->Then : Nd->Els;
+    Node *Dead = Val ? Nd->Els : Nd->Then;
+    if (anyNode(Dead, isLabel))
+      return;
+    Nd->Kind = ND_BLOCK;
+    Nd->Body = Live;
+    Nd->Cond = Nd->Then = Nd->Els = NULL;
+    return;
+  }
+  case ND_FOR:
+    if (Nd->Init)
+      optStmt(&Nd->Init);
+    optExpr(Nd->Cond);
+    optExpr(Nd->Inc);
+    optStmt(&Nd->Then);
+
+    // 条件为0的循环，只保留初始化语句
+    if (!isConstInt(Nd->Cond, &Val) || Val || anyNode(Nd->Then, isLabel))
+      return;
+    Nd->Kind = ND_BLOCK;
+    Nd->Body = Nd->Init;
+    Nd->Init = Nd->Cond = Nd->Inc = Nd->Then = NULL;
+    return;
+  case ND_DO:
+  case ND_SWITCH:
+    optStmt(&Nd->Then);
+    optExpr(Nd->Cond);
+    return;
+  case ND_CASE:
+  case ND_LABEL:
+    optStmt(&Nd->LHS);
+    return;
+  case ND_RETURN:
+  case ND_EXPR_STMT:
+  case ND_GOTO_EXPR:
+    optExpr(Nd->LHS);
+    return;
+  default:
+    return;
+  }
+}
+
+// 优化表达式中的语句表达式
+static void optExpr(Node *Nd) {
+  if (!Nd)
+    return;
+  if (Nd->Kind == ND_STMT_EXPR) {
+    optList(&Nd->Body, false, true);
+    return;
+  }
+
+  optExpr(Nd->LHS);
+  optExpr(Nd->RHS);
+  optExpr(Nd->Cond);
+  optExpr(Nd->Then);
+  optExpr(Nd->Els);
+  optExpr(Nd->CasAddr);
+  optExpr(Nd->CasOld);
+  optExpr(Nd->CasNew);
+  for (Node *N = Nd->Args; N; N = N->Next)
+    optExpr(N);
+}
+
+//
+// 删除未被引用的局部变量
+//
+
+// 标记节点引用的局部变量
+static bool markUsed(Node *Nd) {
+  if ((Nd->Kind == ND_VAR || Nd->Kind == ND_VLA_PTR ||
+       Nd->Kind == ND_MEMZERO) &&
+      Nd->Var)
+    Nd->Var->IsUsed = true;
+  if (Nd->Kind == ND_FUNCALL && Nd->RetBuffer)
+    Nd->RetBuffer->IsUsed = true;
+  return false;
+}
+
+// 删除未被引用的局部变量，形参和隐式使用的变量除外
+static void pruneLocals(Obj *Fn) {
+  anyNode(Fn->Body, markUsed);
+
+  Obj **Link = &Fn->Locals;
+  while (*Link && *Link != Fn->Params) {
+    Obj *Var = *Link;
+    if (Var->IsUsed || Var == Fn->VaArea || Var == Fn->AllocaBottom ||
+        Var == Fn->RetVar)
+      Link = &Var->Next;
+    else
+      *Link = Var->Next;
+  }
+}
+
+// 优化入口函数
+void optimize(Obj *Prog) {
+  for (Obj *Fn = Prog; Fn; Fn = Fn->Next) {
+    if (!Fn->IsFunction || !Fn->IsDefinition)
+      continue;
+
+    CurrentFn = Fn;
+    // 函数体结束时函数返回
+    optList(&Fn->Body->Body, true, false);
+    pruneLocals(Fn);
+  }
+}
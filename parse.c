@@ -26,6 +26,13 @@ typedef struct {
   bool IsInline;  // 是否为内联
   bool IsTLS;     // 是否为线程局部存储，Thread Local Storage
   int Align;      // 对齐量
+
+  // 函数属性
+  bool IsHot;       // 是否为热函数
+  bool IsCold;      // 是否为冷函数
+  bool IsNoreturn;  // 是否为不返回的函数
+  bool IsNoInstr;   // 是否不进行插桩
+  char *Visibility; // 符号可见性，NULL为default
 } VarAttr;
 
 // 可变的初始化器。此处为树状结构。
@@ -67,6 +74,9 @@ static Scope *Scp = &(Scope){};
 // 指向当前正在解析的函数
 static Obj *CurrentFn;
 
+// 当前函数是否存在不能进行具名返回值优化的return语句
+static bool NoRetVar;
+
 // 当前函数内的goto和标签列表
 static Node *Gotos;
 static Node *Labels;
@@ -83,8 +93,11 @@ static Node *CurrentSwitch;
 // 内建的Alloca函数
 static Obj *BuiltinAlloca;
 
+// 字符串字面量，用于去重
+static HashMap StrLiterals;
+
 // program = (typedef | functionDefinition | globalVariable)*
-// functionDefinition = declspec declarator "{" compoundStmt*
+// functionDefinition = declspec declarator declAttribute? "{" compoundStmt*
 // declspec = ("void" | "_Bool" | char" | "short" | "int" | "long"
 //             | "typedef" | "static" | "extern" | "inline"
 //             | "_Thread_local" | "__thread"
@@ -93,7 +106,8 @@ static Obj *BuiltinAlloca;
 //             | structDecl | unionDecl | typedefName
 //             | enumSpecifier | typeofSpecifier
 //             | "const" | "volatile" | "auto" | "register" | "restrict"
-//             | "__restrict" | "__restrict__" | "_Noreturn")+
+//             | "__restrict" | "__restrict__" | "_Noreturn"
+//             | declAttribute)+
 // enumSpecifier = ident? "{" enumList? "}"
 //                 | ident ("{" enumList? "}")?
 // enumList = ident ("=" constExpr)? ("," ident ("=" constExpr)?)* ","?
@@ -105,8 +119,9 @@ static Obj *BuiltinAlloca;
 // param = declspec declarator
 
 // compoundStmt = (typedef | declaration | stmt)* "}"
-// declaration = declspec (declarator ("=" initializer)?
-//                         ("," declarator ("=" initializer)?)*)? ";"
+// declaration = declspec (declarator declAttribute? ("=" initializer)?
+//                         ("," declarator declAttribute? ("=" initializer)?)*)?
+//               ";"
 // initializer = stringInitializer | arrayInitializer | structInitializer
 //             | unionInitializer |assign
 // stringInitializer = stringLiteral
@@ -160,6 +175,7 @@ static Obj *BuiltinAlloca;
 // structMembers = (declspec declarator (","  declarator)* ";")*
 // structDecl = structUnionDecl
 // unionDecl = structUnionDecl
+// declAttribute = ("__attribute__" "(" "(" declAttr ("," declAttr)* ")" ")")*
 // structUnionDecl = attribute? ident? ("{" structMembers)?
 // attribute = ("__attribute__" "(" "(" ("packed")
 //                                    | ("aligned" "(" N ")") ")" ")")*
@@ -181,6 +197,7 @@ static Obj *BuiltinAlloca;
 //         | "_Alignof" unary
 //         | "_Generic" genericSelection
 //         | "__builtin_types_compatible_p" "(" typeName, typeName, ")"
+//         | atomicBuiltin
 //         | ident
 //         | str
 //         | num
@@ -209,6 +226,7 @@ static Initializer *initializer(Token **Rest, Token *Tok, Type *Ty,
 static Node *LVarInitializer(Token **Rest, Token *Tok, Obj *Var);
 static void GVarInitializer(Token **Rest, Token *Tok, Obj *Var);
 static Node *compoundStmt(Token **Rest, Token *Tok);
+static Token *declAttributeList(Token *Tok, VarAttr *Attr);
 static Node *stmt(Token **Rest, Token *Tok);
 static Node *exprStmt(Token **Rest, Token *Tok);
 static Node *expr(Token **Rest, Token *Tok);
@@ -251,7 +269,7 @@ static int alignDown(int N, int Align) { return alignTo(N - Align + 1, Align); }
 
 // 进入域
 static void enterScope(void) {
-  Scope *S = calloc(1, sizeof(Scope));
+  Scope *S = allocMem(MEM_SCOPE, sizeof(Scope));
   // 后来的在链表头部
   // 类似于栈的结构，栈顶对应最近的域
   S->Next = Scp;
@@ -285,9 +303,10 @@ static Type *findTag(Token *Tok) {
 
 // 新建一个节点
 static Node *newNode(NodeKind Kind, Token *Tok) {
-  Node *Nd = calloc(1, sizeof(Node));
+  Node *Nd = allocMem(MEM_NODE, sizeof(Node));
   Nd->Kind = Kind;
   Nd->Tok = Tok;
+  Counters.Nodes++;
   return Nd;
 }
 
@@ -347,7 +366,7 @@ static Node *newVLAPtr(Obj *Var, Token *Tok) {
 Node *newCast(Node *Expr, Type *Ty) {
   addType(Expr);
 
-  Node *Nd = calloc(1, sizeof(Node));
+  Node *Nd = allocMem(MEM_NODE, sizeof(Node));
   Nd->Kind = ND_CAST;
   Nd->Tok = Expr->Tok;
   Nd->LHS = Expr;
@@ -357,14 +376,14 @@ Node *newCast(Node *Expr, Type *Ty) {
 
 // 将变量存入当前的域中
 static VarScope *pushScope(char *Name) {
-  VarScope *S = calloc(1, sizeof(VarScope));
+  VarScope *S = allocMem(MEM_SCOPE, sizeof(VarScope));
   hashmapPut(&Scp->Vars, Name, S);
   return S;
 }
 
 // 新建初始化器
 static Initializer *newInitializer(Type *Ty, bool IsFlexible) {
-  Initializer *Init = calloc(1, sizeof(Initializer));
+  Initializer *Init = allocMem(MEM_OBJ, sizeof(Initializer));
   // 存储原始类型
   Init->Ty = Ty;
 
@@ -378,7 +397,7 @@ static Initializer *newInitializer(Type *Ty, bool IsFlexible) {
     }
 
     // 为数组的最外层的每个元素分配空间
-    Init->Children = calloc(Ty->ArrayLen, sizeof(Initializer *));
+    Init->Children = allocMem(MEM_OBJ, Ty->ArrayLen * sizeof(Initializer *));
     // 遍历解析数组最外层的每个元素
     for (int I = 0; I < Ty->ArrayLen; ++I)
       Init->Children[I] = newInitializer(Ty->Base, false);
@@ -392,14 +411,14 @@ static Initializer *newInitializer(Type *Ty, bool IsFlexible) {
       ++Len;
 
     // 初始化器的子项
-    Init->Children = calloc(Len, sizeof(Initializer *));
+    Init->Children = allocMem(MEM_OBJ, Len * sizeof(Initializer *));
 
     // 遍历子项进行赋值
     for (Member *Mem = Ty->Mems; Mem; Mem = Mem->Next) {
       // 判断结构体是否是灵活的，同时成员也是灵活的并且是最后一个
       // 在这里直接构造，避免对于灵活数组的解析
       if (IsFlexible && Ty->IsFlexible && !Mem->Next) {
-        Initializer *Child = calloc(1, sizeof(Initializer));
+        Initializer *Child = allocMem(MEM_OBJ, sizeof(Initializer));
         Child->Ty = Mem->Ty;
         Child->IsFlexible = true;
         Init->Children[Mem->Idx] = Child;
@@ -416,7 +435,7 @@ static Initializer *newInitializer(Type *Ty, bool IsFlexible) {
 
 // 新建变量
 static Obj *newVar(char *Name, Type *Ty) {
-  Obj *Var = calloc(1, sizeof(Obj));
+  Obj *Var = allocMem(MEM_OBJ, sizeof(Obj));
   Var->Name = Name;
   Var->Ty = Ty;
   // 设置变量默认的对齐量为类型的对齐量
@@ -457,9 +476,25 @@ static char *newUniqueName(void) {
 static Obj *newAnonGVar(Type *Ty) { return newGVar(newUniqueName(), Ty); }
 
 // 新增字符串字面量
+// 相同的字符串字面量只生成一次
 static Obj *newStringLiteral(char *Str, Type *Ty) {
-  Obj *Var = newAnonGVar(Ty);
+  // 以元素的类型和字符串的内容作为键
+  // 内容相同的L"..."和U"..."元素类型不同，不能共用
+  int KeyLen = Ty->Size + 3;
+  char *Key = allocMem(MEM_STRING, KeyLen);
+  Key[0] = Ty->Base->Kind;
+  Key[1] = Ty->Base->Size;
+  Key[2] = Ty->Base->IsUnsigned;
+  memcpy(Key + 3, Str, Ty->Size);
+
+  Obj *Var = hashmapGet2(&StrLiterals, Key, KeyLen);
+  if (Var)
+    return Var;
+
+  Var = newAnonGVar(Ty);
   Var->InitData = Str;
+  Var->IsStrLit = true;
+  hashmapPut2(&StrLiterals, Key, KeyLen, Var);
   return Var;
 }
 
@@ -494,7 +529,8 @@ static void pushTagScope(Token *Tok, Type *Ty) {
 //             | structDecl | unionDecl | typedefName
 //             | enumSpecifier | typeofSpecifier
 //             | "const" | "volatile" | "auto" | "register" | "restrict"
-//             | "__restrict" | "__restrict__" | "_Noreturn")+
+//             | "__restrict" | "__restrict__" | "_Noreturn"
+//             | declAttribute)+
 // declarator specifier
 static Type *declspec(Token **Rest, Token *Tok, VarAttr *Attr) {
 
@@ -517,6 +553,8 @@ static Type *declspec(Token **Rest, Token *Tok, VarAttr *Attr) {
   Type *Ty = TyInt;
   int Counter = 0; // 记录类型相加的数值
   bool IsAtomic = false; // 标记是否为原子的
+  bool IsConst = false;    // 标记是否为const的
+  bool IsVolatile = false; // 标记是否为volatile的
 
   // 遍历所有类型名的Tok
   while (isTypename(Tok)) {
@@ -547,11 +585,34 @@ static Type *declspec(Token **Rest, Token *Tok, VarAttr *Attr) {
       continue;
     }
 
+    // 函数属性
+    if (equal(Tok, "__attribute__")) {
+      VarAttr Dummy = {};
+      Tok = declAttributeList(Tok, Attr ? Attr : &Dummy);
+      continue;
+    }
+
+    // _Noreturn
+    if (consume(&Tok, Tok, "_Noreturn")) {
+      if (Attr)
+        Attr->IsNoreturn = true;
+      continue;
+    }
+
+    // 匹配类型限定符
+    if (consume(&Tok, Tok, "const")) {
+      IsConst = true;
+      continue;
+    }
+    if (consume(&Tok, Tok, "volatile")) {
+      IsVolatile = true;
+      continue;
+    }
+
     // 识别这些关键字并忽略
-    if (consume(&Tok, Tok, "const") || consume(&Tok, Tok, "volatile") ||
-        consume(&Tok, Tok, "auto") || consume(&Tok, Tok, "register") ||
+    if (consume(&Tok, Tok, "auto") || consume(&Tok, Tok, "register") ||
         consume(&Tok, Tok, "restrict") || consume(&Tok, Tok, "__restrict") ||
-        consume(&Tok, Tok, "__restrict__") || consume(&Tok, Tok, "_Noreturn"))
+        consume(&Tok, Tok, "__restrict__"))
       continue;
 
     // 匹配是否为原子的
@@ -704,6 +765,16 @@ static Type *declspec(Token **Rest, Token *Tok, VarAttr *Attr) {
     Ty->IsAtomic = true;
   }
 
+  // 不完整的结构体可能在之后被补全，因此不进行复制
+  bool IsIncomplete =
+      (Ty->Kind == TY_STRUCT || Ty->Kind == TY_UNION) && Ty->Size < 0;
+  if ((IsConst || IsVolatile) && !IsIncomplete) {
+    Ty = copyType(Ty);
+    // 类型被标记为const或volatile的
+    Ty->IsConst |= IsConst;
+    Ty->IsVolatile |= IsVolatile;
+  }
+
   *Rest = Tok;
   return Ty;
 }
@@ -814,11 +885,16 @@ static Type *pointers(Token **Rest, Token *Tok, Type *Ty) {
   // 构建所有的（多重）指针
   while (consume(&Tok, Tok, "*")) {
     Ty = pointerTo(Ty);
-    // 识别这些关键字并忽略
+    // 识别指针的类型限定符，restrict被忽略
     while (equal(Tok, "const") || equal(Tok, "volatile") ||
            equal(Tok, "restrict") || equal(Tok, "__restrict") ||
-           equal(Tok, "__restrict__"))
+           equal(Tok, "__restrict__")) {
+      if (equal(Tok, "const"))
+        Ty->IsConst = true;
+      else if (equal(Tok, "volatile"))
+        Ty->IsVolatile = true;
       Tok = Tok->Next;
+    }
   }
   *Rest = Tok;
   return Ty;
@@ -1037,8 +1113,9 @@ static Node *newAlloca(Node *Sz) {
   return Nd;
 }
 
-// declaration = declspec (declarator ("=" initializer)?
-//                         ("," declarator ("=" initializer)?)*)? ";"
+// declaration = declspec (declarator declAttribute? ("=" initializer)?
+//                         ("," declarator declAttribute? ("=" initializer)?)*)?
+//               ";"
 static Node *declaration(Token **Rest, Token *Tok, Type *BaseTy,
                          VarAttr *Attr) {
   Node Head = {};
@@ -1060,10 +1137,18 @@ static Node *declaration(Token **Rest, Token *Tok, Type *BaseTy,
     if (!Ty->Name)
       errorTok(Ty->NamePos, "variable name omitted");
 
-    if (Attr && Attr->IsStatic) {
+    // 声明符之后的属性只作用于当前变量
+    VarAttr DeclAttr = {};
+    if (Attr)
+      DeclAttr = *Attr;
+    Tok = declAttributeList(Tok, &DeclAttr);
+
+    if (DeclAttr.IsStatic) {
       // 静态局部变量
       Obj *Var = newAnonGVar(Ty);
       pushScope(getIdent(Ty->Name))->Var = Var;
+      if (DeclAttr.Align)
+        Var->Align = DeclAttr.Align;
       if (equal(Tok, "="))
         GVarInitializer(&Tok, Tok->Next, Var);
       continue;
@@ -1098,8 +1183,8 @@ static Node *declaration(Token **Rest, Token *Tok, Type *BaseTy,
 
     Obj *Var = newLVar(getIdent(Ty->Name), Ty);
     // 读取是否存在变量的对齐值
-    if (Attr && Attr->Align)
-      Var->Align = Attr->Align;
+    if (DeclAttr.Align)
+      Var->Align = DeclAttr.Align;
 
     // 如果不存在"="则为变量声明，不需要生成节点，已经存储在Locals中了
     if (equal(Tok, "=")) {
@@ -1536,7 +1621,7 @@ static Type *copyStructType(Type *Ty) {
   Member *Cur = &Head;
   // 遍历成员
   for (Member *Mem = Ty->Mems; Mem; Mem = Mem->Next) {
-    Member *M = calloc(1, sizeof(Member));
+    Member *M = allocMem(MEM_OBJ, sizeof(Member));
     *M = *Mem;
     Cur->Next = M;
     Cur = Cur->Next;
@@ -1776,7 +1861,7 @@ static Relocation *writeGVarData(Relocation *Cur, Initializer *Init, Type *Ty,
   }
 
   // 存在Label，则表示使用了其他全局变量
-  Relocation *Rel = calloc(1, sizeof(Relocation));
+  Relocation *Rel = allocMem(MEM_OBJ, sizeof(Relocation));
   Rel->Offset = Offset;
   Rel->Label = Label;
   Rel->Addend = Val;
@@ -1793,7 +1878,7 @@ static void GVarInitializer(Token **Rest, Token *Tok, Obj *Var) {
   // 写入计算过后的数据
   // 新建一个重定向的链表
   Relocation Head = {};
-  char *Buf = calloc(1, Var->Ty->Size);
+  char *Buf = allocMem(MEM_OBJ, Var->Ty->Size);
   writeGVarData(&Head, Init, Var->Ty, Buf, 0);
   // 全局变量的数据
   Var->InitData = Buf;
@@ -1814,6 +1899,7 @@ static bool isTypename(Token *Tok) {
         "const",      "volatile",     "auto",          "register", "restrict",
         "__restrict", "__restrict__", "_Noreturn",     "float",    "double",
         "typeof",     "inline",       "_Thread_local", "__thread", "_Atomic",
+        "__attribute__",
     };
 
     // 遍历类型名列表插入哈希表
@@ -1839,11 +1925,29 @@ static Node *asmStmt(Token **Rest, Token *Tok) {
   if (Tok->Kind != TK_STR || Tok->Ty->Base->Kind != TY_CHAR)
     errorTok(Tok, "expected string literal");
   Nd->AsmStr = Tok->Str;
+  CurrentFn->HasAsm = true;
   // ")"
   *Rest = skip(Tok->Next, ")");
   return Nd;
 }
 
+// 判断变量是否为当前函数的形参
+static bool isParam(Obj *Var) {
+  for (Obj *P = CurrentFn->Params; P; P = P->Next)
+    if (P == Var)
+      return true;
+  return false;
+}
+
+// 记录return语句返回的局部变量，用于具名返回值优化
+static void recordRetVar(Node *Exp) {
+  if (Exp->Kind == ND_VAR && Exp->Var->IsLocal && !isParam(Exp->Var) &&
+      (!CurrentFn->RetVar || CurrentFn->RetVar == Exp->Var))
+    CurrentFn->RetVar = Exp->Var;
+  else
+    NoRetVar = true;
+}
+
 // 解析语句
 // stmt = "return" expr? ";"
 //        | "if" "(" expr ")" stmt ("else" stmt)?
@@ -1879,6 +1983,10 @@ static Node *stmt(Token **Rest, Token *Tok) {
     // 对于返回值为结构体时不进行类型转换
     if (Ty->Kind != TY_STRUCT && Ty->Kind != TY_UNION)
       Exp = newCast(Exp, CurrentFn->Ty->ReturnTy);
+    // 通过内存返回的结构体，记录被返回的局部变量
+    // 所有return语句都返回同一个非形参的局部变量时，进行具名返回值优化
+    else if (Ty->Size > 16)
+      recordRetVar(Exp);
 
     Nd->LHS = Exp;
     return Nd;
@@ -2498,6 +2606,45 @@ static Node *toAssign(Node *Binary) {
     return newBinary(ND_COMMA, Expr1, Expr4, Tok);
   }
 
+  // 如果 A 是原子的整数或指针，那么 `A += B`、`A -= B`、`A &= B`、
+  // `A |= B`和`A ^= B` 直接使用原子读改写，返回运算后的值
+  if (Binary->LHS->Ty->IsAtomic) {
+    Type *Ty = Binary->LHS->Ty;
+    int Op = -1;
+    switch (Binary->Kind) {
+    case ND_ADD:
+      Op = AO_ADD;
+      break;
+    case ND_SUB:
+      Op = AO_SUB;
+      break;
+    case ND_BITAND:
+      Op = AO_AND;
+      break;
+    case ND_BITOR:
+      Op = AO_OR;
+      break;
+    case ND_BITXOR:
+      Op = AO_XOR;
+      break;
+    default:
+      break;
+    }
+
+    // 整数截断与这些运算可以交换顺序，因此B可以先转换为A的类型
+    bool IsInt = isInteger(Ty) && Ty->Kind != TY_BOOL;
+    bool IsPtr = Ty->Kind == TY_PTR && (Op == AO_ADD || Op == AO_SUB);
+    if (Op != -1 && (IsInt || IsPtr) && isInteger(Binary->RHS->Ty)) {
+      Node *Nd = newNode(ND_ATOM_RMW, Tok);
+      Nd->LHS = newUnary(ND_ADDR, Binary->LHS, Tok);
+      Nd->RHS = newCast(Binary->RHS, Ty);
+      Nd->AtomOp = Op;
+      Nd->RetOld = false;
+      Nd->Order = MO_SEQ_CST;
+      return Nd;
+    }
+  }
+
   // 如果 A 是原子的类型，那么 `A op= B` 被转换为
   //
   // ({
@@ -2556,6 +2703,7 @@ static Node *toAssign(Node *Binary) {
     Cas->CasAddr = newVarNode(Addr, Tok);
     Cas->CasOld = newUnary(ND_ADDR, newVarNode(Old, Tok), Tok);
     Cas->CasNew = newVarNode(New, Tok);
+    Cas->Order = MO_SEQ_CST;
     Loop->Cond = newUnary(ND_NOT, Cas, Tok);
 
     // while (!atomic_compare_exchange_strong(Addr, &Old, New));
@@ -2567,6 +2715,13 @@ static Node *toAssign(Node *Binary) {
     return Nd;
   }
 
+  // 转换 X op= B 为 X = X op B，变量X只求值一次，无需获取其地址
+  if (Binary->LHS->Kind == ND_VAR)
+    return newBinary(ND_ASSIGN, Binary->LHS,
+                     newBinary(Binary->Kind, newVarNode(Binary->LHS->Var, Tok),
+                               Binary->RHS, Tok),
+                     Tok);
+
   // 转换 A op= B为 TMP = &A, *TMP = *TMP op B
   // TMP
   Obj *Var = newLVar("", pointerTo(Binary->LHS->Ty));
@@ -3070,7 +3225,7 @@ static void structMembers(Token **Rest, Token *Tok, Type *Ty) {
     // 匿名的结构体成员
     if ((BaseTy->Kind == TY_STRUCT || BaseTy->Kind == TY_UNION) &&
         consume(&Tok, Tok, ";")) {
-      Member *Mem = calloc(1, sizeof(Member));
+      Member *Mem = allocMem(MEM_OBJ, sizeof(Member));
       Mem->Ty = BaseTy;
       Mem->Idx = Idx++;
       // 如果对齐值不存在，则使用匿名成员的对齐值
@@ -3085,7 +3240,7 @@ static void structMembers(Token **Rest, Token *Tok, Type *Ty) {
         Tok = skip(Tok, ",");
       First = false;
 
-      Member *Mem = calloc(1, sizeof(Member));
+      Member *Mem = allocMem(MEM_OBJ, sizeof(Member));
       // declarator
       Mem->Ty = declarator(&Tok, Tok, BaseTy);
       Mem->Name = Mem->Ty->Name;
@@ -3153,6 +3308,84 @@ static Token *attributeList(Token *Tok, Type *Ty) {
   return Tok;
 }
 
+// 解析声明的属性
+// declAttribute = ("__attribute__" "(" "(" declAttr ("," declAttr)* ")" ")")*
+// declAttr = "hot" | "cold" | "noreturn" | "no_instrument_function"
+//          | "visibility" "(" str ")" | "aligned" "(" N ")"
+static Token *declAttributeList(Token *Tok, VarAttr *Attr) {
+  while (consume(&Tok, Tok, "__attribute__")) {
+    Tok = skip(Tok, "(");
+    Tok = skip(Tok, "(");
+
+    bool First = true;
+
+    while (!consume(&Tok, Tok, ")")) {
+      if (!First)
+        Tok = skip(Tok, ",");
+      First = false;
+
+      // "hot"
+      if (consume(&Tok, Tok, "hot") || consume(&Tok, Tok, "__hot__")) {
+        Attr->IsHot = true;
+        continue;
+      }
+
+      // "cold"
+      if (consume(&Tok, Tok, "cold") || consume(&Tok, Tok, "__cold__")) {
+        Attr->IsCold = true;
+        continue;
+      }
+
+      // "noreturn"
+      if (consume(&Tok, Tok, "noreturn") ||
+          consume(&Tok, Tok, "__noreturn__")) {
+        Attr->IsNoreturn = true;
+        continue;
+      }
+
+      // "no_instrument_function"
+      if (consume(&Tok, Tok, "no_instrument_function") ||
+          consume(&Tok, Tok, "__no_instrument_function__")) {
+        Attr->IsNoInstr = true;
+        continue;
+      }
+
+      // "visibility" "(" str ")"
+      if (consume(&Tok, Tok, "visibility") ||
+          consume(&Tok, Tok, "__visibility__")) {
+        Tok = skip(Tok, "(");
+        if (Tok->Kind != TK_STR)
+          errorTok(Tok, "expected string literal");
+        char *Vis = Tok->Str;
+        if (!strcmp(Vis, "default"))
+          Attr->Visibility = NULL;
+        else if (!strcmp(Vis, "hidden") || !strcmp(Vis, "protected") ||
+                 !strcmp(Vis, "internal"))
+          Attr->Visibility = Vis;
+        else
+          errorTok(Tok, "unknown visibility: %s", Vis);
+        Tok = skip(Tok->Next, ")");
+        continue;
+      }
+
+      // "aligned" "(" N ")"
+      if (consume(&Tok, Tok, "aligned") ||
+          consume(&Tok, Tok, "__aligned__")) {
+        Tok = skip(Tok, "(");
+        Attr->Align = constExpr(&Tok, Tok);
+        Tok = skip(Tok, ")");
+        continue;
+      }
+
+      errorTok(Tok, "unknown attribute");
+    }
+
+    Tok = skip(Tok, ")");
+  }
+
+  return Tok;
+}
+
 // structUnionDecl = attribute? ident? ("{" structMembers)?
 static Type *structUnionDecl(Token **Rest, Token *Tok) {
   // 构造结构体类型
@@ -3522,6 +3755,218 @@ static Node *genericSelection(Token **Rest, Token *Tok) {
   return Ret;
 }
 
+// 原子读改写的内置函数
+typedef struct {
+  char *Name;      // 函数名
+  AtomicOp AtomOp; // 读改写的运算
+  bool RetOld;     // 是否返回操作前的值
+} AtomicRMWBuiltin;
+
+static AtomicRMWBuiltin AtomicRMWBuiltins[] = {
+    {"__atomic_exchange_n", AO_XCHG, true},
+    {"__atomic_fetch_add", AO_ADD, true},
+    {"__atomic_fetch_sub", AO_SUB, true},
+    {"__atomic_fetch_and", AO_AND, true},
+    {"__atomic_fetch_or", AO_OR, true},
+    {"__atomic_fetch_xor", AO_XOR, true},
+    {"__atomic_fetch_nand", AO_NAND, true},
+    {"__atomic_fetch_max", AO_MAX, true},
+    {"__atomic_fetch_min", AO_MIN, true},
+    {"__atomic_add_fetch", AO_ADD, false},
+    {"__atomic_sub_fetch", AO_SUB, false},
+    {"__atomic_and_fetch", AO_AND, false},
+    {"__atomic_or_fetch", AO_OR, false},
+    {"__atomic_xor_fetch", AO_XOR, false},
+    {"__atomic_nand_fetch", AO_NAND, false},
+    {"__atomic_max_fetch", AO_MAX, false},
+    {"__atomic_min_fetch", AO_MIN, false},
+};
+
+// 解析原子操作的地址
+// 需为指向1、2、4、8字节的整数或指针的指针
+static Node *atomicAddr(Token **Rest, Token *Tok) {
+  Node *Nd = assign(Rest, Tok);
+  addType(Nd);
+  if (!Nd->Ty->Base)
+    errorTok(Tok, "pointer expected");
+
+  Type *Ty = Nd->Ty->Base;
+  if ((!isInteger(Ty) && Ty->Kind != TY_PTR) ||
+      (Ty->Size != 1 && Ty->Size != 2 && Ty->Size != 4 && Ty->Size != 8))
+    errorTok(Tok, "invalid operand for atomic operation");
+  return Nd;
+}
+
+// 将值被忽略的参数Arg加入Discard中
+// 参数的值虽然不被使用，但仍需计算其副作用，数字没有副作用，直接忽略。
+// 常量表达式也可能有副作用，例如(N++, __ATOMIC_SEQ_CST)
+static void discardArg(Node **Discard, Node *Arg, Token *Tok) {
+  addType(Arg);
+  if (Arg->Kind == ND_NUM)
+    return;
+  Node *Nd = newCast(Arg, TyVoid);
+  *Discard = *Discard ? newBinary(ND_COMMA, *Discard, Nd, Tok) : Nd;
+}
+
+// 先计算值被忽略的参数，再进行原子操作
+// 参数的求值顺序是未指定的，因此可以在原子操作的其他参数之前计算
+static Node *withDiscarded(Node *Discard, Node *Nd, Token *Tok) {
+  return Discard ? newBinary(ND_COMMA, Discard, Nd, Tok) : Nd;
+}
+
+// 解析原子操作的内存序
+// 内存序不是常量表达式时，视为__ATOMIC_SEQ_CST
+// 表达式的副作用仍需计算，因此加入Discard中
+static MemOrder memOrder(Token **Rest, Token *Tok, Node **Discard) {
+  Node *Nd = assign(Rest, Tok);
+  discardArg(Discard, Nd, Tok);
+  if (!isConstExpr(Nd))
+    return MO_SEQ_CST;
+
+  int64_t Order = eval(Nd);
+  if (Order < MO_RELAXED || Order > MO_SEQ_CST)
+    errorTok(Tok, "invalid memory model");
+  return Order;
+}
+
+// 解析原子操作的内置函数
+// atomicBuiltin = "__atomic_load_n" "(" assign "," memOrder ")"
+//               | "__atomic_store_n" "(" assign "," assign "," memOrder ")"
+//               | atomicRMW "(" assign "," assign "," memOrder ")"
+//               | "__atomic_compare_exchange_n" "(" assign "," assign ","
+//                 assign "," assign "," memOrder "," memOrder ")"
+//               | "__atomic_test_and_set" "(" assign "," memOrder ")"
+//               | "__atomic_clear" "(" assign "," memOrder ")"
+//               | "__atomic_thread_fence" "(" memOrder ")"
+//               | "__atomic_signal_fence" "(" memOrder ")"
+//               | "__atomic_always_lock_free" "(" constExpr "," assign ")"
+//               | "__atomic_is_lock_free" "(" constExpr "," assign ")"
+static Node *atomicBuiltin(Token **Rest, Token *Tok) {
+  Token *Start = Tok;
+  Tok = skip(Tok->Next, "(");
+  // 值被忽略的参数
+  Node *Discard = NULL;
+
+  // "__atomic_load_n" "(" assign "," memOrder ")"
+  if (equal(Start, "__atomic_load_n")) {
+    Node *Nd = newNode(ND_ATOM_LD, Start);
+    Nd->LHS = atomicAddr(&Tok, Tok);
+    Tok = skip(Tok, ",");
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_store_n" "(" assign "," assign "," memOrder ")"
+  if (equal(Start, "__atomic_store_n")) {
+    Node *Nd = newNode(ND_ATOM_ST, Start);
+    Nd->LHS = atomicAddr(&Tok, Tok);
+    Tok = skip(Tok, ",");
+    Nd->RHS = newCast(assign(&Tok, Tok), Nd->LHS->Ty->Base);
+    Tok = skip(Tok, ",");
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // atomicRMW "(" assign "," assign "," memOrder ")"
+  for (int I = 0; I < sizeof(AtomicRMWBuiltins) / sizeof(*AtomicRMWBuiltins);
+       I++) {
+    if (!equal(Start, AtomicRMWBuiltins[I].Name))
+      continue;
+
+    Node *Nd = newNode(ND_ATOM_RMW, Start);
+    Nd->AtomOp = AtomicRMWBuiltins[I].AtomOp;
+    Nd->RetOld = AtomicRMWBuiltins[I].RetOld;
+    Nd->LHS = atomicAddr(&Tok, Tok);
+    Tok = skip(Tok, ",");
+    Nd->RHS = newCast(assign(&Tok, Tok), Nd->LHS->Ty->Base);
+    Tok = skip(Tok, ",");
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_compare_exchange_n" "(" assign "," assign "," assign ","
+  // assign "," memOrder "," memOrder ")"
+  // 第四个参数表示是否为弱比较交换，弱比较交换同样生成会重试的lr/sc循环
+  if (equal(Start, "__atomic_compare_exchange_n")) {
+    Node *Nd = newNode(ND_CAS, Start);
+    Nd->CasAddr = atomicAddr(&Tok, Tok);
+    Tok = skip(Tok, ",");
+    Nd->CasOld = assign(&Tok, Tok);
+    Tok = skip(Tok, ",");
+    Nd->CasNew = newCast(assign(&Tok, Tok), Nd->CasAddr->Ty->Base);
+    Tok = skip(Tok, ",");
+    discardArg(&Discard, assign(&Tok, Tok), Tok);
+    Tok = skip(Tok, ",");
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    Tok = skip(Tok, ",");
+    // 失败时的内存序不能强于成功时的，lr指令按照成功时的内存序生成
+    memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_test_and_set" "(" assign "," memOrder ")"
+  // 将一个字节原子地置为1，返回其原值是否为1
+  if (equal(Start, "__atomic_test_and_set")) {
+    Node *Nd = newNode(ND_ATOM_RMW, Start);
+    Nd->LHS = newCast(assign(&Tok, Tok), pointerTo(TyBool));
+    Nd->RHS = newCast(newNum(1, Start), TyBool);
+    Nd->AtomOp = AO_XCHG;
+    Nd->RetOld = true;
+    Tok = skip(Tok, ",");
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_clear" "(" assign "," memOrder ")"
+  if (equal(Start, "__atomic_clear")) {
+    Node *Nd = newNode(ND_ATOM_ST, Start);
+    Nd->LHS = newCast(assign(&Tok, Tok), pointerTo(TyBool));
+    Nd->RHS = newCast(newNum(0, Start), TyBool);
+    Tok = skip(Tok, ",");
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_thread_fence" "(" memOrder ")"
+  if (equal(Start, "__atomic_thread_fence")) {
+    Node *Nd = newNode(ND_FENCE, Start);
+    Nd->Order = memOrder(&Tok, Tok, &Discard);
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_signal_fence" "(" memOrder ")"
+  // 信号处理函数与当前线程运行在同一硬件线程上，不需要生成屏障指令
+  if (equal(Start, "__atomic_signal_fence")) {
+    Node *Nd = newNode(ND_FENCE, Start);
+    memOrder(&Tok, Tok, &Discard);
+    Nd->Order = MO_RELAXED;
+    *Rest = skip(Tok, ")");
+    return withDiscarded(Discard, Nd, Start);
+  }
+
+  // "__atomic_always_lock_free" "(" constExpr "," assign ")"
+  // "__atomic_is_lock_free" "(" constExpr "," assign ")"
+  // 1、2、4、8字节的对象都可以无锁地进行原子操作
+  if (equal(Start, "__atomic_always_lock_free") ||
+      equal(Start, "__atomic_is_lock_free")) {
+    int64_t Size = constExpr(&Tok, Tok);
+    Tok = skip(Tok, ",");
+    assign(&Tok, Tok);
+    *Rest = skip(Tok, ")");
+    return newNum(Size == 1 || Size == 2 || Size == 4 || Size == 8, Start);
+  }
+
+  errorTok(Start, "unknown atomic builtin");
+  return NULL;
+}
+
 // 解析括号、数字、变量
 // primary = "(" "{" stmt+ "}" ")"
 //         | "(" expr ")"
@@ -3531,6 +3976,7 @@ static Node *genericSelection(Token **Rest, Token *Tok) {
 //         | "_Alignof" unary
 //         | "_Generic" genericSelection
 //         | "__builtin_types_compatible_p" "(" typeName, typeName, ")"
+//         | atomicBuiltin
 //         | ident
 //         | str
 //         | num
@@ -3623,26 +4069,34 @@ static Node *primary(Token **Rest, Token *Tok) {
   if (equal(Tok, "__builtin_compare_and_swap")) {
     Node *Nd = newNode(ND_CAS, Tok);
     Tok = skip(Tok->Next, "(");
-    Nd->CasAddr = assign(&Tok, Tok);
+    Nd->CasAddr = atomicAddr(&Tok, Tok);
     Tok = skip(Tok, ",");
     Nd->CasOld = assign(&Tok, Tok);
     Tok = skip(Tok, ",");
-    Nd->CasNew = assign(&Tok, Tok);
+    Nd->CasNew = newCast(assign(&Tok, Tok), Nd->CasAddr->Ty->Base);
+    Nd->Order = MO_SEQ_CST;
     *Rest = skip(Tok, ")");
     return Nd;
   }
 
   // 原子交换
   if (equal(Tok, "__builtin_atomic_exchange")) {
-    Node *Nd = newNode(ND_EXCH, Tok);
+    Node *Nd = newNode(ND_ATOM_RMW, Tok);
     Tok = skip(Tok->Next, "(");
-    Nd->LHS = assign(&Tok, Tok);
+    Nd->LHS = atomicAddr(&Tok, Tok);
     Tok = skip(Tok, ",");
-    Nd->RHS = assign(&Tok, Tok);
+    Nd->RHS = newCast(assign(&Tok, Tok), Nd->LHS->Ty->Base);
+    Nd->AtomOp = AO_XCHG;
+    Nd->RetOld = true;
+    Nd->Order = MO_SEQ_CST;
     *Rest = skip(Tok, ")");
     return Nd;
   }
 
+  // 原子操作的内置函数
+  if (!strncmp(Tok->Loc, "__atomic_", 9) && equal(Tok->Next, "("))
+    return atomicBuiltin(Rest, Tok);
+
   // ident
   if (Tok->Kind == TK_IDENT) {
     // 查找变量（或枚举常量）
@@ -3786,6 +4240,7 @@ static void markLive(Obj *Var) {
 
 // functionDefinition = declspec declarator "{" compoundStmt*
 static Token *function(Token *Tok, Type *BaseTy, VarAttr *Attr) {
+  int64_t Start = OptFTrace ? nowNs() : 0;
   Type *Ty = declarator(&Tok, Tok, BaseTy);
   if (!Ty->Name)
     errorTok(Ty->NamePos, "function name omitted");
@@ -3814,11 +4269,23 @@ static Token *function(Token *Tok, Type *BaseTy, VarAttr *Attr) {
   // 非static inline函数标记为根函数
   Fn->IsRoot = !(Fn->IsStatic && Fn->IsInline);
 
+  // 声明之后的属性，只作用于当前函数
+  VarAttr DeclAttr = *Attr;
+  Tok = declAttributeList(Tok, &DeclAttr);
+  // 函数属性在多次声明之间累加
+  Fn->IsHot |= DeclAttr.IsHot;
+  Fn->IsCold |= DeclAttr.IsCold;
+  Fn->IsNoreturn |= DeclAttr.IsNoreturn;
+  Fn->IsNoInstr |= DeclAttr.IsNoInstr;
+  if (DeclAttr.Visibility)
+    Fn->Visibility = DeclAttr.Visibility;
+
   // 判断是否没有函数定义
   if (consume(&Tok, Tok, ";"))
     return Tok;
 
   CurrentFn = Fn;
+  NoRetVar = false;
   // 清空全局变量Locals
   Locals = NULL;
   // 进入新的域
@@ -3853,10 +4320,14 @@ static Token *function(Token *Tok, Type *BaseTy, VarAttr *Attr) {
   // 函数体存储语句的AST，Locals存储变量
   Fn->Body = compoundStmt(&Tok, Tok);
   Fn->Locals = Locals;
+  if (NoRetVar)
+    Fn->RetVar = NULL;
   // 结束当前域
   leaveScope();
   // 处理goto和标签
   resolveGotoLabels();
+  if (OptFTrace)
+    traceSpan("parse", Fn->Name, Start, nowNs());
   return Tok;
 }
 
@@ -3872,21 +4343,26 @@ static Token *globalVariable(Token *Tok, Type *Basety, VarAttr *Attr) {
     Type *Ty = declarator(&Tok, Tok, Basety);
     if (!Ty->Name)
       errorTok(Ty->NamePos, "variable name omitted");
+    // 声明符之后的属性只作用于当前变量
+    VarAttr DeclAttr = *Attr;
+    Tok = declAttributeList(Tok, &DeclAttr);
     // 全局变量初始化
     Obj *Var = newGVar(getIdent(Ty->Name), Ty);
     // 是否具有定义
-    Var->IsDefinition = !Attr->IsExtern;
+    Var->IsDefinition = !DeclAttr.IsExtern;
     // 传递是否为static
-    Var->IsStatic = Attr->IsStatic;
+    Var->IsStatic = DeclAttr.IsStatic;
     // 传递是否为TLS
-    Var->IsTLS = Attr->IsTLS;
+    Var->IsTLS = DeclAttr.IsTLS;
+    // 传递符号可见性
+    Var->Visibility = DeclAttr.Visibility;
     // 若有设置，则覆盖全局变量的对齐值
-    if (Attr->Align)
-      Var->Align = Attr->Align;
+    if (DeclAttr.Align)
+      Var->Align = DeclAttr.Align;
 
     if (equal(Tok, "="))
       GVarInitializer(&Tok, Tok->Next, Var);
-    else if (!Attr->IsExtern && !Attr->IsTLS)
+    else if (!DeclAttr.IsExtern && !DeclAttr.IsTLS)
       // 没有初始化器的全局变量设为试探性的
       Var->IsTentative = true;
   }
@@ -82,7 +82,7 @@ static Token *skipLine(Token *Tok) {
 }
 
 static Token *copyToken(Token *Tok) {
-  Token *T = calloc(1, sizeof(Token));
+  Token *T = allocMem(MEM_TOKEN, sizeof(Token));
   *T = *Tok;
   T->Next = NULL;
   return T;
@@ -98,7 +98,7 @@ static Token *newEOF(Token *Tok) {
 
 // 新建一个隐藏集
 static Hideset *newHideset(char *Name) {
-  Hideset *Hs = calloc(1, sizeof(Hideset));
+  Hideset *Hs = allocMem(MEM_HIDESET, sizeof(Hideset));
   Hs->Name = Name;
   return Hs;
 }
@@ -214,7 +214,7 @@ static char *quoteString(char *Str) {
   }
 
   // 分配相应的空间
-  char *Buf = calloc(1, BufSize);
+  char *Buf = allocMem(MEM_STRING, BufSize);
 
   char *P = Buf;
   // 开头的"
@@ -337,7 +337,7 @@ static long evalConstExpr(Token **Rest, Token *Tok) {
 
 // 压入#if栈中
 static CondIncl *pushCondIncl(Token *Tok, bool Included) {
-  CondIncl *CI = calloc(1, sizeof(CondIncl));
+  CondIncl *CI = allocMem(MEM_OTHER, sizeof(CondIncl));
   CI->Next = CondIncls;
   CI->Ctx = IN_THEN;
   CI->Tok = Tok;
@@ -358,7 +358,7 @@ static Macro *findMacro(Token *Tok) {
 
 // 新增宏变量，压入宏变量栈中
 static Macro *addMacro(char *Name, bool IsObjlike, Token *Body) {
-  Macro *M = calloc(1, sizeof(Macro));
+  Macro *M = allocMem(MEM_OTHER, sizeof(Macro));
   M->Name = Name;
   M->IsObjlike = IsObjlike;
   M->Body = Body;
@@ -398,7 +398,7 @@ static MacroParam *readMacroParams(Token **Rest, Token *Tok,
     }
 
     // 开辟空间
-    MacroParam *M = calloc(1, sizeof(MacroParam));
+    MacroParam *M = allocMem(MEM_OTHER, sizeof(MacroParam));
     // 设置名称
     M->Name = strndup(Tok->Loc, Tok->Len);
     // 加入链表
@@ -466,7 +466,7 @@ static MacroArg *readMacroArgOne(Token **Rest, Token *Tok, bool ReadRest) {
   // 加入EOF终结
   Cur->Next = newEOF(Tok);
 
-  MacroArg *Arg = calloc(1, sizeof(MacroArg));
+  MacroArg *Arg = allocMem(MEM_OTHER, sizeof(MacroArg));
   // 赋值实参的终结符链表
   Arg->Tok = Head.Next;
   *Rest = Tok;
@@ -498,7 +498,7 @@ static MacroArg *readMacroArgs(Token **Rest, Token *Tok, MacroParam *Params,
     MacroArg *Arg;
     // 剩余实参为空
     if (equal(Tok, ")")) {
-      Arg = calloc(1, sizeof(MacroArg));
+      Arg = allocMem(MEM_OTHER, sizeof(MacroArg));
       Arg->Tok = newEOF(Tok);
     } else {
       // 处理对应可变参数的实参
@@ -543,7 +543,7 @@ static char *joinTokens(Token *Tok, Token *End) {
   }
 
   // 开辟相应的空间
-  char *Buf = calloc(1, Len);
+  char *Buf = allocMem(MEM_STRING, Len);
 
   // 复制终结符的文本
   int Pos = 0;
@@ -886,7 +886,7 @@ static char *readIncludeFilename(Token **Rest, Token *Tok, bool *IsDquote) {
 //   #define FOO_H
 //   ...
 //   #endif
-static char *detectIncludeGuard(Token *Tok) {
+char *detectIncludeGuard(Token *Tok) {
   // 匹配 #ifndef
   if (!isHash(Tok) || !equal(Tok->Next, "ifndef"))
     return NULL;
@@ -927,6 +927,37 @@ static char *detectIncludeGuard(Token *Tok) {
 }
 
 // 引入文件
+// -ftrace中尚未结束的引入文件
+// 引入的终结符在之后才被预处理，因此区间从引入开始，
+// 到预处理到达#include之后的终结符时结束
+typedef struct IncludeSpan IncludeSpan;
+struct IncludeSpan {
+  IncludeSpan *Next; // 外层的引入文件
+  char *Path;        // 文件路径
+  Token *End;        // #include之后的终结符
+  int64_t Start;     // 开始的时间
+};
+
+static IncludeSpan *IncludeSpans;
+
+// 结束区间到End为止的引入文件，包括未找到结束位置的内层文件
+static void endIncludeSpans(Token *End) {
+  IncludeSpan *S = IncludeSpans;
+  while (S && S->End != End)
+    S = S->Next;
+  if (!S)
+    return;
+
+  int64_t Now = nowNs();
+  for (bool Done = false; !Done;) {
+    S = IncludeSpans;
+    Done = S->End == End;
+    traceSpan("include", S->Path, S->Start, Now);
+    IncludeSpans = S->Next;
+    free(S);
+  }
+}
+
 static Token *includeFile(Token *Tok, char *Path, Token *FilenameTok) {
   // 如果含有 "#pragma once"，已经被读取过，那么就跳过文件
   if (hashmapGet(&PragmaOnce, Path))
@@ -935,10 +966,14 @@ static Token *includeFile(Token *Tok, char *Path, Token *FilenameTok) {
   // 如果引用防护的文件，已经被读取过，那么就跳过文件
   static HashMap IncludeGuards;
   char *GuardName = hashmapGet(&IncludeGuards, Path);
+  // 编译服务器中已知的文件，保护宏已定义时不需要复制终结符
+  if (!GuardName)
+    GuardName = warmIncludeGuard(Path);
   if (GuardName && hashmapGet(&Macros, GuardName))
     return Tok;
 
   // 词法分析文件
+  int64_t Start = OptFTrace ? nowNs() : 0;
   Token *Tok2 = tokenizeFile(Path);
   if (!Tok2)
     errorTok(FilenameTok, "%s: cannot open file: %s", Path, strerror(errno));
@@ -948,6 +983,15 @@ static Token *includeFile(Token *Tok, char *Path, Token *FilenameTok) {
   if (GuardName)
     hashmapPut(&IncludeGuards, Path, GuardName);
 
+  // 记录跟踪的区间
+  if (OptFTrace) {
+    IncludeSpan *S = calloc(1, sizeof(IncludeSpan));
+    S->Path = Path;
+    S->End = Tok;
+    S->Start = Start;
+    S->Next = IncludeSpans;
+    IncludeSpans = S;
+  }
   return append(Tok2, Tok);
 }
 
@@ -981,9 +1025,15 @@ static Token *preprocess2(Token *Tok) {
 
   // 遍历终结符
   while (Tok->Kind != TK_EOF) {
+    // 到达#include之后的终结符时，引入的文件处理完毕
+    if (IncludeSpans)
+      endIncludeSpans(Tok);
+
     // 如果是个宏变量，那么就展开
-    if (expandMacro(&Tok, Tok))
+    if (expandMacro(&Tok, Tok)) {
+      Counters.MacroExpansions++;
       continue;
+    }
 
     // 如果不是#号开头则前进
     if (!isHash(Tok)) {
@@ -1181,6 +1231,9 @@ static Token *preprocess2(Token *Tok) {
     errorTok(Tok, "invalid preprocessor directive");
   }
 
+  // 位于文件末尾的#include
+  if (IncludeSpans)
+    endIncludeSpans(Tok);
   Cur->Next = Tok;
   return Head.Next;
 }
@@ -1271,6 +1324,18 @@ static char *formatTime(struct tm *Tm) {
   return format("\"%02d:%02d:%02d\"", Tm->tm_hour, Tm->tm_min, Tm->tm_sec);
 }
 
+// 定义__DATE__和__TIME__为当前的日期和时间
+// 编译服务器处理每个请求时重新定义
+void defineDateMacros(void) {
+  time_t Now = time(NULL);
+  // 获取当前的本地时区的时间
+  struct tm *Tm = localtime(&Now);
+  // 定义__DATE__为当前日期
+  defineMacro("__DATE__", formatDate(Tm));
+  // 定义__TIME__为当前时间
+  defineMacro("__TIME__", formatTime(Tm));
+}
+
 // 初始化预定义的宏
 void initMacros(void) {
   defineMacro("_LP64", "1");
@@ -1318,6 +1383,15 @@ void initMacros(void) {
   defineMacro("__riscv_div", "1");
   defineMacro("__riscv_float_abi_double", "1");
   defineMacro("__riscv_flen", "64");
+  defineMacro("__riscv_atomic", "1");
+
+  // 原子操作的内存序
+  defineMacro("__ATOMIC_RELAXED", "0");
+  defineMacro("__ATOMIC_CONSUME", "1");
+  defineMacro("__ATOMIC_ACQUIRE", "2");
+  defineMacro("__ATOMIC_RELEASE", "3");
+  defineMacro("__ATOMIC_ACQ_REL", "4");
+  defineMacro("__ATOMIC_SEQ_CST", "5");
 
   addBuiltin("__FILE__", fileMacro);
   addBuiltin("__LINE__", lineMacro);
@@ -1329,13 +1403,7 @@ void initMacros(void) {
   addBuiltin("__BASE_FILE__", baseFileMacro);
 
   // 支持__DATE__和__TIME__
-  time_t Now = time(NULL);
-  // 获取当前的本地时区的时间
-  struct tm *Tm = localtime(&Now);
-  // 定义__DATE__为当前日期
-  defineMacro("__DATE__", formatDate(Tm));
-  // 定义__DATE__为当前时间
-  defineMacro("__TIME__", formatTime(Tm));
+  defineDateMacros();
 }
 
 // 字符串类型
@@ -1431,7 +1499,7 @@ static void joinAdjacentStringLiterals(Token *Tok) {
       Len = Len + T->Ty->ArrayLen - 1;
 
     // 开辟Len个字符长度的空间
-    char *Buf = calloc(Tok1->Ty->Base->Size, Len);
+    char *Buf = allocMem(MEM_STRING, Tok1->Ty->Base->Size * Len);
 
     // 遍历写入每个字符串的内容
     int I = 0;
@@ -0,0 +1,311 @@
+#include "rvcc.h"
+#include <fcntl.h>
+#include <sys/resource.h>
+
+// 编译统计，-ftime-report[=FILE]
+// 每条统计输出为一行JSON（JSON Lines），便于用脚本长期跟踪：
+//   cc1输出各编译阶段的墙钟时间和CPU时间，以及终结符、宏展开、AST节点和指令的数量
+//   驱动程序输出每个子进程（cc1、as、ld）的墙钟时间和CPU时间
+// -fmem-report[=FILE]以同样的格式输出cc1按对象种类和编译阶段统计的内存分配、
+// 各区域分配的块，以及进程的峰值常驻内存。
+// 未指定文件时输出到标准错误，指定文件时追加到文件末尾。
+// 每条统计用一次write写入，并行编译的多个进程的输出不会交错。
+
+// 编译统计的计数器
+CompileCounters Counters;
+
+// 编译阶段的名称
+static char *PhaseNames[] = {
+    [PHASE_OTHER] = "other",       [PHASE_TOKENIZE] = "tokenize",
+    [PHASE_PREPROCESS] = "preprocess", [PHASE_CACHE] = "cache",
+    [PHASE_PARSE] = "parse",       [PHASE_OPTIMIZE] = "optimize",
+    [PHASE_CODEGEN] = "codegen",   [PHASE_ASSEMBLE] = "assemble",
+    [PHASE_OUTPUT] = "output",
+};
+
+// 当前的编译阶段
+static CompilePhase CurPhase;
+// 各阶段累计的墙钟时间和CPU时间，纳秒
+static int64_t PhaseWall[PHASE_NUM];
+static int64_t PhaseCPU[PHASE_NUM];
+// 开始统计的时间
+static int64_t StartWall;
+static int64_t StartCPU;
+// 上次切换阶段的时间
+static int64_t LastWall;
+static int64_t LastCPU;
+
+// 单调时钟的纳秒数
+int64_t nowNs(void) {
+  struct timespec TS;
+  clock_gettime(CLOCK_MONOTONIC, &TS);
+  return TS.tv_sec * 1000000000LL + TS.tv_nsec;
+}
+
+// 当前进程所用CPU时间的纳秒数
+static int64_t cpuNs(void) {
+  struct timespec TS;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &TS);
+  return TS.tv_sec * 1000000000LL + TS.tv_nsec;
+}
+
+// 开始统计cc1，清除从驱动程序继承的统计
+void startTimeReport(void) {
+  memset(PhaseWall, 0, sizeof(PhaseWall));
+  memset(PhaseCPU, 0, sizeof(PhaseCPU));
+  memset(&Counters, 0, sizeof(Counters));
+  CurPhase = PHASE_OTHER;
+  StartWall = LastWall = nowNs();
+  StartCPU = LastCPU = cpuNs();
+}
+
+// 进入编译阶段，返回之前的阶段，用于嵌套的阶段结束时恢复
+// 时间只计入当前所处的阶段，例如#include中的词法分析不计入预处理
+CompilePhase enterPhase(CompilePhase P) {
+  CompilePhase Old = CurPhase;
+  if (OptFTimeReport && P != Old) {
+    int64_t Wall = nowNs();
+    int64_t CPU = cpuNs();
+    PhaseWall[Old] += Wall - LastWall;
+    PhaseCPU[Old] += CPU - LastCPU;
+    LastWall = Wall;
+    LastCPU = CPU;
+  }
+  CurPhase = P;
+  return Old;
+}
+
+// 当前的编译阶段，用于按阶段统计内存分配
+CompilePhase currentPhase(void) { return CurPhase; }
+
+// 输出JSON字符串
+void printJSONString(FILE *Out, char *S) {
+  fputc('"', Out);
+  for (; *S; S++) {
+    unsigned char C = *S;
+    if (C == '"' || C == '\\')
+      fprintf(Out, "\\%c", C);
+    else if (C < 0x20)
+      fprintf(Out, "\\u%04x", C);
+    else
+      fputc(C, Out);
+  }
+  fputc('"', Out);
+}
+
+// 向Path写入一条统计，用一次write写入，Path为"-"时写入标准错误
+static void writeReport(char *Path, char *Buf, size_t Len) {
+  int FD = STDERR_FILENO;
+  if (strcmp(Path, "-")) {
+    FD = open(Path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    if (FD == -1)
+      error("cannot open %s: %s", Path, strerror(errno));
+  }
+  write(FD, Buf, Len);
+  if (FD != STDERR_FILENO)
+    close(FD);
+}
+
+// 输出cc1的统计，Input为输入文件
+void timeReportCC1(char *Input) {
+  // 将当前阶段的时间计入统计
+  enterPhase(PHASE_OTHER);
+
+  char *Buf;
+  size_t Len;
+  FILE *Out = open_memstream(&Buf, &Len);
+  fprintf(Out, "{\"process\":\"cc1\",\"input\":");
+  printJSONString(Out, Input);
+  fprintf(Out, ",\"wall_us\":%ld,\"cpu_us\":%ld,\"phases\":{",
+          (nowNs() - StartWall) / 1000, (cpuNs() - StartCPU) / 1000);
+  for (int I = 0; I < PHASE_NUM; I++)
+    fprintf(Out, "%s\"%s\":{\"wall_us\":%ld,\"cpu_us\":%ld}", I ? "," : "",
+            PhaseNames[I], PhaseWall[I] / 1000, PhaseCPU[I] / 1000);
+  fprintf(Out,
+          "},\"counters\":{\"tokens\":%ld,\"macro_expansions\":%ld,"
+          "\"ast_nodes\":%ld,\"instructions\":%ld}}\n",
+          Counters.Tokens, Counters.MacroExpansions, Counters.Nodes,
+          Counters.Insns);
+  fclose(Out);
+  writeReport(OptFTimeReport, Buf, Len);
+  free(Buf);
+}
+
+// 输出驱动程序中子进程的统计
+// Name为程序名，File为其处理的文件，Status为退出状态，时间均为纳秒
+void timeReportSubprocess(char *Name, char *File, int Status, int64_t WallNs,
+                          int64_t UserNs, int64_t SysNs) {
+  char *Buf;
+  size_t Len;
+  FILE *Out = open_memstream(&Buf, &Len);
+  fprintf(Out, "{\"process\":\"driver\",\"subprocess\":");
+  printJSONString(Out, Name);
+  fprintf(Out, ",\"file\":");
+  printJSONString(Out, File ? File : "");
+  fprintf(Out,
+          ",\"status\":%d,\"wall_us\":%ld,\"user_us\":%ld,\"sys_us\":%ld}\n",
+          Status, WallNs / 1000, UserNs / 1000, SysNs / 1000);
+  fclose(Out);
+  writeReport(OptFTimeReport, Buf, Len);
+  free(Buf);
+}
+
+// 对象种类的名称
+static char *MemKindNames[] = {
+    [MEM_TOKEN] = "tokens", [MEM_HIDESET] = "hidesets", [MEM_NODE] = "nodes",
+    [MEM_TYPE] = "types",   [MEM_SCOPE] = "scopes",     [MEM_OBJ] = "objects",
+    [MEM_STRING] = "strings", [MEM_FILE] = "files",     [MEM_OTHER] = "other",
+};
+
+// 区域的名称
+static char *ArenaNames[] = {
+    [ARENA_TOKEN] = "token",   [ARENA_AST] = "ast",     [ARENA_TYPE] = "type",
+    [ARENA_STRING] = "string", [ARENA_OTHER] = "other",
+};
+
+// 输出内存统计的一项
+static void printMemCount(FILE *Out, char *Name, MemCount *C) {
+  fprintf(Out, "\"%s\":{\"count\":%ld,\"bytes\":%ld}", Name, C->Count,
+          C->Bytes);
+}
+
+// 输出cc1的内存统计，Input为输入文件
+void memReportCC1(char *Input) {
+  MemCount Total = {0};
+  for (int I = 0; I < MEM_KIND_NUM; I++) {
+    Total.Count += MemKinds[I].Count;
+    Total.Bytes += MemKinds[I].Bytes;
+  }
+
+  // 峰值常驻内存，单位为KB
+  struct rusage RU;
+  getrusage(RUSAGE_SELF, &RU);
+
+  char *Buf;
+  size_t Len;
+  FILE *Out = open_memstream(&Buf, &Len);
+  fprintf(Out, "{\"process\":\"cc1\",\"input\":");
+  printJSONString(Out, Input);
+  fprintf(Out, ",\"peak_rss_kb\":%ld,", RU.ru_maxrss);
+  printMemCount(Out, "total", &Total);
+  fprintf(Out, ",\"kinds\":{");
+  for (int I = 0; I < MEM_KIND_NUM; I++) {
+    fprintf(Out, I ? "," : "");
+    printMemCount(Out, MemKindNames[I], &MemKinds[I]);
+  }
+  fprintf(Out, "},\"phases\":{");
+  for (int I = 0; I < PHASE_NUM; I++) {
+    fprintf(Out, I ? "," : "");
+    printMemCount(Out, PhaseNames[I], &MemPhases[I]);
+  }
+  // 各区域分配的块，count为块数，bytes为块的总字节数
+  fprintf(Out, "},\"arenas\":{");
+  for (int I = 0; I < ARENA_NUM; I++) {
+    fprintf(Out, I ? "," : "");
+    printMemCount(Out, ArenaNames[I], &ArenaChunks[I]);
+  }
+  fprintf(Out, "}}\n");
+  fclose(Out);
+  writeReport(OptFMemReport, Buf, Len);
+  free(Buf);
+}
+
+// 编译活动的跟踪，-ftrace=FILE
+// 输出为Chrome的跟踪事件格式（Trace Event Format），可以在chrome://tracing
+// 或Perfetto中查看。文件为JSON数组，每个事件占一行，驱动程序和各个cc1
+// 将事件追加写入同一个文件；时间戳为单调时钟的微秒数，不同进程的事件可以对齐。
+// 创建文件的进程在退出时写入结尾的"]"，此前文件只缺少结尾，查看器仍可读取。
+
+// 缓冲区中的事件
+static FILE *TraceBuf;
+static char *TraceData;
+static size_t TraceLen;
+// 进程在跟踪中显示的名称
+static char *TraceName;
+// 创建文件的进程
+static pid_t TraceOwner;
+// 是否已经写入了进程名称
+static bool TraceNamed;
+
+// 获取事件的缓冲区
+static FILE *traceBuf(void) {
+  if (!TraceBuf)
+    TraceBuf = open_memstream(&TraceData, &TraceLen);
+  return TraceBuf;
+}
+
+// 打开跟踪文件，用于追加
+static int openTrace(int Flags) {
+  int FD = open(OptFTrace, O_WRONLY | O_CREAT | Flags, 0666);
+  if (FD == -1)
+    error("cannot open %s: %s", OptFTrace, strerror(errno));
+  return FD;
+}
+
+// 输出进程名称的元数据事件
+static void printProcessName(FILE *Out) {
+  fprintf(Out, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{"
+               "\"name\":",
+          getpid());
+  printJSONString(Out, TraceName);
+  fprintf(Out, "}}");
+}
+
+// 开始跟踪，Name为进程在跟踪中显示的名称
+// Owner为真时清空文件，由当前进程在退出时写入结尾；
+// 否则为fork出的cc1，丢弃从父进程继承的缓冲区
+void startTrace(char *Name, bool Owner) {
+  TraceBuf = NULL;
+  TraceName = Name;
+  TraceNamed = false;
+  if (!Owner)
+    return;
+  TraceOwner = getpid();
+  int FD = openTrace(O_TRUNC);
+  write(FD, "[\n", 2);
+  close(FD);
+}
+
+// 记录当前进程中[Start, End)的区间，时间均为纳秒
+void traceSpan(char *Cat, char *Name, int64_t Start, int64_t End) {
+  traceSubprocess(getpid(), Cat, Name, Start, End);
+}
+
+// 记录子进程Pid在[Start, End)的区间，显示为当前进程中的一个线程
+void traceSubprocess(pid_t Pid, char *Cat, char *Name, int64_t Start,
+                     int64_t End) {
+  FILE *Out = traceBuf();
+  fprintf(Out, "{\"ph\":\"X\",\"cat\":\"%s\",\"name\":", Cat);
+  printJSONString(Out, Name);
+  fprintf(Out, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f},\n", getpid(),
+          Pid, Start / 1e3, (End - Start) / 1e3);
+}
+
+// 将缓冲区中的事件写入文件，用一次write写入
+void flushTrace(void) {
+  FILE *Out = traceBuf();
+  // 创建文件的进程的名称作为最后一个事件，在退出时写入
+  if (!TraceNamed && getpid() != TraceOwner) {
+    printProcessName(Out);
+    fprintf(Out, ",\n");
+    TraceNamed = true;
+  }
+  fclose(Out);
+  TraceBuf = NULL;
+
+  int FD = openTrace(O_APPEND);
+  write(FD, TraceData, TraceLen);
+  close(FD);
+  free(TraceData);
+}
+
+// 结束跟踪，创建文件的进程写入结尾
+void endTrace(void) {
+  if (getpid() != TraceOwner)
+    return;
+  FILE *Out = traceBuf();
+  printProcessName(Out);
+  fprintf(Out, "\n]\n");
+  TraceNamed = true;
+  flushTrace();
+}
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <glob.h>
 #include <libgen.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -141,6 +142,8 @@ Token *tokenizeFile(char *Path);
 // 搜索引入路径区
 char *searchIncludePaths(char *Filename);
 void initMacros(void);
+char *detectIncludeGuard(Token *Tok);
+void defineDateMacros(void);
 void defineMacro(char *Name, char *Buf);
 void undefMacro(char *Name);
 Token *preprocess(Token *Tok);
@@ -159,7 +162,10 @@ struct Obj {
   bool IsLocal; // 是 局部或全局 变量
   int Align;    // 对齐量
   // 局部变量
-  int Offset; // fp的偏移量
+  int Offset;       // fp的偏移量
+  bool IsAddrTaken; // 地址是否被获取，可能通过指针访问
+  bool IsUsed;      // 死代码消除：是否仍被引用
+  bool IsDead;      // 死代码消除：当前位置之后是否不再被读取
 
   // 结构体类型
   bool IsHalfByStack; // 一半用寄存器，一半用栈
@@ -168,21 +174,29 @@ struct Obj {
   bool IsFunction;
   bool IsDefinition; // 是否为函数定义
   bool IsStatic;     // 是否为文件域内的
+  char *Visibility;  // 符号可见性，NULL为default
 
   // 全局变量
   bool IsTentative; // 是否为试探性的变量
   bool IsTLS;       // 是否为线程局部存储，Thread Local Storage
   char *InitData;   // 用于初始化的数据
   Relocation *Rel;  // 指向其他全局变量的指针
+  bool IsStrLit;    // 是否为字符串字面量
 
   // 函数
   bool IsInline;     // 内联
+  bool IsHot;        // 热函数
+  bool IsCold;       // 冷函数
+  bool IsNoreturn;   // 不返回的函数
+  bool IsNoInstr;    // 不进行插桩的函数
+  bool HasAsm;       // 是否含有内联汇编
   Obj *Params;       // 形参
   Node *Body;        // 函数体
   Obj *Locals;       // 本地变量
   Obj *VaArea;       // 可变参数区域
   Obj *AllocaBottom; // Alloca区域底部
   int StackSize;     // 栈大小
+  Obj *RetVar;       // 具名返回值优化的局部变量
 
   // 静态内联函数
   bool IsLive;      // 函数是否存活
@@ -249,9 +263,35 @@ typedef enum {
   ND_MEMZERO,   // 栈中变量清零
   ND_ASM,       // "asm"汇编
   ND_CAS,       // 原子比较交换
-  ND_EXCH,      // 原子交换
+  ND_ATOM_LD,   // 原子读取
+  ND_ATOM_ST,   // 原子写入
+  ND_ATOM_RMW,  // 原子读改写
+  ND_FENCE,     // 内存屏障
 } NodeKind;
 
+// 原子读改写的运算
+typedef enum {
+  AO_XCHG, // 交换
+  AO_ADD,  // 加
+  AO_SUB,  // 减
+  AO_AND,  // 按位与
+  AO_OR,   // 按位或
+  AO_XOR,  // 按位异或
+  AO_NAND, // 按位与非
+  AO_MAX,  // 最大值
+  AO_MIN,  // 最小值
+} AtomicOp;
+
+// 内存序，与__ATOMIC_*宏的值一致
+typedef enum {
+  MO_RELAXED,
+  MO_CONSUME,
+  MO_ACQUIRE,
+  MO_RELEASE,
+  MO_ACQ_REL,
+  MO_SEQ_CST,
+} MemOrder;
+
 // AST中二叉树节点
 struct Node {
   NodeKind Kind; // 节点种类
@@ -296,8 +336,9 @@ struct Node {
   Node *DefaultCase;
 
   // Case语句
-  long Begin; // case后面的数值
-  long End;   // case ...后面的数值
+  long Begin;  // case后面的数值
+  long End;    // case ...后面的数值
+  int ProfIdx; // case的剖析计数器编号
 
   // "asm" 字符串字面量
   char *AsmStr;
@@ -307,6 +348,14 @@ struct Node {
   Node *CasOld;  // 旧值
   Node *CasNew;  // 新值
 
+  // 原子操作
+  AtomicOp AtomOp; // 读改写的运算
+  bool RetOld;     // 是否返回操作前的值
+  MemOrder Order;  // 内存序
+
+  // Sethi-Ullman标号，计算子树所需的寄存器数量，0为未计算
+  int RegNeed;
+
   Obj *Var;         // 存储ND_VAR种类的变量
   int64_t Val;      // 存储ND_NUM种类的值
   long double FVal; // 存储ND_NUM种类的浮点值
@@ -349,6 +398,8 @@ struct Type {
   int Align;       // 对齐
   bool IsUnsigned; // 是否为无符号的
   bool IsAtomic;   // 为 _Atomic 则为真
+  bool IsConst;    // 为 const 则为真
+  bool IsVolatile; // 为 volatile 则为真
   Type *Origin;    // 原始类型，用于兼容性检查
 
   // 指针
@@ -440,6 +491,13 @@ Type *structType(void);
 // 函数类型
 Type *funcType(Type *ReturnTy);
 
+//
+// optimize 优化
+//
+
+// 对局部变量进行死代码和死存储消除
+void optimize(Obj *Prog);
+
 //
 // 语义分析与代码生成
 //
@@ -450,6 +508,160 @@ int alignTo(int N, int Align);
 bool isIdent1_1(uint32_t C);
 bool isIdent2_1(uint32_t C);
 
+//
+// asm 集成汇编器
+//
+
+// 开始汇编
+void asmBegin(void);
+// 按照printf格式的Fmt和参数汇编，返回汇编的指令数
+int asmEmit(char *Fmt, va_list VA);
+// 汇编一段汇编代码
+void asmText(char *Text);
+// 结束汇编，将可重定位文件写入到缓冲区中
+void asmEnd(char **Buf, size_t *Len);
+// 将汇编代码汇编为RISC-V的ELF可重定位文件，写入到缓冲区中
+// 遇到不支持的指令或汇编指示时返回false
+bool assembleObj(char *Text, char **Buf, size_t *Len);
+
+//
+// cache 编译缓存
+//
+
+// 计算缓存的键
+char *cacheKey(Token *Tok, char *Options, char *DataFile);
+// 查找缓存项，命中时返回缓存的内容
+char *cacheLookup(char *Dir, char *Key, size_t *Len, int64_t *Ns);
+// 写入缓存项
+void cacheStore(char *Dir, char *Key, char *Buf, size_t Len, int64_t Ns);
+// 更新缓存的统计信息
+void cacheUpdateStats(char *Dir, bool Hit, int64_t SavedNs);
+// 打印缓存的统计信息
+void cachePrintStats(char *Dir);
+// 读取整个文件，失败时返回NULL
+char *readAll(char *Path, size_t *Len);
+
+//
+// server 编译服务器
+//
+
+// 是否为编译服务器中处理请求的子进程
+extern bool InServer;
+// 运行编译服务器，只在处理请求的子进程中返回，参数替换为请求的参数
+void runServer(char *Path, int *Argc, char ***Argv);
+// 将参数转发给编译服务器，返回编译的退出状态
+int runClient(char *Path, int Argc, char **Argv);
+// 向编译服务器报告可以缓存的内容
+void serverReport(char *Fmt, ...) __attribute__((format(printf, 1, 2)));
+// 编译服务器缓存词法分析后的文件
+void warmFile(char *Path, int64_t MTime, int64_t Size);
+// 编译服务器中已缓存的文件的头文件保护宏
+char *warmIncludeGuard(char *Path);
+
+//
+// report 编译统计
+//
+
+// 编译阶段
+typedef enum {
+  PHASE_OTHER,      // 其他
+  PHASE_TOKENIZE,   // 词法分析
+  PHASE_PREPROCESS, // 预处理
+  PHASE_CACHE,      // 查找编译缓存
+  PHASE_PARSE,      // 语法分析
+  PHASE_OPTIMIZE,   // 优化
+  PHASE_CODEGEN,    // 代码生成
+  PHASE_ASSEMBLE,   // 集成汇编器
+  PHASE_OUTPUT,     // 写入输出文件
+  PHASE_NUM,        // 阶段的数量
+} CompilePhase;
+
+// 编译统计的计数器
+typedef struct {
+  int64_t Tokens;          // 词法分析生成的终结符
+  int64_t MacroExpansions; // 宏展开
+  int64_t Nodes;           // AST节点
+  int64_t Insns;           // 生成的指令
+} CompileCounters;
+
+extern CompileCounters Counters;
+
+// 单调时钟的纳秒数
+int64_t nowNs(void);
+// 开始统计cc1
+void startTimeReport(void);
+// 进入编译阶段，返回之前的阶段
+CompilePhase enterPhase(CompilePhase P);
+// 当前的编译阶段
+CompilePhase currentPhase(void);
+// 输出JSON字符串
+void printJSONString(FILE *Out, char *S);
+// 输出cc1的统计
+void timeReportCC1(char *Input);
+// 输出驱动程序中子进程的统计
+void timeReportSubprocess(char *Name, char *File, int Status, int64_t WallNs,
+                          int64_t UserNs, int64_t SysNs);
+// 输出cc1的内存统计
+void memReportCC1(char *Input);
+// 开始跟踪编译活动
+void startTrace(char *Name, bool Owner);
+// 记录当前进程中的区间
+void traceSpan(char *Cat, char *Name, int64_t Start, int64_t End);
+// 记录子进程的区间
+void traceSubprocess(pid_t Pid, char *Cat, char *Name, int64_t Start,
+                     int64_t End);
+// 将跟踪事件写入文件
+void flushTrace(void);
+// 结束跟踪
+void endTrace(void);
+
+//
+// alloc 内存分配
+//
+
+// 分配的对象的种类
+typedef enum {
+  MEM_TOKEN,    // 终结符
+  MEM_HIDESET,  // 宏展开的隐藏集
+  MEM_NODE,     // AST节点
+  MEM_TYPE,     // 类型
+  MEM_SCOPE,    // 域和变量域
+  MEM_OBJ,      // 变量、函数、成员、初始化器
+  MEM_STRING,   // 字符串
+  MEM_FILE,     // 源文件的内容
+  MEM_OTHER,    // 其他
+  MEM_KIND_NUM, // 种类的数量
+} MemKind;
+
+// 分配对象的区域
+typedef enum {
+  ARENA_TOKEN,  // 终结符和隐藏集
+  ARENA_AST,    // AST节点、域、变量和成员
+  ARENA_TYPE,   // 类型
+  ARENA_STRING, // 字符串
+  ARENA_OTHER,  // 其他
+  ARENA_NUM,    // 区域的数量
+} MemArena;
+
+// 分配的次数和字节数
+typedef struct {
+  int64_t Count;
+  int64_t Bytes;
+} MemCount;
+
+extern MemCount MemKinds[MEM_KIND_NUM];
+extern MemCount MemPhases[PHASE_NUM];
+extern MemCount ArenaChunks[ARENA_NUM];
+
+// 分配清零的内存，并计入内存统计
+void *allocMem(MemKind Kind, size_t Size);
+// 在字符串区域中分配内存
+char *allocString(size_t Size);
+// 计入内存统计
+void countMem(MemKind Kind, size_t Size);
+// 清除内存统计
+void resetMemCounts(void);
+
 //
 // unicode 统一码
 //
@@ -494,10 +706,44 @@ void hashmapTest(void);
 // 判断文件存在
 bool fileExists(char *Path);
 
+// 线程局部存储的访问模型，按照从通用到高效的顺序排列
+typedef enum {
+  TLS_GLOBAL_DYNAMIC, // 通过__tls_get_addr获取地址
+  TLS_LOCAL_DYNAMIC,  // RISC-V中与global-dynamic相同
+  TLS_INITIAL_EXEC,   // 从GOT中读取相对于tp的偏移量
+  TLS_LOCAL_EXEC,     // 链接时确定相对于tp的偏移量
+} TLSModel;
+
 // 引入路径区
 extern StringArray IncludePaths;
 // 位置无关代码的标记
 extern bool OptFPIC;
+// 通过PLT调用外部函数
+extern bool OptFPLT;
+// 浮点乘加融合的标记
+extern bool OptFPContract;
+// -ftls-model指定的线程局部存储访问模型
+extern TLSModel OptTLSModel;
+// 小数据段的大小阈值
+extern int OptG;
+// 每个函数使用单独的段
+extern bool OptFFunctionSections;
+// 每个全局变量使用单独的段
+extern bool OptFDataSections;
+// -fprofile-generate写出的剖析数据文件
+extern char *OptFProfileGenerate;
+// -fprofile-use读入的剖析数据文件
+extern char *OptFProfileUse;
+// 在函数入口和出口调用__cyg_profile_func_enter/exit
+extern bool OptFInstrumentFunctions;
+// 在函数入口调用_mcount，-pg选项
+extern bool OptPG;
 // 标记是否生成common块
 extern bool OptFCommon;
+// -ftime-report输出统计的文件，"-"为标准错误
+extern char *OptFTimeReport;
+// -ftrace输出跟踪事件的文件
+extern char *OptFTrace;
+// -fmem-report输出内存统计的文件，"-"为标准错误
+extern char *OptFMemReport;
 extern char *BaseFile;
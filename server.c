@@ -0,0 +1,403 @@
+// 使用了SO_PEERCRED和struct ucred
+#define _GNU_SOURCE
+#include "rvcc.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// 编译服务器，rvcc --server[=SOCKET]
+// 服务器在本地Unix套接字上等待rvcc --client[=SOCKET]转发的参数，
+// 每个请求由fork出的子进程按照普通的rvcc处理。子进程继承了服务器中
+// 已经词法分析过的文件，只需复制终结符和检查文件是否改变。
+// 子进程通过管道报告新词法分析的文件，服务器在请求结束后将其缓存，
+// 供之后的请求使用，常用的系统头文件只需词法分析一次。
+// 文件以设备号和inode号识别，客户端的相对路径不会混淆不同项目中的文件。
+//
+// 引入文件的搜索结果不在请求间共享：前面的引入路径中可能新增了同名文件，
+// 验证搜索结果需要重新检查前面的所有路径，与重新搜索相同。
+//
+// 客户端通过SCM_RIGHTS传递自身的标准输入、标准输出和标准错误，
+// 子进程的输出直接写给客户端，服务器只返回退出状态。
+// 请求在子进程中读取，不发送请求的客户端不会阻塞服务器。
+//
+// 服务器和客户端都通过SO_PEERCRED检查另一端属于同一用户，
+// 默认的套接字位于只有当前用户可以访问的目录中。
+//
+// #pragma once记录的是当前翻译单元已经引入过的文件，不能在请求间共享，
+// 每个请求都从空的记录开始。头文件保护宏只取决于文件的内容，
+// 与终结符一起缓存，保护宏已定义时直接跳过文件，不需要复制终结符。
+
+// 是否为编译服务器中处理请求的子进程
+bool InServer;
+
+// 子进程中向服务器报告的管道
+static int ReportFd = -1;
+
+// 服务器中正在处理的请求
+typedef struct Request Request;
+struct Request {
+  Request *Next; // 下一个请求
+  pid_t Pid;     // 处理请求的子进程
+  int Client;    // 与客户端的连接
+  int Report;    // 子进程报告的管道
+  char *Buf;     // 已读取的报告
+  size_t Len;    // 报告的长度
+  size_t Cap;    // 报告缓冲区的大小
+};
+
+// 套接字的路径，服务器退出时删除
+static char *SocketPath;
+
+// 默认的套接字路径
+// 优先使用$XDG_RUNTIME_DIR，否则使用/tmp下当前用户私有的目录
+static char *defaultSocket(void) {
+  char *Dir = getenv("XDG_RUNTIME_DIR");
+  if (Dir && *Dir)
+    return format("%s/rvcc.sock", Dir);
+
+  Dir = format("/tmp/rvcc-%d", (int)getuid());
+  if (mkdir(Dir, 0700) == -1 && errno != EEXIST)
+    error("cannot create %s: %s", Dir, strerror(errno));
+  // 目录可能已被其他用户创建
+  struct stat St;
+  if (lstat(Dir, &St) == -1 || !S_ISDIR(St.st_mode) ||
+      St.st_uid != getuid() || (St.st_mode & 077))
+    error("%s is not a private directory", Dir);
+  return format("%s/server.sock", Dir);
+}
+
+// 连接的另一端是否属于当前用户
+static bool samePeer(int FD) {
+  struct ucred Cred;
+  socklen_t Len = sizeof(Cred);
+  return getsockopt(FD, SOL_SOCKET, SO_PEERCRED, &Cred, &Len) == 0 &&
+         Cred.uid == getuid();
+}
+
+// 套接字的地址
+static struct sockaddr_un socketAddr(char *Path) {
+  struct sockaddr_un Addr = {.sun_family = AF_UNIX};
+  if (strlen(Path) >= sizeof(Addr.sun_path))
+    error("socket path too long: %s", Path);
+  strcpy(Addr.sun_path, Path);
+  return Addr;
+}
+
+// 读取Len个字节，连接关闭时返回假
+static bool readFull(int FD, void *Buf, size_t Len) {
+  char *P = Buf;
+  while (Len > 0) {
+    ssize_t N = read(FD, P, Len);
+    if (N == -1 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    P += N;
+    Len -= N;
+  }
+  return true;
+}
+
+// 写入Len个字节，失败时返回假
+static bool writeFull(int FD, void *Buf, size_t Len) {
+  char *P = Buf;
+  while (Len > 0) {
+    ssize_t N = write(FD, P, Len);
+    if (N == -1 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    P += N;
+    Len -= N;
+  }
+  return true;
+}
+
+// 向编译服务器报告可以缓存的内容
+// 每条记录用一次write写入，不超过PIPE_BUF时多个进程的记录不会交错
+void serverReport(char *Fmt, ...) {
+  if (ReportFd == -1)
+    return;
+  char Buf[PIPE_BUF];
+  va_list VA;
+  va_start(VA, Fmt);
+  int Len = vsnprintf(Buf, sizeof(Buf), Fmt, VA);
+  va_end(VA);
+  if (Len > 0 && Len < sizeof(Buf))
+    write(ReportFd, Buf, Len);
+}
+
+// 缓存子进程报告的内容，每行一条记录，字段以制表符分隔：
+//   F 修改时间 大小 绝对路径：词法分析过的文件
+static void learn(char *Buf, size_t Len) {
+  char *End = Buf + Len;
+  while (Buf < End) {
+    char *NL = memchr(Buf, '\n', End - Buf);
+    if (!NL)
+      return;
+    *NL = '\0';
+
+    char *F[4] = {0};
+    int N = 0;
+    for (char *P = Buf; N < 4; N++) {
+      F[N] = P;
+      // 最后一个字段可以包含任意字符
+      if (N == 3 || !(P = strchr(P, '\t')))
+        break;
+      *P++ = '\0';
+    }
+
+    if (!strcmp(F[0], "F") && F[3])
+      warmFile(F[3], strtoll(F[1], NULL, 10), strtoll(F[2], NULL, 10));
+    Buf = NL + 1;
+  }
+}
+
+// 读取子进程的报告，子进程结束时返回假
+static bool readReport(Request *R) {
+  if (R->Cap - R->Len < 4096) {
+    R->Cap = R->Cap * 2 + 4096;
+    R->Buf = realloc(R->Buf, R->Cap);
+  }
+  ssize_t N = read(R->Report, R->Buf + R->Len, R->Cap - R->Len);
+  if (N == -1 && (errno == EINTR || errno == EAGAIN))
+    return true;
+  if (N <= 0)
+    return false;
+  R->Len += N;
+  return true;
+}
+
+// 接收客户端的请求：标准输入输出的文件描述符，工作目录和参数
+// 格式为：长度 工作目录\0argv[0]\0参数\0参数\0...
+static char *recvRequest(int Client, int Fds[3], size_t *Len) {
+  uint32_t N;
+  struct iovec IO = {.iov_base = &N, .iov_len = sizeof(N)};
+  char Ctl[CMSG_SPACE(3 * sizeof(int))];
+  struct msghdr Msg = {.msg_iov = &IO,
+                       .msg_iovlen = 1,
+                       .msg_control = Ctl,
+                       .msg_controllen = sizeof(Ctl)};
+  if (recvmsg(Client, &Msg, 0) != sizeof(N))
+    return NULL;
+
+  struct cmsghdr *C = CMSG_FIRSTHDR(&Msg);
+  if (!C || C->cmsg_level != SOL_SOCKET || C->cmsg_type != SCM_RIGHTS ||
+      C->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+    return NULL;
+  memcpy(Fds, CMSG_DATA(C), 3 * sizeof(int));
+
+  char *Buf = calloc(1, N + 1);
+  if (!readFull(Client, Buf, N)) {
+    for (int I = 0; I < 3; I++)
+      close(Fds[I]);
+    free(Buf);
+    return NULL;
+  }
+  *Len = N;
+  return Buf;
+}
+
+// 服务器退出时删除套接字
+static void stopServer(int Sig) {
+  unlink(SocketPath);
+  _exit(0);
+}
+
+// 运行编译服务器，Path为套接字的路径，NULL时使用默认路径
+// 只在处理请求的子进程中返回，Argc和Argv替换为请求的参数
+void runServer(char *Path, int *Argc, char ***Argv) {
+  SocketPath = Path ? Path : defaultSocket();
+  struct sockaddr_un Addr = socketAddr(SocketPath);
+
+  int Listen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (Listen == -1)
+    error("socket failed: %s", strerror(errno));
+  // 已有的套接字能够连接时，说明已有服务器在运行，否则删除残留的套接字
+  if (connect(Listen, (struct sockaddr *)&Addr, sizeof(Addr)) == 0)
+    error("server already running on %s", SocketPath);
+  unlink(SocketPath);
+  if (bind(Listen, (struct sockaddr *)&Addr, sizeof(Addr)) == -1 ||
+      listen(Listen, 64) == -1)
+    error("cannot listen on %s: %s", SocketPath, strerror(errno));
+
+  signal(SIGINT, stopServer);
+  signal(SIGTERM, stopServer);
+  // 客户端提前断开时不退出
+  signal(SIGPIPE, SIG_IGN);
+
+  Request *Reqs = NULL;
+  for (;;) {
+    // 等待新的连接，以及子进程的报告
+    int NR = 0;
+    for (Request *R = Reqs; R; R = R->Next)
+      NR++;
+    struct pollfd *PFds = calloc(NR + 1, sizeof(struct pollfd));
+    PFds[0] = (struct pollfd){.fd = Listen, .events = POLLIN};
+    int I = 1;
+    for (Request *R = Reqs; R; R = R->Next)
+      PFds[I++] = (struct pollfd){.fd = R->Report, .events = POLLIN};
+    if (poll(PFds, NR + 1, -1) == -1) {
+      free(PFds);
+      if (errno == EINTR)
+        continue;
+      error("poll failed: %s", strerror(errno));
+    }
+
+    // 读取子进程的报告，管道关闭时请求处理完毕
+    I = 1;
+    for (Request **Cur = &Reqs; *Cur; I++) {
+      Request *R = *Cur;
+      if (!(PFds[I].revents & (POLLIN | POLLHUP | POLLERR)) || readReport(R)) {
+        Cur = &R->Next;
+        continue;
+      }
+
+      // 返回退出状态，被信号终止时与shell一致
+      int Status;
+      while (waitpid(R->Pid, &Status, 0) == -1 && errno == EINTR)
+        ;
+      uint32_t Ret = WIFEXITED(Status) ? WEXITSTATUS(Status)
+                                       : 128 + WTERMSIG(Status);
+      writeFull(R->Client, &Ret, sizeof(Ret));
+      close(R->Client);
+      close(R->Report);
+
+      learn(R->Buf, R->Len);
+      *Cur = R->Next;
+      free(R->Buf);
+      free(R);
+    }
+    bool NewClient = PFds[0].revents & POLLIN;
+    free(PFds);
+    if (!NewClient)
+      continue;
+
+    // 接受新的连接，只处理当前用户的请求
+    int Client = accept(Listen, NULL, NULL);
+    if (Client == -1)
+      continue;
+    int Pipe[2];
+    if (!samePeer(Client) || pipe(Pipe) == -1) {
+      close(Client);
+      continue;
+    }
+
+    // 执行汇编器和链接器时关闭报告的管道
+    fcntl(Pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(Pipe[1], F_SETFD, FD_CLOEXEC);
+
+    // 避免缓冲区中的内容在子进程中被再次输出
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t Pid = fork();
+    if (Pid == 0) {
+      // 关闭服务器使用的文件描述符
+      close(Listen);
+      close(Pipe[0]);
+      for (Request *R = Reqs; R; R = R->Next) {
+        close(R->Client);
+        close(R->Report);
+      }
+      signal(SIGINT, SIG_DFL);
+      signal(SIGTERM, SIG_DFL);
+      signal(SIGPIPE, SIG_DFL);
+
+      // 接收请求，服务器在子进程结束后返回退出状态
+      int Fds[3];
+      size_t Len;
+      char *Buf = recvRequest(Client, Fds, &Len);
+      if (!Buf)
+        _exit(1);
+      close(Client);
+
+      // 使用客户端的标准输入输出
+      for (int J = 0; J < 3; J++) {
+        dup2(Fds[J], J);
+        close(Fds[J]);
+      }
+      if (chdir(Buf) == -1)
+        error("cannot change directory to %s: %s", Buf, strerror(errno));
+      InServer = true;
+      ReportFd = Pipe[1];
+
+      // 请求的参数，第一个参数为客户端的argv[0]
+      // 在客户端的工作目录中，与直接调用rvcc一样查找rvcc的引入文件
+      StringArray Args = {};
+      for (char *P = Buf + strlen(Buf) + 1; P < Buf + Len; P += strlen(P) + 1)
+        strArrayPush(&Args, P);
+      strArrayPush(&Args, NULL);
+      *Argc = Args.Len - 1;
+      *Argv = Args.Data;
+      return;
+    }
+
+    close(Pipe[1]);
+    if (Pid == -1) {
+      close(Pipe[0]);
+      close(Client);
+      continue;
+    }
+
+    Request *R = calloc(1, sizeof(Request));
+    R->Pid = Pid;
+    R->Client = Client;
+    R->Report = Pipe[0];
+    R->Next = Reqs;
+    Reqs = R;
+  }
+}
+
+// 将参数转发给编译服务器，Path为套接字的路径，NULL时使用默认路径
+// Argv[0]为客户端的argv[0]，返回编译的退出状态
+int runClient(char *Path, int Argc, char **Argv) {
+  if (!Path)
+    Path = defaultSocket();
+  struct sockaddr_un Addr = socketAddr(Path);
+
+  int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD == -1 ||
+      connect(FD, (struct sockaddr *)&Addr, sizeof(Addr)) == -1)
+    error("cannot connect to %s: %s", Path, strerror(errno));
+  // 不向其他用户的服务器发送参数和文件描述符
+  if (!samePeer(FD))
+    error("server on %s belongs to another user", Path);
+
+  // 工作目录和参数
+  char *Buf;
+  size_t Len;
+  FILE *Out = open_memstream(&Buf, &Len);
+  char *Cwd = getcwd(NULL, 0);
+  if (!Cwd)
+    error("getcwd failed: %s", strerror(errno));
+  fwrite(Cwd, 1, strlen(Cwd) + 1, Out);
+  for (int I = 0; I < Argc; I++)
+    fwrite(Argv[I], 1, strlen(Argv[I]) + 1, Out);
+  fclose(Out);
+
+  // 长度和标准输入输出的文件描述符一起发送
+  uint32_t N = Len;
+  struct iovec IO = {.iov_base = &N, .iov_len = sizeof(N)};
+  char Ctl[CMSG_SPACE(3 * sizeof(int))] = {0};
+  struct msghdr Msg = {.msg_iov = &IO,
+                       .msg_iovlen = 1,
+                       .msg_control = Ctl,
+                       .msg_controllen = sizeof(Ctl)};
+  struct cmsghdr *C = CMSG_FIRSTHDR(&Msg);
+  C->cmsg_level = SOL_SOCKET;
+  C->cmsg_type = SCM_RIGHTS;
+  C->cmsg_len = CMSG_LEN(3 * sizeof(int));
+  int Fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  memcpy(CMSG_DATA(C), Fds, sizeof(Fds));
+  if (sendmsg(FD, &Msg, 0) != sizeof(N) || !writeFull(FD, Buf, Len))
+    error("cannot send request to %s: %s", Path, strerror(errno));
+
+  uint32_t Ret;
+  if (!readFull(FD, &Ret, sizeof(Ret)))
+    error("server on %s closed the connection", Path);
+  close(FD);
+  return Ret;
+}
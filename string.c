@@ -25,19 +25,18 @@ void strArrayPush(StringArray *Arr, char *S) {
   Arr->Data[Arr->Len++] = S;
 }
 
-// 格式化后返回字符串
+// 格式化后返回字符串，字符串分配在字符串区域中
 char *format(char *Fmt, ...) {
-  char *Buf;
-  size_t BufLen;
-  // 将字符串对应的内存作为I/O流
-  FILE *Out = open_memstream(&Buf, &BufLen);
-
   va_list VA;
   va_start(VA, Fmt);
-  // 向流中写入数据
-  vfprintf(Out, Fmt, VA);
+  va_list VA2;
+  va_copy(VA2, VA);
+  // 先计算格式化后的长度，再写入分配的内存中
+  int Len = vsnprintf(NULL, 0, Fmt, VA);
   va_end(VA);
 
-  fclose(Out);
+  char *Buf = allocString(Len + 1);
+  vsnprintf(Buf, Len + 1, Fmt, VA2);
+  va_end(VA2);
   return Buf;
 }
@@ -60,6 +60,50 @@ int main() {
   ASSERT(3, ({ int x=3; atomic_exchange(&x, 5); }));
   ASSERT(5, ({ int x=3; atomic_exchange(&x, 5); x; }));
 
+  // 支持__atomic_*内建函数及内存序
+  ASSERT(3, ({ int x=3; atomic_fetch_add(&x, 4); }));
+  ASSERT(7, ({ int x=3; atomic_fetch_add(&x, 4); x; }));
+  ASSERT(-1, ({ int x=3; atomic_fetch_sub(&x, 4); x; }));
+  ASSERT(1, ({ int x=3; atomic_fetch_and(&x, 5); x; }));
+  ASSERT(7, ({ int x=3; atomic_fetch_or(&x, 5); x; }));
+  ASSERT(6, ({ int x=3; atomic_fetch_xor(&x, 5); x; }));
+  ASSERT(7, ({ long x=3; __atomic_add_fetch(&x, 4, __ATOMIC_RELAXED); }));
+  ASSERT(-2, ({ int x=3; __atomic_nand_fetch(&x, 5, __ATOMIC_ACQ_REL); }));
+  ASSERT(9, ({ int x=3; __atomic_fetch_max(&x, 9, __ATOMIC_SEQ_CST); x; }));
+  ASSERT(-4, ({ int x=3; __atomic_fetch_min(&x, -4, __ATOMIC_SEQ_CST); x; }));
+  ASSERT(3, ({ unsigned x=3; __atomic_min_fetch(&x, -4, __ATOMIC_SEQ_CST); }));
+
+  ASSERT(0x04050201, ({ char x[4]={1,2,3,4}; __atomic_fetch_add(&x[2], 2, __ATOMIC_SEQ_CST); *(int *)x; }));
+  ASSERT(-126, ({ signed char x[4]={1,2,127,4}; __atomic_add_fetch(&x[2], 3, __ATOMIC_SEQ_CST); }));
+  ASSERT(130, ({ unsigned char x[4]={1,2,127,4}; __atomic_add_fetch(&x[2], 3, __ATOMIC_SEQ_CST); }));
+  ASSERT(-7, ({ short x[2]={1,-5}; __atomic_sub_fetch(&x[1], 2, __ATOMIC_SEQ_CST); }));
+  ASSERT(9, ({ short x[2]={1,-5}; __atomic_exchange_n(&x[1], 9, __ATOMIC_SEQ_CST); x[1]; }));
+  ASSERT(-5, ({ short x[2]={1,-5}; __atomic_fetch_max(&x[1], -9, __ATOMIC_SEQ_CST); x[1]; }));
+
+  ASSERT(1, ({ int x=3, y=3; atomic_compare_exchange_strong(&x, &y, 7); }));
+  ASSERT(7, ({ int x=3, y=3; atomic_compare_exchange_strong(&x, &y, 7); x; }));
+  ASSERT(0, ({ int x=3, y=4; atomic_compare_exchange_strong(&x, &y, 7); }));
+  ASSERT(3, ({ int x=3, y=4; atomic_compare_exchange_strong(&x, &y, 7); y; }));
+  ASSERT(0, ({ long x=1L<<40, y=0; __atomic_compare_exchange_n(&x, &y, 7, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED); }));
+  ASSERT(1, ({ long x=1L<<40, y=0; __atomic_compare_exchange_n(&x, &y, 7, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED); y==x; }));
+  ASSERT(0x04090201, ({ char x[4]={1,2,-3,4}; char y=-3; atomic_compare_exchange_strong(&x[2], &y, 9); *(int*)x; }));
+  ASSERT(-3, ({ signed char x[4]={1,2,-3,4}; signed char y=5; atomic_compare_exchange_strong(&x[2], &y, 9); y; }));
+  ASSERT(2, ({ int x=3, y=3, n=0; __atomic_compare_exchange_n(&x, &y, 7, n++, __ATOMIC_SEQ_CST, n++); n; }));
+  ASSERT(1, ({ int x=3, n=0; __atomic_load_n(&x, (n++, __ATOMIC_SEQ_CST)); n; }));
+
+  ASSERT(5, ({ int x=5; atomic_load_explicit(&x, memory_order_relaxed); }));
+  ASSERT(6, ({ int x=5; atomic_store_explicit(&x, 6, memory_order_release); x; }));
+  ASSERT(0, ({ atomic_flag f = 0; atomic_flag_test_and_set(&f); }));
+  ASSERT(1, ({ atomic_flag f = 0; atomic_flag_test_and_set(&f); atomic_flag_test_and_set(&f); }));
+  ASSERT(0, ({ atomic_flag f = 0; atomic_flag_test_and_set(&f); atomic_flag_clear(&f); f; }));
+  ASSERT(1, atomic_is_lock_free(&(long){0}));
+  ASSERT(0, __atomic_always_lock_free(16, 0));
+
+  ASSERT(8, ({ _Atomic int x=5; x += 3; }));
+  ASSERT(5, ({ _Atomic int x=5; x++; }));
+  ASSERT(4, ({ _Atomic char x=5; --x; }));
+  ASSERT(8, ({ int a[4]; _Atomic(int*) p=a; p += 2; (char*)p - (char*)a; }));
+
   printf("OK\n");
   return 0;
 }
@@ -1,6 +1,34 @@
 #include "test.h"
 #include "stddef.h"
 
+static int ColdCnt;
+__attribute__((cold)) static void coldFn(void) { ColdCnt++; }
+int hotFn(int N) __attribute__((hot));
+int hotFn(int N) {
+  int S = 0;
+  for (int I = 0; I < N; I++) {
+    if (I % 3 == 0) {
+      coldFn();
+      continue;
+    } else {
+      S += I;
+    }
+    if (S > 100)
+      break;
+    else
+      coldFn();
+  }
+  return S;
+}
+
+__attribute__((no_instrument_function)) static int noInstrFn(int X) {
+  return X * 2;
+}
+
+__attribute__((visibility("hidden"))) int hiddenFn(int X) { return X + 3; }
+__attribute__((visibility("hidden"))) int HiddenVar = 5;
+int AlignedVar __attribute__((aligned(16))), UnalignedVar;
+
 int main() {
   printf("[313] 支持__attribute__((packed))");
   ASSERT(5, ({ struct { char a; int b; } __attribute__((packed)) x; sizeof(x); }));
@@ -36,6 +64,23 @@ int main() {
 
   ASSERT(16, ({ struct __attribute__((aligned(8+8))) { char a; int b; } x; _Alignof(x); }));
 
+  // 支持hot、cold和noreturn函数属性
+  ASSERT(12, hotFn(6));
+  ASSERT(6, ColdCnt);
+  ASSERT(108, hotFn(100));
+
+  // 支持no_instrument_function函数属性
+  ASSERT(14, noInstrFn(7));
+
+  // 支持visibility属性
+  ASSERT(10, hiddenFn(7));
+  ASSERT(5, HiddenVar);
+
+  // 声明符之后的属性只作用于当前声明符
+  ASSERT(0, (long)&AlignedVar % 16);
+  ASSERT(0, ({ int x __attribute__((aligned(16))), y; (long)&x % 16; }));
+  ASSERT(0, ({ char x, y __attribute__((aligned(16))); (long)&y % 16; }));
+
   printf("OK\n");
   return 0;
 }
@@ -1,5 +1,10 @@
 #include "test.h"
 
+const int g1 = 3;
+const char g2[] = "abc";
+char *const g3 = "abc";
+const struct { int a; char *b; } g4 = {5, "xyz"};
+
 int main() {
   // [136] 忽略const volatile auto register restrict _Noreturn
   { const x; }
@@ -10,6 +15,15 @@ int main() {
   ASSERT(8, ({ const x = 8; int *const y=&x; *y; }));
   ASSERT(6, ({ const x = 6; *(const * const)&x; }));
 
+  // 只读全局变量和字符串字面量
+  ASSERT(3, g1);
+  ASSERT(0, strcmp(g2, "abc"));
+  ASSERT(0, strcmp(g3, "abc"));
+  ASSERT(5, g4.a);
+  ASSERT(0, strcmp(g4.b, "xyz"));
+  ASSERT(1, g3 == "abc");
+  ASSERT(0, g3 == g2);
+
   printf("OK\n");
   return 0;
 }
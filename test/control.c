@@ -4,6 +4,32 @@
  * This is a block comment.
  */
 
+static int DceCnt;
+static int dceInc(void) { return ++DceCnt; }
+
+static int dceAfterReturn(int x) {
+  return x;
+  x = 5;
+  dceInc();
+}
+
+static int dceLabelAfterReturn(int x) {
+  goto L1;
+  return 1;
+  x = 9;
+L1:
+  return x;
+}
+
+static int dceLoop(int n) {
+  int a = 0, b = 0;
+  for (int i = 0; i < n; i++) {
+    b = a;
+    a = i;
+  }
+  return b;
+}
+
 int main() {
   // [15] 支持if语句
   ASSERT(3, ({ int x; if (0) x=2; else x=3; x; }));
@@ -113,6 +139,21 @@ int main() {
   ASSERT(2, ({ static void *p[]={&&v52,&&v52,&&v53}; int i=0; goto *p[1]; v51:i++; v52:i++; v53:i++; i; }));
   ASSERT(1, ({ static void *p[]={&&v62,&&v62,&&v63}; int i=0; goto *p[2]; v61:i++; v62:i++; v63:i++; i; }));
 
+  // 死代码和死存储消除
+  ASSERT(3, dceAfterReturn(3));
+  ASSERT(0, DceCnt);
+  ASSERT(9, dceLabelAfterReturn(9));
+  ASSERT(3, dceLoop(5));
+  ASSERT(3, ({ int x = dceInc(); x = 3; x; }));
+  ASSERT(1, DceCnt);
+  ASSERT(2, ({ int x = 1; int *p = &x; x = 2; *p; }));
+  ASSERT(5, ({ int i = 0; goto in; if (0) { in: i = 5; } i; }));
+  ASSERT(7, ({ int i = 7; while (0) { i = 1; } i; }));
+  ASSERT(14, ({ int x = 3; x += 4; x *= 2; x; }));
+  ASSERT(4, ({ char c = 250; c += 10; c; }));
+  ASSERT(3, ({ int a[3] = {1, 2, 3}; int *p = a; p += 2; *p; }));
+  ASSERT(6, ({ int i = 5; i++; i; }));
+
   printf("OK\n");
   return 0;
 }
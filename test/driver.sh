@@ -385,4 +385,393 @@ else
 fi
 check -Xlinker
 
+# 支持-ffp-contract选项
+# -ffp-contract
+echo 'double f(double a, double b, double c) { return a*b+c; }' | $rvcc -S -o- -xc - | grep -q 'fmadd\.d'
+check -ffp-contract
+! echo 'double f(double a, double b, double c) { return a*b+c; }' | $rvcc -ffp-contract=off -S -o- -xc - | grep -q 'fmadd\.d'
+check -ffp-contract=off
+! echo 'double f(double a, double b, double c) { return a*b+c; }' | $rvcc -std=c11 -S -o- -xc - | grep -q 'fmadd\.d'
+check -std=c11
+echo 'double f(double a, double b, double c) { return a*b+c; }' | $rvcc -std=c11 -ffp-contract=fast -S -o- -xc - | grep -q 'fmadd\.d'
+check -ffp-contract=fast
+
+# 浮点常量使用常量池
+echo 'double f() { return 1.5; } double g() { return 1.5; }' | $rvcc -S -o- -xc - | grep -c 'dword 0x3ff8000000000000' | grep -q '^1$'
+check 'float constant pool'
+echo 'double f() { return 0.0; }' | $rvcc -S -o- -xc - | grep -q 'fmv.d.x fa0, zero'
+check 'float zero constant'
+
+# 支持-G选项
+# -G
+echo 'int x=1;' | $rvcc -G 8 -S -o- -xc - | grep -q '\.sdata'
+check -G
+echo 'int x; int f() { return x; }' | $rvcc -G8 -fno-common -S -o- -xc - | grep -q '\.sbss'
+check -G
+echo 'int x; int f() { return x; }' | $rvcc -msmall-data-limit=8 -S -o- -xc - | grep -q '%pcrel_hi(x)'
+check -msmall-data-limit
+! echo 'long x[4]={1};' | $rvcc -G 8 -S -o- -xc - | grep -q '\.sdata'
+check -G
+! echo 'int x=1;' | $rvcc -S -o- -xc - | grep -q '\.sdata'
+check -G
+
+# 紧凑地输出全局变量的初始值
+echo 'char x[] = "hello";' | $rvcc -S -o- -xc - | grep -q '\.string "hello"'
+check 'global string data'
+echo 'int x[100] = {1};' | $rvcc -S -o- -xc - | grep -q '\.zero 392'
+check 'global zero data'
+echo 'int x = 0;' | $rvcc -S -o- -xc - | grep -q '\.bss'
+check 'zero initialized global'
+
+# 只读数据和字符串字面量
+echo 'const int x = 1;' | $rvcc -S -o- -xc - | grep -q '\.section \.rodata,"a",@progbits'
+check 'const global'
+echo 'char *f() { return "abc"; }' | $rvcc -S -o- -xc - | grep -q 'rodata\.str1\.1,"aMS",@progbits,1'
+check 'string literal'
+echo 'char *f() { return "abc"; } char *g() { return "abc"; }' | $rvcc -S -o- -xc - | grep -c '\.string "abc"' | grep -q '^1$'
+check 'string literal merging'
+echo 'int x; int *const p = &x;' | $rvcc -fPIC -S -o- -xc - | grep -q '\.data\.rel\.ro'
+check 'relro'
+
+# 支持-ffunction-sections和-fdata-sections选项
+# -ffunction-sections
+echo 'int foo() { return 0; }' | $rvcc -ffunction-sections -S -o- -xc - | grep -q '\.section \.text\.foo,"ax",@progbits'
+check -ffunction-sections
+# -fdata-sections
+echo 'int foo = 1; int bar;' | $rvcc -fdata-sections -fno-common -S -o- -xc - | grep -q '\.section \.data\.foo,"aw",@progbits'
+check -fdata-sections
+echo 'int foo = 1; int bar;' | $rvcc -fdata-sections -fno-common -S -o- -xc - | grep -q '\.section \.bss\.bar,"aw",@nobits'
+check -fdata-sections
+
+# 支持hot和cold函数属性
+echo 'void f(void) __attribute__((cold)); void f(void) {}' | $rvcc -S -o- -xc - | grep -q '\.section \.text\.unlikely,"ax",@progbits'
+check 'cold attribute'
+echo '__attribute__((hot)) void f(void) {}' | $rvcc -ffunction-sections -S -o- -xc - | grep -q '\.section \.text\.hot\.f,"ax",@progbits'
+check 'hot attribute'
+echo '_Noreturn void g(void); int f(int x) { if (x) g(); return x; }' | $rvcc -S -o- -xc - | grep -q '^\.L\.cold\.'
+check 'noreturn branch'
+
+# 支持-fprofile-generate和-fprofile-use选项
+echo 'int f(int x) { if (x) return 1; return 0; }' > $tmp/prof.c
+$rvcc -fprofile-generate -S -o- $tmp/prof.c | grep -q "\.string \"$tmp/prof\.prof\""
+check -fprofile-generate
+$rvcc -fprofile-generate=$tmp/pd -S -o- $tmp/prof.c | grep -q "\.string \"$tmp/pd/$(echo $tmp/prof | tr / '#')\.prof\""
+check -fprofile-generate=DIR
+# 剖析数据文件以可重定位文件命名，不同目录中的同名文件不冲突
+mkdir -p $tmp/pa $tmp/pb
+cp $tmp/prof.c $tmp/pa/util.c
+cp $tmp/prof.c $tmp/pb/util.c
+$rvcc -fprofile-generate -fintegrated-as -c -o $tmp/pa/util.o $tmp/pa/util.c
+$rvcc -fprofile-generate -fintegrated-as -c -o $tmp/pb/util.o $tmp/pb/util.c
+grep -q "$tmp/pa/util\.prof" $tmp/pa/util.o && grep -q "$tmp/pb/util\.prof" $tmp/pb/util.o
+check '-fprofile-generate object name'
+$rvcc -fprofile-generate -S -o- $tmp/prof.c | grep -q '\.fini_array'
+check -fprofile-generate
+printf 'f:0 100\nf:1 1\nf:2 99\n' > $tmp/prof.prof
+$rvcc -fprofile-use -S -o- $tmp/prof.c | grep -q '^\.L\.cold\.'
+check -fprofile-use
+$rvcc -fprofile-use -S -o- $tmp/prof.c | grep -q '\.section \.text\.hot'
+check -fprofile-use
+printf 'f:0 0\n' > $tmp/prof.prof
+$rvcc -fprofile-use -S -o- $tmp/prof.c | grep -q '\.section \.text\.unlikely'
+check -fprofile-use
+
+# 支持函数入口和出口的插桩
+echo 'int f(void) { return 0; }' | $rvcc -finstrument-functions -S -o- -xc - | grep -q 'call __cyg_profile_func_enter@plt'
+check -finstrument-functions
+echo 'int f(void) { return 0; }' | $rvcc -finstrument-functions -S -o- -xc - | grep -q 'call __cyg_profile_func_exit@plt'
+check -finstrument-functions
+echo 'int f(void) { return 0; }' | $rvcc -pg -S -o- -xc - | grep -q 'call _mcount@plt'
+check -pg
+! echo '__attribute__((no_instrument_function)) int f(void) { return 0; }' | $rvcc -finstrument-functions -pg -S -o- -xc - | grep -q '__cyg_profile_func_enter\|_mcount'
+check 'no_instrument_function attribute'
+
+# 按内存序生成原子指令
+echo 'int f(int *p) { return __atomic_fetch_add(p, 1, __ATOMIC_SEQ_CST); }' | $rvcc -S -o- -xc - | grep -q 'amoadd\.w\.aqrl'
+check 'atomic seq_cst'
+echo 'int f(int *p) { return __atomic_fetch_add(p, 1, __ATOMIC_RELAXED); }' | $rvcc -S -o- -xc - | grep -q 'amoadd\.w t0'
+check 'atomic relaxed'
+echo 'int f(long *p, long *o) { return __atomic_compare_exchange_n(p, o, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED); }' | $rvcc -S -o- -xc - | grep -q 'lr\.d\.aq '
+check 'atomic acquire'
+[ "$(echo 'int g(void); int x, e; int f(int v) { return __atomic_compare_exchange_n(&x, &e, v, g(), 5, g()); }' | $rvcc -S -o- -xc - | grep -c 'call g')" = 2 ]
+check 'atomic ignored arguments'
+! echo 'int f(int *p) { return __atomic_load_n(p, __ATOMIC_RELAXED); }' | $rvcc -S -o- -xc - | grep -q 'fence'
+check 'atomic relaxed load'
+echo 'void f(int *p) { __atomic_store_n(p, 1, __ATOMIC_RELEASE); }' | $rvcc -S -o- -xc - | grep -q 'fence rw, w'
+check 'atomic release store'
+echo 'int f(_Atomic int *p) { return *p += 2; }' | $rvcc -S -o- -xc - | grep -q 'amoadd\.w\.aqrl'
+check 'atomic compound assignment'
+
+# 支持-ftls-model选项
+echo '_Thread_local int x; int f(void) { return x; }' | $rvcc -S -o- -xc - | grep -q 'add a0, a0, tp, %tprel_add(x)'
+check 'tls local-exec'
+echo 'extern _Thread_local int x; int f(void) { return x; }' | $rvcc -S -o- -xc - | grep -q '%tls_ie_pcrel_hi(x)'
+check 'tls initial-exec'
+echo '_Thread_local int x; int f(void) { return x; }' | $rvcc -fPIC -S -o- -xc - | grep -q '%tls_gd_pcrel_hi(x)'
+check 'tls global-dynamic'
+echo 'extern _Thread_local int x; int f(void) { return x; }' | $rvcc -static -S -o- -xc - | grep -q '%tprel_hi(x)'
+check 'tls -static'
+echo 'extern _Thread_local int x; int f(void) { return x; }' | $rvcc -fPIC -ftls-model=initial-exec -S -o- -xc - | grep -q '%tls_ie_pcrel_hi(x)'
+check -ftls-model
+! echo '_Thread_local int x; int f(void) { return x; }' | $rvcc -fPIC -ftls-model=local-exec -S -o- -xc - | grep -q '__tls_get_addr'
+check -ftls-model
+
+# 直接调用函数，不经过PLT
+echo 'int g(void); int f(void) { return g(); }' | $rvcc -S -o- -xc - | grep -q 'call g$'
+check 'direct call'
+echo 'int g(void); int f(void) { return g(); }' | $rvcc -fPIC -S -o- -xc - | grep -q 'call g@plt'
+check 'plt call'
+echo 'int g(void); int f(void) { return g(); }' | $rvcc -fPIC -fno-plt -S -o- -xc - | grep -q '%got_pcrel_hi(g)'
+check -fno-plt
+echo 'int g(void); int f(void) { return g(); }' | $rvcc -fPIC -fno-pic -S -o- -xc - | grep -q 'call g$'
+check -fno-pic
+echo 'int g(void); int f(void) { return g(); }' | $rvcc -fPIC -static -S -o- -xc - | grep -q 'call g$'
+check 'static call'
+echo 'static int g(void) { return 0; } int f(void) { return g(); }' | $rvcc -fPIC -S -o- -xc - | grep -q 'call g$'
+check 'static function call'
+echo '__attribute__((visibility("hidden"))) int g(void); int f(void) { return g(); }' | $rvcc -fPIC -S -o- -xc - | grep -q 'call g$'
+check 'hidden function call'
+echo '__attribute__((visibility("hidden"))) int x;' | $rvcc -S -o- -xc - | grep -q '\.hidden x'
+check 'visibility attribute'
+
+# 返回值优化
+! echo 'typedef struct { long a, b, c, d; } V; V g(void); long f(void) { V v; v = g(); return v.a; }' | $rvcc -S -o- -xc - | grep -q 'lb t1, 0(t0)'
+check 'return value optimization'
+! echo 'typedef struct { long a, b, c, d; } V; V f(long x) { V r = {x, x, x, x}; return r; }' | $rvcc -S -o- -xc - | grep -q 'sd t0, 0(t1)'
+check 'named return value optimization'
+! echo 'typedef struct { long a, b, c, d; } V; V g(void); V f(void) { return g(); }' | $rvcc -S -o- -xc - | grep -q 'sd t0, 0(t1)'
+check 'return value forwarding'
+echo 'typedef struct { long a, b, c, d; } V; V g(void); long f(void) { V v; V *p = &v; v = g(); return p->a; }' | $rvcc -S -o- -xc - | grep -q 'lb t1, 0(t0)'
+check 'return value optimization aliasing'
+
+# 表达式的中间结果暂存在寄存器中
+! echo 'int f(int a, int b, int c, int d) { return (a + b) * (c - d) + a * (b + c * d); }' | $rvcc -S -o- -xc - | grep -q 'sd a0, 0(sp)'
+check 'sethi-ullman'
+echo 'int g(int); int f(int a) { return a + g(a) * 2; }' | $rvcc -S -o- -xc - | grep -q '表达式栈最大深度为1'
+check 'stack depth report'
+
+# 死代码和死存储消除
+! echo 'int f(int x) { return x; x = 12345; }' | $rvcc -S -o- -xc - | grep -q 12345
+check 'unreachable code elimination'
+! echo 'int f(int x) { int y = x * 3; y = 12345; return x; }' | $rvcc -S -o- -xc - | grep -q 12345
+check 'dead store elimination'
+echo 'int f(int x) { volatile int y; y = 12345; return x; }' | $rvcc -S -o- -xc - | grep -q 12345
+check 'dead store volatile'
+echo 'int f(int x) { int y; int *p = &y; y = 12345; return x; }' | $rvcc -S -o- -xc - | grep -q 12345
+check 'dead store address taken'
+echo 'int f(int x) { long a = x, b = x, c = x; return x; }' | $rvcc -S -o- -xc - | grep -m1 'li t0' | grep -q -- '-16$'
+check 'unused locals elimination'
+
+# -j
+rm -f $tmp/j1.s $tmp/j2.s $tmp/j3.s
+echo 'int j1(void) { return 1; }' > $tmp/j1.c
+echo 'int j2(void) { return 2; }' > $tmp/j2.c
+echo 'int j3(void) { return 3; }' > $tmp/j3.c
+(cd $tmp; $OLDPWD/$rvcc -S -j2 $tmp/j1.c $tmp/j2.c $tmp/j3.c)
+[ -f $tmp/j1.s ] && [ -f $tmp/j2.s ] && [ -f $tmp/j3.s ] && grep -q j2 $tmp/j2.s
+check '-j'
+echo 'int j4( {' > $tmp/j4.c
+! (cd $tmp; $OLDPWD/$rvcc -S -j2 $tmp/j1.c $tmp/j4.c $tmp/j3.c 2> /dev/null)
+check '-j failure'
+$rvcc -S -j0 -o /dev/null $tmp/empty.c 2>&1 | grep -q 'invalid number of jobs'
+check '-j0'
+
+# cc1在fork出的子进程中直接运行，不再exec自身
+rm -f $tmp/inproc.s
+echo 'int x;' > $tmp/inproc.c
+(cd $tmp; exec -a rvcc-not-in-path $OLDPWD/$rvcc -S -o $tmp/inproc.s $tmp/inproc.c)
+[ -f $tmp/inproc.s ]
+check 'in-process cc1'
+
+# -pipe
+rm -f $tmp/pipe.o
+$rvcc -fno-integrated-as -pipe -c -o $tmp/pipe.o $tmp/empty.c
+[ -f $tmp/pipe.o ]
+check '-pipe'
+$rvcc -### -fno-integrated-as -pipe -c -o $tmp/pipe.o $tmp/empty.c 2>&1 | grep -q 'as -c -o'
+check '-pipe stdin'
+! $rvcc -### -fno-integrated-as -pipe -c -o $tmp/pipe.o $tmp/empty.c 2>&1 | grep -q 'cc1-output'
+check '-pipe no temporary file'
+echo 'int x = ;' > $tmp/pipe-bad.c
+! $rvcc -fno-integrated-as -pipe -c -o $tmp/pipe-bad.o $tmp/pipe-bad.c 2> /dev/null && [ ! -f $tmp/pipe-bad.o ]
+check '-pipe error'
+
+# -fintegrated-as
+rm -f $tmp/ias.o
+$rvcc -fintegrated-as -c -o $tmp/ias.o $tmp/empty.c
+[ "$(od -An -tx1 -N4 $tmp/ias.o)" = ' 7f 45 4c 46' ] && [ "$(od -An -tx1 -j18 -N2 $tmp/ias.o)" = ' f3 00' ]
+check '-fintegrated-as'
+$rvcc -### -fintegrated-as -c -o $tmp/ias.o $tmp/empty.c 2>&1 | grep -q 'cc1-emit-obj'
+check '-fintegrated-as cc1'
+! $rvcc -### -fintegrated-as -c -o $tmp/ias.o $tmp/empty.c 2>&1 | grep -q '^as '
+check '-fintegrated-as no as'
+! $rvcc -### -c -o $tmp/ias.o $tmp/empty.c 2>&1 | grep -q '^as '
+check '-fintegrated-as default'
+$rvcc -### -fno-integrated-as -c -o $tmp/ias.o $tmp/empty.c 2>&1 | grep -q '^as '
+check '-fno-integrated-as'
+echo 'int f(void); int g(void) { return f(); }' | $rvcc -fintegrated-as -c -o $tmp/ias-call.o -xc -
+grep -qa '\.rela\.text' $tmp/ias-call.o
+check '-fintegrated-as relocation'
+echo 'int g(void) { return 0; }' | $rvcc -g -fintegrated-as -c -o $tmp/ias-g.o -xc -
+grep -qa '\.debug_line' $tmp/ias-g.o
+check '-fintegrated-as -g'
+echo 'void f(void) { asm("rdcycle a0; wfi; c.nop"); }' | PATH=/nonexistent $rvcc -fintegrated-as -c -o $tmp/ias-csr.o -xc -
+od -An -tx1 -v $tmp/ias-csr.o | tr -d ' \n' | grep -q '732500c07300501001'
+check '-fintegrated-as rdcycle wfi c.nop'
+echo 'void f(void) { asm("bogus a0"); }' | $rvcc -fintegrated-as -c -o $tmp/ias-bad.o -xc - 2>&1 | grep -q 'bogus a0'
+check '-fintegrated-as fallback to as'
+echo 'char *s(void) { return "hi\\n"; } long c(int x) { return (char)x; } int k(void) { return 42; }' > $tmp/ias-direct.c
+$rvcc -ftime-report -S -o $tmp/ias-direct.s $tmp/ias-direct.c 2> $tmp/ias-direct1.json
+$rvcc -ftime-report -fintegrated-as -c -o $tmp/ias-direct.o $tmp/ias-direct.c 2> $tmp/ias-direct2.json
+od -An -tx1 -v $tmp/ias-direct.o | tr -d ' \n' | grep -q '1305a002' &&
+  grep -qa 'hi' $tmp/ias-direct.o &&
+  [ "$(grep -o '"instructions":[0-9]*' $tmp/ias-direct1.json)" = "$(grep -o '"instructions":[0-9]*' $tmp/ias-direct2.json)" ]
+check '-fintegrated-as direct encoding'
+echo 'void f(void) { asm(".option push; .option norvc; addi a0, a0, 1; .option pop; addi a0, a0, 1"); }' | $rvcc -fintegrated-as -c -o $tmp/ias-rvc.o -xc -
+od -An -tx1 -v $tmp/ias-rvc.o | tr -d ' \n' | grep -q '130515000505' &&
+  [ "$(od -An -tx1 -j48 -N4 $tmp/ias-direct.o)" = ' 05 00 00 00' ]
+check '-fintegrated-as RVC'
+
+# -fcache-dir
+rm -rf $tmp/cache
+echo 'int cached(void) { return 123; }' > $tmp/cached.c
+$rvcc -fcache-dir=$tmp/cache -S -o $tmp/cached1.s $tmp/cached.c
+$rvcc -fcache-dir=$tmp/cache -S -o $tmp/cached2.s $tmp/cached.c
+cmp -s $tmp/cached1.s $tmp/cached2.s
+check '-fcache-dir'
+$rvcc -fcache-dir=$tmp/cache -fcache-stats 2>&1 | grep -q 'hits: 1'
+check '-fcache-stats hits'
+$rvcc -fcache-dir=$tmp/cache -fPIC -S -o $tmp/cached3.s $tmp/cached.c
+$rvcc -fcache-dir=$tmp/cache -fcache-stats 2>&1 | grep -q 'misses: 2'
+check '-fcache-stats misses'
+echo 'int cached(void) { return 456; }' > $tmp/cached.c
+$rvcc -fcache-dir=$tmp/cache -S -o $tmp/cached4.s $tmp/cached.c
+grep -q 456 $tmp/cached4.s
+check '-fcache-dir invalidation'
+echo 'int small_data = 1; int f(void) { return small_data; }' > $tmp/cached-g.c
+$rvcc -fcache-dir=$tmp/cache -G 8 -S -o $tmp/cached-g8.s $tmp/cached-g.c
+$rvcc -fcache-dir=$tmp/cache -G 0 -S -o $tmp/cached-g0.s $tmp/cached-g.c
+$rvcc -G 0 -S -o $tmp/cached-g0-nocache.s $tmp/cached-g.c
+grep -q sdata $tmp/cached-g8.s && cmp -s $tmp/cached-g0.s $tmp/cached-g0-nocache.s
+check '-fcache-dir separate option argument'
+$rvcc -fcache-stats 2>&1 | grep -q 'requires -fcache-dir'
+check '-fcache-stats without -fcache-dir'
+
+# --server, --client
+$rvcc --server=$tmp/server.sock 2>/dev/null &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do [ -S $tmp/server.sock ] && break; sleep 0.1; done
+mkdir -p $tmp/server-inc
+printf '#ifndef SERVER_H\n#define SERVER_H\nint server_value(void);\n#endif\n' > $tmp/server-inc/server.h
+printf '#include <server.h>\n#include <stddef.h>\nint f(void) { return server_value() + sizeof(size_t); }\n' > $tmp/server.c
+$rvcc -I$tmp/server-inc -S -o $tmp/server1.s $tmp/server.c
+$rvcc --client=$tmp/server.sock -I$tmp/server-inc -S -o $tmp/server2.s $tmp/server.c
+$rvcc --client=$tmp/server.sock -I$tmp/server-inc -S -o $tmp/server3.s $tmp/server.c
+cmp -s $tmp/server1.s $tmp/server2.s && cmp -s $tmp/server1.s $tmp/server3.s
+check '--client'
+printf '#ifndef SERVER_H\n#define SERVER_H\nint server_value2(void);\n#define server_value server_value2\n#endif\n' > $tmp/server-inc/server.h
+$rvcc --client=$tmp/server.sock -I$tmp/server-inc -S -o - $tmp/server.c | grep -q server_value2
+check '--client modified header'
+echo 'int x = 42;' | $rvcc --client=$tmp/server.sock -S -o - -xc - | grep -q 0x2a
+check '--client stdin'
+echo 'int f(void) { return y; }' | $rvcc --client=$tmp/server.sock -S -o /dev/null -xc - 2>&1 | grep -q 'undefined variable'
+check '--client error'
+! echo 'int f(void) { return y; }' | $rvcc --client=$tmp/server.sock -S -o /dev/null -xc - 2>/dev/null
+check '--client exit status'
+sleep 1
+t1=$(date +%H:%M:%S)
+t=$(echo '__TIME__' | $rvcc --client=$tmp/server.sock -E -xc - | tail -1)
+t2=$(date +%H:%M:%S)
+[ "$t" = "\"$t1\"" ] || [ "$t" = "\"$t2\"" ]
+check '--client __TIME__'
+mkdir -p $tmp/sa $tmp/sb
+printf '#include "s.h"\nint f(void) { return S; }\n' > $tmp/sa/s.c
+cp $tmp/sa/s.c $tmp/sb/s.c
+echo '#define S 11' > $tmp/sa/s.h
+echo '#define S 22' > $tmp/sb/s.h
+touch -d '2020-01-01 00:00:00' $tmp/sa/s.c $tmp/sb/s.c $tmp/sa/s.h $tmp/sb/s.h
+(cd $tmp/sa; exec $OLDPWD/$rvcc --server=$tmp/server2.sock 2>/dev/null) &
+server2=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do [ -S $tmp/server2.sock ] && break; sleep 0.1; done
+(cd $tmp/sa; $OLDPWD/$rvcc --client=$tmp/server2.sock -S -o - s.c) | grep -q 11 &&
+  (cd $tmp/sb; $OLDPWD/$rvcc --client=$tmp/server2.sock -S -o - s.c) | grep -q 22
+check '--client relative paths'
+printf '#ifndef G_H\n#define G_H\nint g;\n#endif\n' > $tmp/sa/g.h
+printf '#include "g.h"\n#include "./g.h"\n' > $tmp/sa/g.c
+for i in 1 2; do
+  rm -f $tmp/guard.json
+  (cd $tmp/sa; $OLDPWD/$rvcc --client=$tmp/server2.sock -ftrace=$tmp/guard.json -S -o /dev/null g.c)
+done
+[ "$(grep -c '"cat":"include","name":"[^"]*g.h"' $tmp/guard.json)" = 1 ]
+check '--client include guard'
+kill $server2
+wait $server2 2>/dev/null
+kill $server
+wait $server 2>/dev/null
+$rvcc --client=$tmp/server.sock -S -o /dev/null $tmp/server.c 2>&1 | grep -q 'cannot connect'
+check '--client no server'
+mkdir -m 700 $tmp/xdg
+XDG_RUNTIME_DIR=$tmp/xdg $rvcc --server 2>/dev/null &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do [ -S $tmp/xdg/rvcc.sock ] && break; sleep 0.1; done
+echo 'int x = 42;' | XDG_RUNTIME_DIR=$tmp/xdg $rvcc --client -S -o - -xc - | grep -q 0x2a
+check '--server XDG_RUNTIME_DIR'
+kill $server
+wait $server 2>/dev/null
+
+# -ftime-report
+echo 'int main() { return 0; }' > $tmp/time.c
+$rvcc -ftime-report -S -o $tmp/time.s $tmp/time.c 2>&1 | grep -q '"process":"cc1".*"tokenize":{"wall_us":[0-9]*,"cpu_us":[0-9]*}'
+check '-ftime-report phases'
+$rvcc -ftime-report -S -o $tmp/time.s $tmp/time.c 2>&1 | grep -q '"counters":{"tokens":[1-9][0-9]*,"macro_expansions":[0-9]*,"ast_nodes":[1-9][0-9]*,"instructions":[1-9][0-9]*}'
+check '-ftime-report counters'
+echo 'long double f(int x) { return x; } int g(long double x) { return x; } int h(int *p, int *e) { return __atomic_compare_exchange_n(p, e, 1, 0, 5, 5); }' > $tmp/insns.c
+insns=$($rvcc -ftime-report -S -o $tmp/insns.s $tmp/insns.c 2>&1 | sed -n 's/.*"instructions":\([0-9]*\).*/\1/p')
+[ "$insns" = "$(grep -cvE '^\s*($|#|\.)|^\s*[A-Za-z0-9_.$]+:\s*$' $tmp/insns.s)" ]
+check '-ftime-report instruction count'
+$rvcc -ftime-report -S -o $tmp/time.s $tmp/time.c 2>&1 | grep -q '"subprocess":"cc1","file":".*time.c","status":0'
+check '-ftime-report subprocess'
+rm -f $tmp/time.jsonl
+$rvcc -ftime-report=$tmp/time.jsonl -S -o $tmp/time.s $tmp/time.c
+$rvcc -ftime-report=$tmp/time.jsonl -S -o $tmp/time.s $tmp/time.c
+[ "$(grep -c '"process":"cc1"' $tmp/time.jsonl)" = 2 ]
+check '-ftime-report=FILE'
+
+# -ftrace
+echo '#include <stddef.h>
+int main() { return 0; }' > $tmp/trace.c
+rm -f $tmp/trace.json
+$rvcc -ftrace=$tmp/trace.json -S -o $tmp/trace.s $tmp/trace.c
+[ "$(head -1 $tmp/trace.json)" = '[' ] && [ "$(tail -1 $tmp/trace.json)" = ']' ]
+check '-ftrace array'
+grep -q '"cat":"include","name":".*stddef.h"' $tmp/trace.json
+check '-ftrace include'
+grep -q '"cat":"parse","name":"main"' $tmp/trace.json && grep -q '"cat":"codegen","name":"main"' $tmp/trace.json
+check '-ftrace function'
+grep -q '"cat":"subprocess","name":"cc1 .*trace.c"' $tmp/trace.json
+check '-ftrace subprocess'
+
+# -fmem-report
+echo '#define ONE 1
+int x[ONE]; int main() { return x[0]; }' > $tmp/mem.c
+$rvcc -fmem-report -S -o $tmp/mem.s $tmp/mem.c 2>&1 | grep -q '"process":"cc1".*"peak_rss_kb":[1-9][0-9]*'
+check '-fmem-report peak rss'
+$rvcc -fmem-report -S -o $tmp/mem.s $tmp/mem.c 2>&1 | grep -q '"tokens":{"count":[1-9][0-9]*,"bytes":[1-9][0-9]*},"hidesets":{"count":[1-9]'
+check '-fmem-report kinds'
+$rvcc -fmem-report -S -o $tmp/mem.s $tmp/mem.c 2>&1 | grep -q '"parse":{"count":[1-9][0-9]*,"bytes":[1-9][0-9]*}'
+check '-fmem-report phases'
+$rvcc -fmem-report -S -o $tmp/mem.s $tmp/mem.c 2>&1 | grep -q '"arenas":{"token":{"count":[0-9]*,"bytes":[0-9]*},"ast":{"count":[1-9]'
+check '-fmem-report arenas'
+rm -f $tmp/mem.jsonl
+$rvcc -fmem-report=$tmp/mem.jsonl -S -o $tmp/mem.s $tmp/mem.c
+$rvcc -fmem-report=$tmp/mem.jsonl -S -o $tmp/mem.s $tmp/mem.c
+[ "$(grep -c '"process":"cc1"' $tmp/mem.jsonl)" = 2 ]
+check '-fmem-report=FILE'
+
+# 声明符之后的属性只作用于当前声明符
+echo 'int a __attribute__((aligned(16))), b;' > $tmp/declattr.c
+$rvcc -S -o- $tmp/declattr.c | grep -q '\.comm a, 4, 16' &&
+  $rvcc -S -o- $tmp/declattr.c | grep -q '\.comm b, 4, 4'
+check 'declarator attribute'
+
 echo OK
@@ -92,6 +92,18 @@ int main() {
   ASSERT(5, 0.0 ? 3 : 5);
   ASSERT(3, 1.2 ? 3 : 5);
 
+  // 支持浮点乘加融合
+  { double a=1.5, b=4, c=0.5; ASSERT(6, a*b+c); }
+  { double a=1.5, b=4, c=0.5; ASSERT(6, c+a*b); }
+  { double a=1.5, b=4, c=0.5; ASSERT(5, a*b-c); }
+  { double a=1.5, b=4, c=0.5; ASSERT(-5, c-a*b); }
+  { double a=1.5, b=4, c=0.5; ASSERT(-6, -(a*b)-c); }
+  { double a=1.5, b=4, c=0.5; ASSERT(-5, -(a*b)+c); }
+  { float a=1.5, b=4, c=0.5; ASSERT(6, a*b+c); }
+  { float a=1.5, b=4, c=0.5; ASSERT(-5, c-a*b); }
+  { float a=1.5, b=4; double c=0.5; ASSERT(6, a*b+c); }
+  { double x=1+1.0/(1<<30), y=x*x; ASSERT(1, x*x-y > 0); }
+
   printf("OK\n");
   return 0;
 }
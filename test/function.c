@@ -461,6 +461,41 @@ Ty21 struct_test38(void) {
                 11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
 }
 
+// 返回值优化
+typedef struct { long a, b, c, d; } RvoV4;
+typedef struct { short a, b, c; } RvoS6;
+RvoV4 *RvoEsc;
+
+RvoV4 rvo_mk(long x) {
+  RvoV4 r = {x, x + 1, x + 2, x + 3};
+  return r;
+}
+
+RvoV4 rvo_add(RvoV4 p, RvoV4 q) {
+  RvoV4 r;
+  r.a = p.a + q.a;
+  r.b = p.b + q.b;
+  r.c = p.c + q.c;
+  r.d = p.d + q.d;
+  return r;
+}
+
+RvoV4 rvo_fwd(long x) { return rvo_mk(x * 10); }
+
+RvoV4 rvo_two(int c) {
+  RvoV4 a = rvo_mk(1), b = rvo_mk(2);
+  if (c)
+    return a;
+  return b;
+}
+
+RvoV4 rvo_peek(void) {
+  RvoV4 r = {RvoEsc->a + 100, RvoEsc->b};
+  return r;
+}
+
+RvoS6 rvo_s6(void) { return (RvoS6){4, 5, 6}; }
+
 // [260] 将inline函数作为static函数
 inline int inline_fn(void) {
   return 3;
@@ -1139,6 +1174,16 @@ int main() {
   ASSERT(19, struct_test38().a[18]);
   ASSERT(20, struct_test38().a[19]);
 
+  // 返回值优化
+  ASSERT(13, ({ RvoV4 v = rvo_mk(10); v.d; }));
+  ASSERT(15, ({ RvoV4 v = rvo_mk(10), w = rvo_mk(1); v = rvo_add(v, w); v.c; }));
+  ASSERT(103, ({ RvoV4 v = rvo_fwd(10); v.d; }));
+  ASSERT(1, ({ RvoV4 v = rvo_two(1); v.a; }));
+  ASSERT(2, ({ RvoV4 v = rvo_two(0); v.a; }));
+  ASSERT(105, ({ RvoV4 v = rvo_mk(5); RvoEsc = &v; v = rvo_peek(); v.a; }));
+  ASSERT(6, ({ RvoV4 v = rvo_mk(5); RvoEsc = &v; v = rvo_peek(); v.b; }));
+  ASSERT(1, ({ char x = 7; RvoS6 s; char y = 8; s = rvo_s6(); s.a == 4 && s.c == 6 && x == 7 && y == 8; }));
+
   printf("[203] 单个成员变量的结构体：\n");
   ASSERT(1,  ({struct_type_1_1_test_4().a;}));
   ASSERT(10, ({struct_type_1_2_test_4().a;}));
@@ -96,6 +96,8 @@ int main() {
   ASSERT(u'b', L"βb"[1]);
   ASSERT(0, L"βb"[2]);
   ASSERT(-1, L"\xffffffff"[0] >> 31);
+  ASSERT(22, _Generic(L"a"[0], unsigned: 11, int: 22));
+  ASSERT(11, _Generic(U"a"[0], unsigned: 11, int: 22));
 
   ASSERT(0, strcmp(STR(L"a"), "L\"a\""));
 
@@ -126,10 +126,11 @@ bool consume(Token **Rest, Token *Tok, char *Str) {
 // 生成新的Token
 static Token *newToken(TokenKind Kind, char *Start, char *End) {
   // 分配1个Token的内存空间
-  Token *Tok = calloc(1, sizeof(Token));
+  Token *Tok = allocMem(MEM_TOKEN, sizeof(Token));
   Tok->Kind = Kind;
   Tok->Loc = Start;
   Tok->Len = End - Start;
+  Counters.Tokens++;
   // 输入文件
   Tok->File = CurrentFile;
   Tok->Filename = CurrentFile->DisplayName;
@@ -313,7 +314,7 @@ static Token *readStringLiteral(char *Start, char *Quote) {
   char *End = stringLiteralEnd(Quote + 1);
   // 定义一个与字符串字面量内字符数+1的Buf
   // 用来存储最大位数的字符串字面量
-  char *Buf = calloc(1, End - Quote);
+  char *Buf = allocMem(MEM_STRING, End - Quote);
   // 实际的字符位数，一个转义字符为1位
   int Len = 0;
 
@@ -341,7 +342,7 @@ static Token *readStringLiteral(char *Start, char *Quote) {
 // 大于U+10000的码点，使用4字节（每2个字节被称为代理项，即前导代理和后尾代理）。
 static Token *readUTF16StringLiteral(char *Start, char *Quote) {
   char *End = stringLiteralEnd(Quote + 1);
-  uint16_t *Buf = calloc(2, End - Start);
+  uint16_t *Buf = allocMem(MEM_STRING, 2 * (End - Start));
   int Len = 0;
 
   // 遍历引号内的字符
@@ -379,7 +380,7 @@ static Token *readUTF16StringLiteral(char *Start, char *Quote) {
 // UTF-32是4字节编码
 static Token *readUTF32StringLiteral(char *Start, char *Quote, Type *Ty) {
   char *End = stringLiteralEnd(Quote + 1);
-  uint32_t *Buf = calloc(4, End - Quote);
+  uint32_t *Buf = allocMem(MEM_STRING, 4 * (End - Quote));
   int Len = 0;
 
   // 解码UTF-8的字符串文字
@@ -806,6 +807,7 @@ static char *readFile(char *Path) {
     fputc('\n', Out);
   fputc('\0', Out);
   fclose(Out);
+  countMem(MEM_FILE, BufLen);
   return Buf;
 }
 
@@ -814,7 +816,7 @@ File **getInputFiles(void) { return InputFiles; }
 
 // 新建一个File
 File *newFile(char *Name, int FileNo, char *Contents) {
-  File *FP = calloc(1, sizeof(File));
+  File *FP = allocMem(MEM_OTHER, sizeof(File));
   FP->Name = Name;
   FP->DisplayName = FP->Name;
   FP->FileNo = FileNo;
@@ -935,7 +937,43 @@ static void convertUniversalChars(char *P) {
 }
 
 // 词法分析文件
-Token *tokenizeFile(char *Path) {
+// 编译服务器中已经词法分析过的文件，处理请求的子进程继承这些文件
+typedef struct {
+  File *File;    // 文件
+  Token *Tok;    // 终结符链表
+  int64_t MTime; // 修改时间，纳秒
+  int64_t Size;  // 文件大小
+  char *Guard;   // 头文件保护宏，只取决于文件的内容
+} WarmFile;
+
+// 以文件的设备号和inode号为键，与路径的写法和请求的工作目录无关，
+// 不同项目中同名的相对路径不会对应到同一个文件
+static HashMap WarmFiles;
+
+// 文件的键：设备号和inode号
+static char *fileKey(struct stat *St) {
+  return format("%lx:%lx", (unsigned long)St->st_dev,
+                (unsigned long)St->st_ino);
+}
+
+// 文件的修改时间，纳秒
+static int64_t fileMTime(struct stat *St) {
+  return St->st_mtim.tv_sec * 1000000000LL + St->st_mtim.tv_nsec;
+}
+
+// 文件的绝对路径，相对路径基于当前的工作目录
+// 编译服务器的工作目录与处理请求的子进程不同，只能使用绝对路径
+static char *absolutePath(char *Path) {
+  static char *Cwd;
+  if (Path[0] == '/')
+    return Path;
+  if (!Cwd && !(Cwd = getcwd(NULL, 0)))
+    return NULL;
+  return format("%s/%s", Cwd, Path);
+}
+
+// 读取文件内容，并进行词法分析前的转换
+static char *readSource(char *Path) {
   // 读取文件内容
   char *P = readFile(Path);
   if (!P)
@@ -951,6 +989,73 @@ Token *tokenizeFile(char *Path) {
   removeBackslashNewline(P);
   // 转换unicode字符为UTF-8编码
   convertUniversalChars(P);
+  return P;
+}
+
+// 复制缓存的终结符，并指向新的文件
+static Token *copyFileTokens(Token *Tok, File *FP) {
+  Token Head = {};
+  Token *Cur = &Head;
+  for (; Tok; Tok = Tok->Next) {
+    Cur = Cur->Next = allocMem(MEM_TOKEN, sizeof(Token));
+    *Cur = *Tok;
+    Cur->File = FP;
+    Cur->Filename = FP->DisplayName;
+  }
+  return Head.Next;
+}
+
+// 编译服务器词法分析子进程报告的文件，Path为绝对路径
+// 文件的修改时间和大小必须与子进程所见的一致，此时词法分析不会出错
+void warmFile(char *Path, int64_t MTime, int64_t Size) {
+  struct stat St;
+  if (Path[0] != '/' || stat(Path, &St) || fileMTime(&St) != MTime ||
+      St.st_size != Size)
+    return;
+  char *Key = fileKey(&St);
+  WarmFile *WF = hashmapGet(&WarmFiles, Key);
+  if (WF && WF->MTime == MTime && WF->Size == Size)
+    return;
+
+  char *P = readSource(Path);
+  if (!P)
+    return;
+  WF = calloc(1, sizeof(WarmFile));
+  WF->File = newFile(strdup(Path), 0, P);
+  WF->Tok = tokenize(WF->File);
+  WF->Guard = detectIncludeGuard(WF->Tok);
+  WF->MTime = MTime;
+  WF->Size = Size;
+  hashmapPut(&WarmFiles, Key, WF);
+}
+
+// 编译服务器中已缓存且未被修改的文件的头文件保护宏，没有时返回NULL
+char *warmIncludeGuard(char *Path) {
+  struct stat St;
+  if (!WarmFiles.Used || stat(Path, &St))
+    return NULL;
+  WarmFile *WF = hashmapGet(&WarmFiles, fileKey(&St));
+  if (!WF || fileMTime(&St) != WF->MTime || St.st_size != WF->Size)
+    return NULL;
+  return WF->Guard;
+}
+
+// 词法分析文件
+static Token *tokenizeFile2(char *Path) {
+  // 编译服务器中已经词法分析过且未被修改的文件，直接复制其终结符
+  struct stat St;
+  bool HasStat = (WarmFiles.Used || InServer) && strcmp(Path, "-") &&
+                 !stat(Path, &St);
+  WarmFile *WF = HasStat && WarmFiles.Used
+                     ? hashmapGet(&WarmFiles, fileKey(&St))
+                     : NULL;
+  bool Warm =
+      WF && fileMTime(&St) == WF->MTime && St.st_size == WF->Size;
+
+  // 读取文件内容
+  char *P = Warm ? WF->File->Contents : readSource(Path);
+  if (!P)
+    return NULL;
 
   // 文件编号
   static int FileNo;
@@ -968,6 +1073,23 @@ Token *tokenizeFile(char *Path) {
   // 文件编号加1
   FileNo++;
 
+  if (Warm)
+    return copyFileTokens(WF->Tok, FP);
+
   // 词法分析文件
-  return tokenize(FP);
+  Token *Tok = tokenize(FP);
+  // 报告给编译服务器，之后的请求可以直接使用
+  char *Abs = HasStat ? absolutePath(Path) : NULL;
+  if (InServer && Abs)
+    serverReport("F\t%ld\t%ld\t%s\n", (long)fileMTime(&St),
+                 (long)St.st_size, Abs);
+  return Tok;
+}
+
+// 词法分析文件，计入词法分析阶段的时间
+Token *tokenizeFile(char *Path) {
+  CompilePhase Old = enterPhase(PHASE_TOKENIZE);
+  Token *Tok = tokenizeFile2(Path);
+  enterPhase(Old);
+  return Tok;
 }
@@ -19,7 +19,7 @@ Type *TyDouble = &(Type){TY_DOUBLE, 8, 8};
 Type *TyLDouble = &(Type){TY_LDOUBLE, 16, 16};
 
 static Type *newType(TypeKind Kind, int Size, int Align) {
-  Type *Ty = calloc(1, sizeof(Type));
+  Type *Ty = allocMem(MEM_TYPE, sizeof(Type));
   Ty->Kind = Kind;
   Ty->Size = Size;
   Ty->Align = Align;
@@ -111,7 +111,7 @@ bool isCompatible(Type *T1, Type *T2) {
 
 // 复制类型
 Type *copyType(Type *Ty) {
-  Type *Ret = calloc(1, sizeof(Type));
+  Type *Ret = allocMem(MEM_TYPE, sizeof(Type));
   *Ret = *Ty;
   // 记录原始类型
   Ret->Origin = Ty;
@@ -203,6 +203,38 @@ static void usualArithConv(Node **LHS, Node **RHS) {
   *RHS = newCast(*RHS, Ty);
 }
 
+// 标记地址被获取的变量
+static void markAddrTaken(Node *Nd) {
+  switch (Nd->Kind) {
+  case ND_VAR:
+    Nd->Var->IsAddrTaken = true;
+    return;
+  case ND_MEMBER:
+  case ND_ASSIGN:
+  case ND_CAST:
+    markAddrTaken(Nd->LHS);
+    return;
+  case ND_COMMA:
+    markAddrTaken(Nd->RHS);
+    return;
+  case ND_COND:
+    markAddrTaken(Nd->Then);
+    markAddrTaken(Nd->Els);
+    return;
+  case ND_STMT_EXPR: {
+    // 语句表达式的值为最后一个表达式语句
+    Node *Last = Nd->Body;
+    while (Last && Last->Next)
+      Last = Last->Next;
+    if (Last && Last->Kind == ND_EXPR_STMT)
+      markAddrTaken(Last->LHS);
+    return;
+  }
+  default:
+    return;
+  }
+}
+
 // 为节点内的所有节点添加类型
 void addType(Node *Nd) {
   // 判断 节点是否为空 或者 节点类型已经有值，那么就直接返回
@@ -305,9 +337,13 @@ void addType(Node *Nd) {
   // 将节点类型设为 成员的类型
   case ND_MEMBER:
     Nd->Ty = Nd->Mem->Ty;
+    // 数组成员会退化为指针
+    if (Nd->Ty->Kind == TY_ARRAY)
+      markAddrTaken(Nd->LHS);
     return;
   // 将节点类型设为 指针，并指向左部的类型
   case ND_ADDR: {
+    markAddrTaken(Nd->LHS);
     Type *Ty = Nd->LHS->Ty;
     // 左部如果是数组, 则为指向数组基类的指针
     if (Ty->Kind == TY_ARRAY)
@@ -355,11 +391,15 @@ void addType(Node *Nd) {
       errorTok(Nd->CasOld->Tok, "pointer expected");
     return;
   // 节点类型为 左部所指向的类型
-  case ND_EXCH:
-    if (Nd->LHS->Ty->Kind != TY_PTR)
-      errorTok(Nd->CasAddr->Tok, "pointer expected");
+  case ND_ATOM_LD:
+  case ND_ATOM_RMW:
     Nd->Ty = Nd->LHS->Ty->Base;
     return;
+  // 节点类型为 void
+  case ND_ATOM_ST:
+  case ND_FENCE:
+    Nd->Ty = TyVoid;
+    return;
   default:
     break;
   }